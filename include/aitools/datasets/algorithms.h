@@ -10,7 +10,9 @@
 #ifndef AITOOLS_DATASETS_ALGORITHMS_H
 #define AITOOLS_DATASETS_ALGORITHMS_H
 
+#include <cmath>
 #include <limits>
+#include <vector>
 #include "aitools/datasets/dataset.h"
 #include "aitools/datasets/missing.h"
 #include "aitools/numerics/math_utility.h"
@@ -79,6 +81,98 @@ std::pair<double, double> mean_standard_deviation(const dataset& D, const IndexR
   return { mu, sigma };
 }
 
+/// \brief The statistics of all variables of a dataset over a subset of its rows. For each continuous variable the
+/// mean and the sum of squared deviations from the mean are maintained, and for each categorical variable the
+/// number of occurrences of each category. Missing values are ignored.
+/// \details The statistics are computed with \c compute_variable_statistics in a single pass over the rows, using
+/// Welford's algorithm for the continuous variables.
+struct variable_statistics
+{
+  std::size_t row_count = 0;                  // the number of rows
+  std::vector<std::size_t> counts;            // counts[v] is the number of non-missing values of variable v
+  std::vector<double> means;                  // means[v] is the mean of continuous variable v
+  std::vector<double> squared_deviations;     // squared_deviations[v] is the sum of (x - mean)^2 of continuous variable v
+  std::vector<std::size_t> category_offsets;  // the counts of variable v are stored in [category_offsets[v], category_offsets[v + 1])
+  std::vector<std::size_t> category_counts;
+
+  /// \brief Returns the mean and standard deviation of continuous variable \c v. The special cases are handled
+  /// the same as in \c mean_standard_deviation.
+  std::pair<double, double> mean_standard_deviation(std::size_t v) const
+  {
+    if (counts[v] == 0) // only missing values!
+    {
+      AITOOLS_LOG(log::warning) << "Found only missing values in node with variable " << v << std::endl;
+      return { 0, 1 };
+    }
+    double sigma = std::sqrt(squared_deviations[v] / counts[v]);
+    if (sigma == 0)
+    {
+      sigma = std::numeric_limits<double>::min();
+    }
+    return { means[v], sigma };
+  }
+
+  /// \brief Returns the category counts of categorical variable \c v.
+  std::vector<std::size_t> categorical_counts(std::size_t v) const
+  {
+    return std::vector<std::size_t>(category_counts.begin() + category_offsets[v], category_counts.begin() + category_offsets[v + 1]);
+  }
+};
+
+/// \brief Computes the statistics of all variables of \c D over the rows in \c I. Each row is visited once, and all
+/// variables of the row are processed while it is in cache. Variable \c v is treated as categorical if
+/// <tt>D.category_counts()[v] >= 2</tt>.
+template <typename IndexRange>
+void compute_variable_statistics(const dataset& D, const IndexRange& I, variable_statistics& result)
+{
+  const auto& X = D.X();
+  const auto& ncat = D.category_counts();
+  std::size_t m = ncat.size();
+
+  result.row_count = 0;
+  result.counts.assign(m, 0);
+  result.means.assign(m, 0.0);
+  result.squared_deviations.assign(m, 0.0);
+  result.category_offsets.resize(m + 1);
+  result.category_offsets[0] = 0;
+  for (std::size_t v = 0; v < m; v++)
+  {
+    result.category_offsets[v + 1] = result.category_offsets[v] + (ncat[v] < 2 ? 0 : ncat[v]);
+  }
+  result.category_counts.assign(result.category_offsets[m], 0);
+
+  std::size_t* counts = result.counts.data();
+  double* means = result.means.data();
+  double* squared_deviations = result.squared_deviations.data();
+  std::size_t* category_counts = result.category_counts.data();
+  const std::size_t* category_offsets = result.category_offsets.data();
+
+  for (auto i: I)
+  {
+    const auto& x = X[i];
+    result.row_count++;
+    for (std::size_t v = 0; v < m; v++)
+    {
+      double x_v = x[v];
+      if (is_missing(x_v))
+      {
+        continue;
+      }
+      counts[v]++;
+      if (ncat[v] < 2)
+      {
+        double delta = x_v - means[v];
+        means[v] += delta / counts[v];
+        squared_deviations[v] += delta * (x_v - means[v]);
+      }
+      else
+      {
+        category_counts[category_offsets[v] + static_cast<std::size_t>(x_v)]++;
+      }
+    }
+  }
+}
+
 /// \brief Computes the fractions of values in an array \c x.
 /// \param I The range of indices that is taken into account.
 /// \param v The index of a categorical variable.
@@ -0,0 +1,567 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/datasets/csv_import.h
+/// \brief Conversion of CSV files into datasets.
+
+#ifndef AITOOLS_DATASETS_CSV_IMPORT_H
+#define AITOOLS_DATASETS_CSV_IMPORT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "aitools/datasets/dataset.h"
+#include "aitools/utilities/parallel.h"
+#include "aitools/utilities/parse_numbers.h"
+#include "aitools/utilities/text_utility.h"
+
+namespace aitools {
+
+namespace detail {
+
+// Splits the line [first, last) of a CSV file into cells. A quoted cell may contain delimiters, and a double quote
+// inside a quoted cell is written as "". Spaces and tabs around a cell are removed, unless they are the delimiter.
+// The unescaped text of quoted cells that contain "" is stored in buffer.
+inline
+void split_csv_line(const char* first, const char* last, char delimiter, std::vector<std::string_view>& cells, std::deque<std::string>& buffer)
+{
+  auto is_space = [delimiter](char c) { return (c == ' ' || c == '\t' || c == '\r') && c != delimiter; };
+
+  cells.clear();
+  buffer.clear();
+  const char* i = first;
+  for (;;)
+  {
+    while (i != last && is_space(*i))
+    {
+      ++i;
+    }
+    const char* cell_first = i;
+    const char* cell_last;
+    if (i != last && *i == '"')
+    {
+      cell_first = ++i;
+      bool escaped = false;
+      for (; i != last; ++i)
+      {
+        if (*i == '"')
+        {
+          if (i + 1 != last && i[1] == '"')
+          {
+            escaped = true;
+            ++i;
+          }
+          else
+          {
+            break;
+          }
+        }
+      }
+      if (i == last)
+      {
+        throw std::runtime_error("Unterminated quote in line '" + std::string(first, last) + "'");
+      }
+      cell_last = i++;
+      if (escaped)
+      {
+        std::string& text = buffer.emplace_back();
+        for (const char* j = cell_first; j != cell_last; ++j)
+        {
+          text.push_back(*j);
+          if (*j == '"')
+          {
+            ++j;
+          }
+        }
+        cells.emplace_back(text);
+      }
+      else
+      {
+        cells.emplace_back(cell_first, cell_last - cell_first);
+      }
+      while (i != last && is_space(*i))
+      {
+        ++i;
+      }
+      if (i != last && *i != delimiter)
+      {
+        throw std::runtime_error("Unexpected text after a quoted cell in line '" + std::string(first, last) + "'");
+      }
+    }
+    else
+    {
+      i = std::find(i, last, delimiter);
+      cell_last = i;
+      while (cell_last != cell_first && is_space(cell_last[-1]))
+      {
+        --cell_last;
+      }
+      cells.emplace_back(cell_first, cell_last - cell_first);
+    }
+    if (i == last)
+    {
+      break;
+    }
+    ++i; // skip the delimiter
+  }
+}
+
+// A summary of the cells of a column in a chunk of rows
+struct csv_column_summary
+{
+  bool has_strings = false;                // some cell is not a number
+  bool has_numbers = false;                // some cell is a number
+  bool is_natural = true;                  // all numbers are finite non-negative integers
+  double max_value = 0;                    // the maximum of the numbers, if is_natural
+  std::size_t number_count = 0;            // the number of cells that are numbers
+  std::vector<double> distinct_values;     // the distinct numbers, if there are at most max_categories + 1 of them
+  std::vector<std::string> categories;     // the strings in order of first appearance
+  std::unordered_map<std::string, std::uint32_t> category_index;
+
+  void add_number(double x, std::size_t max_categories)
+  {
+    has_numbers = true;
+    number_count++;
+    if (!is_natural)
+    {
+      return;
+    }
+    if (!std::isfinite(x) || x < 0 || x != std::floor(x))
+    {
+      is_natural = false;
+      distinct_values = {};
+      return;
+    }
+    max_value = std::max(max_value, x);
+    if (distinct_values.size() <= max_categories && std::find(distinct_values.begin(), distinct_values.end(), x) == distinct_values.end())
+    {
+      distinct_values.push_back(x);
+    }
+  }
+
+  std::uint32_t add_string(std::string_view text)
+  {
+    has_strings = true;
+    auto [i, inserted] = category_index.try_emplace(std::string(text), categories.size());
+    if (inserted)
+    {
+      categories.emplace_back(text);
+    }
+    return i->second;
+  }
+
+  // Adds the numbers of other; the strings are merged separately
+  void merge_numbers(const csv_column_summary& other, std::size_t max_categories)
+  {
+    has_strings = has_strings || other.has_strings;
+    has_numbers = has_numbers || other.has_numbers;
+    number_count += other.number_count;
+    is_natural = is_natural && other.is_natural;
+    if (!is_natural)
+    {
+      distinct_values = {};
+      return;
+    }
+    max_value = std::max(max_value, other.max_value);
+    for (double x: other.distinct_values)
+    {
+      if (distinct_values.size() <= max_categories && std::find(distinct_values.begin(), distinct_values.end(), x) == distinct_values.end())
+      {
+        distinct_values.push_back(x);
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+/// \brief Converts the contents of a CSV file into a dataset. The rows are parsed in parallel in chunks.
+/// \details The type of the columns is inferred in the same way as in the script \c prep.py.
+/// <ul>
+/// <li>A column that contains a cell that is not a number is categorical. Its values are dictionary-encoded in order
+/// of first appearance, and the dictionaries are available via \c categories.</li>
+/// <li>A numerical column is continuous if it contains a negative, fractional or infinite value, if its maximum is
+/// at least \c max_categories, or if it has more than <tt>min(max_categories, n / 3)</tt> distinct values, with \c n
+/// the number of values. Otherwise it is categorical with <tt>max + 1</tt> categories.</li>
+/// <li>The class column is always categorical, and it becomes the last column of the dataset. If it is numerical, it
+/// must contain non-negative integers less than \c max_categories, and it has <tt>max + 1</tt> categories.</li>
+/// <li>A categorical column with only one category is treated as continuous.</li>
+/// </ul>
+/// Empty cells and cells in \c missing_values are mapped to the missing value. Quoted cells may not contain newlines.
+class csv_dataset_parser
+{
+  protected:
+    struct chunk
+    {
+      const char* first;
+      const char* last;
+      std::size_t row_count = 0;
+      std::vector<double> values; // the values of the rows; string cells contain their index in the chunk dictionary
+      std::vector<detail::csv_column_summary> columns;
+    };
+
+    std::vector<chunk> m_chunks;
+    std::vector<std::string> m_features;
+    std::vector<unsigned int> m_category_counts;
+    std::vector<std::vector<std::string>> m_categories;
+    std::vector<std::unordered_map<std::string, std::uint32_t>> m_category_index;
+    std::vector<bool> m_is_string_column;
+    std::vector<std::size_t> m_columns; // m_columns[j] is the index in the CSV file of column j of the dataset
+
+    bool is_missing_value(std::string_view text) const
+    {
+      return text.empty() || std::find(missing_values.begin(), missing_values.end(), text) != missing_values.end();
+    }
+
+    // Parses the rows of a chunk. Cells of string columns are dictionary-encoded, also if they are numbers.
+    void parse_chunk(chunk& c, std::size_t column_count) const
+    {
+      c.row_count = 0;
+      c.values.clear();
+      c.columns.assign(column_count, detail::csv_column_summary());
+
+      std::vector<std::string_view> cells;
+      std::deque<std::string> buffer;
+      const char* first = c.first;
+      while (first != c.last)
+      {
+        const char* eol = std::find(first, c.last, '\n');
+        const char* line_last = eol;
+        if (line_last != first && line_last[-1] == '\r')
+        {
+          --line_last;
+        }
+        if (line_last != first)
+        {
+          detail::split_csv_line(first, line_last, delimiter, cells, buffer);
+          if (cells.size() != column_count)
+          {
+            throw std::runtime_error("Expected " + std::to_string(column_count) + " cells in line '" + std::string(first, line_last) + "'");
+          }
+          for (std::size_t j = 0; j < column_count; j++)
+          {
+            std::string_view cell = cells[j];
+            auto& column = c.columns[j];
+            double value = std::numeric_limits<double>::quiet_NaN();
+            if (!is_missing_value(cell))
+            {
+              const char* cell_last = cell.data() + cell.size();
+              if (!m_is_string_column[j] && parse_next_double(cell.data(), cell_last, value) == cell_last)
+              {
+                if (!std::isnan(value))
+                {
+                  column.add_number(value, max_categories);
+                }
+              }
+              else
+              {
+                value = column.add_string(cell);
+              }
+            }
+            c.values.push_back(value);
+          }
+          c.row_count++;
+        }
+        first = eol == c.last ? c.last : eol + 1;
+      }
+    }
+
+    // Parses all chunks in parallel
+    void parse_chunks(std::size_t column_count)
+    {
+      utilities::run_parallel(m_chunks.size(), [&](std::size_t k)
+      {
+        parse_chunk(m_chunks[k], column_count);
+      });
+    }
+
+  public:
+    /// \brief The character that separates the cells.
+    char delimiter = ',';
+
+    /// \brief If true, the first line contains the names of the columns.
+    bool has_header = true;
+
+    /// \brief Cells with these values are missing, as well as empty cells.
+    std::vector<std::string> missing_values{"?", "NA"};
+
+    /// \brief The maximum number of categories of a numerical categorical column.
+    std::size_t max_categories = 30;
+
+    /// \brief The indices of numerical columns that are continuous regardless of their values.
+    std::vector<std::size_t> continuous_columns;
+
+    /// \brief A value of \c class_column that denotes the last column.
+    static constexpr std::size_t last_column = std::numeric_limits<std::size_t>::max();
+
+    /// \brief The index of the class column in the CSV file. In the dataset it is the last column.
+    std::size_t class_column = last_column;
+
+    /// \brief The minimal size in bytes of the chunks of rows that are parsed in parallel.
+    std::size_t chunk_size = 1 << 20;
+
+    /// \brief Parses the contents of a CSV file. The text after the header is cut into chunks that end at a newline,
+    /// and the chunks are parsed in parallel. If a column turns out to contain both numbers and strings, the chunks
+    /// are parsed a second time with that column marked as a string column.
+    void parse_text(const std::string& text)
+    {
+      m_chunks.clear();
+      m_features.clear();
+      std::vector<std::string_view> cells;
+      std::deque<std::string> buffer;
+
+      // the first non-empty line determines the number of columns
+      const char* first = text.data();
+      const char* last = text.data() + text.size();
+      std::size_t column_count = 0;
+      while (first != last && column_count == 0)
+      {
+        const char* eol = std::find(first, last, '\n');
+        const char* line_last = eol != first && eol[-1] == '\r' ? eol - 1 : eol;
+        if (line_last != first)
+        {
+          detail::split_csv_line(first, line_last, delimiter, cells, buffer);
+          column_count = cells.size();
+          if (has_header)
+          {
+            for (std::string_view cell: cells)
+            {
+              std::string name(cell);
+              std::replace_if(name.begin(), name.end(), [](char c) { return c == ' ' || c == '\t'; }, '_');
+              m_features.push_back(name.empty() ? "x" + std::to_string(m_features.size()) : name);
+            }
+            first = eol == last ? last : eol + 1;
+          }
+          break;
+        }
+        first = eol == last ? last : eol + 1;
+      }
+
+      // cut the rows into chunks of at least chunk_size bytes that end at a newline
+      for (const char* i = first; i != last; )
+      {
+        const char* j = i + std::min<std::size_t>(std::max<std::size_t>(chunk_size, 1), last - i);
+        j = std::find(j, last, '\n');
+        if (j != last)
+        {
+          ++j;
+        }
+        m_chunks.push_back({i, j, 0, {}, {}});
+        i = j;
+      }
+
+      std::size_t class_index = class_column == last_column ? column_count - 1 : class_column;
+      if (column_count > 0 && class_index >= column_count)
+      {
+        throw std::runtime_error("The class column " + std::to_string(class_column) + " does not exist");
+      }
+
+      m_is_string_column.assign(column_count, false);
+      parse_chunks(column_count);
+
+      // merge the summaries of the chunks
+      std::vector<detail::csv_column_summary> columns(column_count);
+      for (const auto& c: m_chunks)
+      {
+        for (std::size_t j = 0; j < column_count; j++)
+        {
+          columns[j].merge_numbers(c.columns[j], max_categories);
+        }
+      }
+
+      // parse again if a column contains both numbers and strings
+      bool is_mixed = false;
+      for (std::size_t j = 0; j < column_count; j++)
+      {
+        if (columns[j].has_strings)
+        {
+          is_mixed = is_mixed || columns[j].has_numbers;
+          m_is_string_column[j] = true;
+        }
+      }
+      if (is_mixed)
+      {
+        parse_chunks(column_count);
+      }
+
+      // merge the dictionaries of the string columns in order of first appearance, and determine the category counts
+      m_category_counts.assign(column_count, 0);
+      m_categories.assign(column_count, {});
+      m_category_index.assign(column_count, {});
+      for (std::size_t j = 0; j < column_count; j++)
+      {
+        if (m_is_string_column[j])
+        {
+          auto& categories = m_categories[j];
+          auto& category_index = m_category_index[j];
+          for (const auto& c: m_chunks)
+          {
+            for (const auto& category: c.columns[j].categories)
+            {
+              if (category_index.try_emplace(category, categories.size()).second)
+              {
+                categories.push_back(category);
+              }
+            }
+          }
+          m_category_counts[j] = categories.size();
+        }
+        else if (j == class_index)
+        {
+          const auto& column = columns[j];
+          if (!column.is_natural)
+          {
+            throw std::runtime_error("The class column " + std::to_string(j) + " contains a value that is not a non-negative integer");
+          }
+          if (column.max_value >= max_categories)
+          {
+            throw std::runtime_error("The class column " + std::to_string(j) + " has more than " + std::to_string(max_categories) + " categories");
+          }
+          if (column.has_numbers)
+          {
+            m_category_counts[j] = static_cast<unsigned int>(column.max_value) + 1;
+          }
+        }
+        else
+        {
+          const auto& column = columns[j];
+          bool is_continuous = !column.is_natural
+                               || column.max_value >= max_categories
+                               || column.distinct_values.size() > std::min(max_categories, column.number_count / 3)
+                               || std::find(continuous_columns.begin(), continuous_columns.end(), j) != continuous_columns.end();
+          if (!is_continuous && column.has_numbers)
+          {
+            m_category_counts[j] = static_cast<unsigned int>(column.max_value) + 1;
+          }
+        }
+        if (m_category_counts[j] == 1)
+        {
+          m_category_counts[j] = 0;
+        }
+      }
+
+      // the class column is moved to the end
+      m_columns.resize(column_count);
+      std::iota(m_columns.begin(), m_columns.end(), 0);
+      if (column_count > 0)
+      {
+        std::rotate(m_columns.begin() + class_index, m_columns.begin() + class_index + 1, m_columns.end());
+        auto reorder = [this](auto& v)
+        {
+          std::decay_t<decltype(v)> result;
+          for (std::size_t j: m_columns)
+          {
+            result.push_back(std::move(v[j]));
+          }
+          v = std::move(result);
+        };
+        reorder(m_category_counts);
+        reorder(m_categories);
+        if (!m_features.empty())
+        {
+          reorder(m_features);
+        }
+      }
+    }
+
+    /// \brief Returns the dataset, and releases the parsed rows.
+    dataset get_result()
+    {
+      std::size_t column_count = m_category_counts.size();
+      std::vector<std::size_t> offsets(m_chunks.size() + 1, 0); // the index of the first row of each chunk
+      for (std::size_t k = 0; k < m_chunks.size(); k++)
+      {
+        offsets[k + 1] = offsets[k] + m_chunks[k].row_count;
+      }
+      std::size_t n = offsets.back();
+      if (n == 0)
+      {
+        return dataset{numerics::matrix<double>(), std::move(m_category_counts), std::move(m_features)};
+      }
+
+      // copy the rows in parallel, and translate the indices of the chunk dictionaries into category values
+      std::vector<std::vector<double>> X(n);
+      utilities::run_parallel(m_chunks.size(), [&](std::size_t k)
+      {
+        auto& c = m_chunks[k];
+        std::vector<std::vector<double>> category_values(column_count);
+        for (std::size_t j = 0; j < column_count; j++)
+        {
+          if (m_is_string_column[j])
+          {
+            for (const auto& category: c.columns[j].categories)
+            {
+              category_values[j].push_back(m_category_index[j].at(category));
+            }
+          }
+        }
+        for (std::size_t i = 0; i < c.row_count; i++)
+        {
+          const double* values = c.values.data() + i * column_count;
+          auto& x = X[offsets[k] + i];
+          x.resize(column_count);
+          for (std::size_t j = 0; j < column_count; j++)
+          {
+            std::size_t c_j = m_columns[j];
+            x[j] = values[c_j];
+            if (m_is_string_column[c_j] && !std::isnan(x[j]))
+            {
+              x[j] = category_values[c_j][static_cast<std::size_t>(x[j])];
+            }
+          }
+        }
+        c = chunk{};
+      });
+      m_chunks.clear();
+      m_category_index.clear();
+      return dataset{numerics::matrix<double>(std::move(X)), std::move(m_category_counts), std::move(m_features)};
+    }
+
+    /// \brief Returns the categories of the string columns, in the order of their values. The categories of
+    /// numerical columns are empty.
+    const std::vector<std::vector<std::string>>& categories() const
+    {
+      return m_categories;
+    }
+};
+
+/// \brief Converts the contents of a CSV file into a dataset.
+inline
+dataset parse_csv_dataset(const std::string& text, char delimiter = ',', bool has_header = true)
+{
+  csv_dataset_parser parser;
+  parser.delimiter = delimiter;
+  parser.has_header = has_header;
+  parser.parse_text(text);
+  return parser.get_result();
+}
+
+/// \brief Loads a dataset from a CSV file.
+inline
+dataset load_csv_dataset(const std::string& filename, char delimiter = ',', bool has_header = true)
+{
+  std::ifstream from(filename);
+  if (!from)
+  {
+    throw std::runtime_error("Could not open file '" + filename + "' for reading.");
+  }
+  from.close();
+  return parse_csv_dataset(read_text_fast(filename), delimiter, has_header);
+}
+
+} // namespace aitools
+
+#endif // AITOOLS_DATASETS_CSV_IMPORT_H
@@ -18,6 +18,7 @@
 #include "aitools/decision_trees/index_range.h"
 #include "aitools/numerics/csv.h"
 #include "aitools/numerics/matrix.h"
+#include "aitools/utilities/format.h"
 #include "aitools/utilities/logger.h"
 #include "aitools/utilities/print.h"
 #include "aitools/utilities/string_utility.h"
@@ -209,17 +210,23 @@ void print_info(const dataset& D)
 inline
 std::ostream& operator<<(std::ostream& to, const dataset& D)
 {
-  to << "dataset: 1.0\n";
-  to << "category_counts: " << print_container(D.category_counts()) << '\n';
+  utilities::text_buffer out;
+  utilities::format_text(out, "dataset: 1.0\ncategory_counts: ");
+  utilities::format_container(out, D.category_counts());
+  utilities::format_text(out, "\n");
   if (!D.features().empty())
   {
-    to << "features: " << utilities::string_join(D.features(), " ") << '\n';
+    utilities::format_text(out, "features: " + utilities::string_join(D.features(), " ") + "\n");
   }
+  utilities::write_buffer(to, out);
+
+  // the rows are formatted in parallel
   const auto& X = D.X();
-  for (const auto& Xi: X)
+  utilities::write_parallel(to, X.row_count(), [&X](utilities::text_buffer& out, std::size_t i)
   {
-    to << print_container(Xi) << '\n';
-  }
+    utilities::format_container(out, X[i]);
+    out.push_back('\n');
+  });
   return to;
 }
 
@@ -10,12 +10,61 @@
 #ifndef AITOOLS_DATASETS_IO_H
 #define AITOOLS_DATASETS_IO_H
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include "aitools/datasets/dataset.h"
+#include "aitools/utilities/parallel.h"
 #include "aitools/utilities/parse_numbers.h"
+#include "aitools/utilities/text_utility.h"
 
 namespace aitools {
 
+namespace detail {
+
+// Parses the rows in the text range [first, last), and appends them to X. Lines without numbers are skipped.
+// Each row is allocated once, using column_count as an estimate of its size.
+inline
+void parse_dataset_rows(const char* first, const char* last, std::size_t column_count, std::vector<std::vector<double>>& X)
+{
+  auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+
+  while (first != last)
+  {
+    const char* eol = std::find(first, last, '\n');
+    std::vector<double> x;
+    x.reserve(column_count);
+    const char* i = first;
+    for (;;)
+    {
+      while (i != eol && is_space(*i))
+      {
+        ++i;
+      }
+      if (i == eol)
+      {
+        break;
+      }
+      double value;
+      const char* next = parse_next_double(i, eol, value);
+      if (next == i)
+      {
+        throw std::runtime_error("Could not parse line '" + std::string(first, eol) + "'");
+      }
+      x.push_back(value);
+      i = next;
+    }
+    if (!x.empty())
+    {
+      X.push_back(std::move(x));
+    }
+    first = eol == last ? last : eol + 1;
+  }
+}
+
+} // namespace detail
+
 class dataset_parser
 {
   protected:
@@ -44,14 +93,18 @@ class dataset_parser
 
     void parse_row(const std::string& line)
     {
-      std::vector<double> x = parse_double_sequence(line);
-      if (!x.empty())
-      {
-        X.push_back(x);
-      }
+      detail::parse_dataset_rows(line.data(), line.data() + line.size(), category_counts.size(), X);
+    }
+
+    static bool is_header_line(const std::string& line)
+    {
+      return utilities::starts_with(line, "dataset:") || utilities::starts_with(line, "category_counts:") || utilities::starts_with(line, "features:");
     }
 
   public:
+    /// \brief The minimal size in bytes of the chunks of rows that are parsed in parallel by \c parse_text.
+    std::size_t chunk_size = 1 << 20;
+
     void parse_line(const std::string& line)
     {
       if (utilities::starts_with(line, "dataset:"))
@@ -72,21 +125,73 @@ class dataset_parser
       }
     }
 
-    void parse(std::istream& from)
+    /// \brief Parses the contents of a dataset file. First the header lines are parsed. The remaining text is cut
+    /// into chunks that end at a newline, and the chunks are parsed in parallel.
+    void parse_text(const std::string& text)
     {
       X.clear();
       category_counts.clear();
-      for (std::string line; std::getline(from, line); )
+
+      // parse the header lines, and the empty lines before them
+      std::size_t first = 0;
+      while (first < text.size())
       {
+        std::size_t eol = std::min(text.find('\n', first), text.size());
+        std::string line = text.substr(first, eol - first);
+        if (!is_header_line(line) && !utilities::trim_copy(line).empty())
+        {
+          break;
+        }
         AITOOLS_LOG(log::debug) << "LINE: " << line << std::endl;
         parse_line(line);
+        first = std::min(eol + 1, text.size());
+      }
+
+      // cut the rows into chunks of at least chunk_size bytes that end at a newline
+      std::vector<std::pair<const char*, const char*>> chunks;
+      const char* last = text.data() + text.size();
+      for (const char* i = text.data() + first; i != last; )
+      {
+        const char* j = i + std::min<std::size_t>(std::max<std::size_t>(chunk_size, 1), last - i);
+        j = std::find(j, last, '\n');
+        if (j != last)
+        {
+          ++j;
+        }
+        chunks.emplace_back(i, j);
+        i = j;
+      }
+
+      std::vector<std::vector<std::vector<double>>> chunk_rows(chunks.size());
+      std::size_t column_count = category_counts.size();
+      utilities::run_parallel(chunks.size(), [&](std::size_t k)
+      {
+        detail::parse_dataset_rows(chunks[k].first, chunks[k].second, column_count, chunk_rows[k]);
+      });
+
+      std::size_t n = 0;
+      for (const auto& rows: chunk_rows)
+      {
+        n += rows.size();
+      }
+      X.reserve(n);
+      for (auto& rows: chunk_rows)
+      {
+        std::move(rows.begin(), rows.end(), std::back_inserter(X));
+        rows = {};
       }
     }
 
+    void parse(std::istream& from)
+    {
+      parse_text(std::string(std::istreambuf_iterator<char>(from), std::istreambuf_iterator<char>()));
+    }
+
     dataset get_result()
     {
-      // return {numerics::matrix<double>(std::move(X)), std::move(category_counts)}; TODO: use move constructor
-      return dataset{numerics::matrix<double>(X), category_counts, features};
+      numerics::matrix<double> X1 = X.empty() ? numerics::matrix<double>() : numerics::matrix<double>(std::move(X));
+      X.clear();
+      return dataset{std::move(X1), std::move(category_counts), std::move(features)};
     }
 };
 
@@ -101,10 +206,12 @@ dataset parse_dataset(std::istream& from)
 inline
 dataset parse_dataset(const std::string& text)
 {
-  std::istringstream stream(text);
-  return parse_dataset(stream);
+  dataset_parser parser;
+  parser.parse_text(text);
+  return parser.get_result();
 }
 
+/// \brief Loads a dataset from a file. The file is read in one go, and the rows are parsed in parallel.
 inline
 dataset load_dataset(const std::string& filename)
 {
@@ -113,7 +220,8 @@ dataset load_dataset(const std::string& filename)
   {
     throw std::runtime_error("Could not open file '" + filename + "' for reading.");
   }
-  return parse_dataset(from);
+  from.close();
+  return parse_dataset(read_text_fast(filename));
 }
 
 inline
@@ -204,6 +204,13 @@ void swap(binary_decision_tree& tree1, binary_decision_tree& tree2)
   tree1.swap(tree2);
 }
 
+/// \brief Appends the textual representation of a decision tree to a buffer. Split values are written in the
+/// shortest representation that parses back to the same value.
+/// \param packed If true, the classes and indices are written in a compact encoding: the classes are bit-packed,
+/// and the indices are delta-encoded in bit-packed blocks after sorting the indices of each leaf. Both are stored in
+/// base64.
+void format_decision_tree(utilities::text_buffer& out, const binary_decision_tree& tree, bool packed = false);
+
 std::ostream& operator<<(std::ostream& to, const binary_decision_tree& tree);
 
 std::ostream& operator<<(std::ostream& out, const binary_decision_tree::vertex& u);
@@ -10,10 +10,13 @@
 #ifndef AITOOLS_IO_H
 #define AITOOLS_IO_H
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include "aitools/decision_trees/decision_tree.h"
 #include "aitools/decision_trees/splitters_io.h"
+#include "aitools/utilities/packing.h"
 #include "aitools/utilities/print.h"
 #include "aitools/utilities/parse_numbers.h"
 #include "aitools/utilities/string_utility.h"
@@ -51,6 +54,34 @@ class decision_tree_parser
       tree.classes() = parse_natural_number_sequence<std::uint32_t>(first, line.end());
     }
 
+    // packed_classes: <count> <bits> <base64>
+    void parse_packed_classes(const std::string& line)
+    {
+      unsigned int n = 0;
+      unsigned int bits = 0;
+      const char* first = line.data() + std::strlen("packed_classes:");
+      const char* last = line.data() + line.size();
+      first = parse_integer(first, last, n);
+      first = parse_integer(first, last, bits);
+      std::vector<std::uint8_t> bytes;
+      utilities::parse_base64(skip_spaces(first, last), last, bytes);
+      tree.classes().resize(n);
+      utilities::unpack_bits(bytes.data(), bytes.data() + bytes.size(), n, bits, tree.classes().data());
+    }
+
+    // packed_indices: <count> <base64>
+    void parse_packed_indices(const std::string& line)
+    {
+      unsigned int n = 0;
+      const char* first = line.data() + std::strlen("packed_indices:");
+      const char* last = line.data() + line.size();
+      first = parse_integer(first, last, n);
+      std::vector<std::uint8_t> bytes;
+      utilities::parse_base64(skip_spaces(first, last), last, bytes);
+      tree.indices().resize(n);
+      utilities::unpack_deltas(bytes.data(), bytes.data() + bytes.size(), n, tree.indices().data());
+    }
+
     void parse_category_counts(const std::string& line)
     {
       auto first = skip_string(line.begin(), line.end(), std::string("category_counts:"));
@@ -66,8 +97,8 @@ class decision_tree_parser
       unsigned int i0;
       unsigned int i1;
 
-      auto first = skip_string(line.begin(), line.end(), std::string("vertex:"));
-      auto last = line.end();
+      const char* first = line.data() + std::strlen("vertex:");
+      const char* last = line.data() + line.size();
       first = parse_integer(first, last, index);
       first = std::find(first, last, '[');
       ++first;
@@ -76,10 +107,8 @@ class decision_tree_parser
       first = std::find(first, last, ']');
       ++first;
       first = skip_spaces(first, last);
-      auto end = std::find(first, last, ')');
-      splitting_criterion split = parse_splitting_criterion(std::string(first, end));
-      first = end;
-      ++first;
+      splitting_criterion split;
+      first = parse_splitting_criterion(first, last, split);
       first = parse_integer(first, last, i0);
       parse_integer(first, last, i1);
 
@@ -111,6 +140,14 @@ class decision_tree_parser
       {
         parse_indices(line);
       }
+      else if (utilities::starts_with(line, "packed_classes:"))
+      {
+        parse_packed_classes(line);
+      }
+      else if (utilities::starts_with(line, "packed_indices:"))
+      {
+        parse_packed_indices(line);
+      }
       else if (utilities::starts_with(line, "vertex:"))
       {
         parse_vertex(line);
@@ -126,15 +163,26 @@ class decision_tree_parser
       }
     }
 
-    void parse(const std::string& filename)
+    /// \brief Parses the lines in the text range <tt>[first, last)</tt>.
+    void parse_text(const char* first, const char* last)
     {
-      for (const std::string& line: utilities::split_lines(read_text_fast(filename)))
+      std::string line;
+      while (first != last)
       {
+        const char* eol = std::find(first, last, '\n');
+        line.assign(first, eol);
         AITOOLS_LOG(log::debug) << "LINE: " << line << std::endl;
         parse_line(line);
+        first = eol == last ? last : eol + 1;
       }
     }
 
+    void parse(const std::string& filename)
+    {
+      std::string text = read_text_fast(filename);
+      parse_text(text.data(), text.data() + text.size());
+    }
+
     bool has_tree() const
     {
       return !tree.vertices().empty();
@@ -171,15 +219,19 @@ binary_decision_tree load_decision_tree(const std::string& filename)
   return parser.get_result();
 }
 
+/// \brief Saves a decision tree to a file.
+/// \param packed If true, the classes and indices are written in the compact encoding of \c format_decision_tree.
 inline
-void save_decision_tree(const std::string& filename, const binary_decision_tree& tree)
+void save_decision_tree(const std::string& filename, const binary_decision_tree& tree, bool packed = false)
 {
   std::ofstream to(filename);
   if (!to)
   {
     throw std::runtime_error("Could not open file '" + filename + "' for writing.");
   }
-  to << tree;
+  utilities::text_buffer out;
+  format_decision_tree(out, tree, packed);
+  utilities::write_buffer(to, out);
 }
 
 } // namespace aitools
@@ -17,6 +17,7 @@
 #include "aitools/decision_trees/impurity.h"
 #include "aitools/numerics/math_utility.h"
 #include "aitools/utilities/bit_utility.h"
+#include "aitools/utilities/format.h"
 #include "aitools/utilities/logger.h"
 #include "aitools/utilities/stack_array.h"
 
@@ -198,6 +199,39 @@ std::ostream& operator<<(std::ostream& out, const splitting_criterion& split)
   return out;
 }
 
+/// \brief Appends a splitting criterion to a buffer, in the same format as the stream operator. Split values are
+/// written in the shortest representation that parses back to the same value.
+inline
+void format_split(utilities::text_buffer& out, const splitting_criterion& split)
+{
+  struct format_split_visitor
+  {
+    utilities::text_buffer& out;
+
+    void operator()(const single_split& split)
+    {
+      fmt::format_to(std::back_inserter(out), "SingleSplit({}, {})", split.variable, split.value);
+    }
+
+    void operator()(const subset_split& split)
+    {
+      fmt::format_to(std::back_inserter(out), "SubsetSplit({}, {:032b})", split.variable, split.mask);
+    }
+
+    void operator()(const threshold_split& split)
+    {
+      fmt::format_to(std::back_inserter(out), "ThresholdSplit({}, {})", split.variable, split.value);
+    }
+
+    void operator()(const std::monostate&)
+    {
+      utilities::format_text(out, "NoSplit()");
+    }
+  };
+
+  std::visit(format_split_visitor{out}, split);
+}
+
 /// \brief Partitions the indices in the range I into I1 and I2 using the given splitter.
 /// \param split A splitter
 /// \param D A data set
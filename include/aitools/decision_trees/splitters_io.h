@@ -10,6 +10,9 @@
 #ifndef AITOOLS_SPLITTERS_IO_H
 #define AITOOLS_SPLITTERS_IO_H
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include "splitters.h"
 #include "aitools/utilities/parse_numbers.h"
 #include "aitools/utilities/string_utility.h"
@@ -70,6 +73,79 @@ subset_split parse_subset_split(const std::string& line)
   return { variable, mask };
 }
 
+/// \brief Parses a splitting criterion from the range <tt>[first, last)</tt> without allocating memory, e.g.
+/// ThresholdSplit(1, 5.2187). Unknown criteria, like NoSplit(), are parsed as \c std::monostate.
+/// \return The position after the closing parenthesis.
+inline
+const char* parse_splitting_criterion(const char* first, const char* last, splitting_criterion& result)
+{
+  auto starts_with = [&](const char* prefix)
+  {
+    std::size_t n = std::strlen(prefix);
+    return static_cast<std::size_t>(last - first) >= n && std::equal(prefix, prefix + n, first);
+  };
+
+  auto fail = [&]()
+  {
+    throw std::runtime_error("could not parse splitting criterion " + std::string(first, last));
+  };
+
+  const char* close = std::find(first, last, ')');
+  if (close == last)
+  {
+    fail();
+  }
+
+  enum class split_type { single, subset, threshold, none };
+  split_type type = starts_with("SingleSplit(") ? split_type::single : starts_with("SubsetSplit(") ? split_type::subset : starts_with("ThresholdSplit(") ? split_type::threshold : split_type::none;
+  if (type == split_type::none)
+  {
+    result = std::monostate();
+    return close + 1;
+  }
+
+  const char* i = std::find(first, close, '(') + 1;
+  i = skip_spaces(i, close);
+  std::size_t variable;
+  auto [p, ec] = std::from_chars(i, close, variable);
+  if (ec != std::errc())
+  {
+    fail();
+  }
+  i = std::find(p, close, ',');
+  if (i == close)
+  {
+    fail();
+  }
+  i = skip_spaces(i + 1, close);
+  if (type == split_type::subset)
+  {
+    std::uint32_t mask = 0;
+    for (; i != close && (*i == '0' || *i == '1'); ++i)
+    {
+      mask = 2 * mask + (*i - '0');
+    }
+    result = subset_split(variable, mask);
+  }
+  else
+  {
+    double value;
+    if (parse_next_double(i, close, value) == i)
+    {
+      fail();
+    }
+    if (type == split_type::single)
+    {
+      result = single_split(variable, value);
+    }
+    else
+    {
+      result = threshold_split(variable, value);
+    }
+  }
+  return close + 1;
+}
+
 inline
 splitting_criterion parse_splitting_criterion(const std::string& text)
 {
@@ -0,0 +1,249 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/numerics/detail/simd_kernels.h
+/// \brief Generic implementations of the kernels in aitools/numerics/simd_functions.h.
+///
+/// The kernels are templates over a class V that wraps the intrinsics of one instruction set. They are instantiated
+/// in src/simd_functions_avx2.cpp and src/simd_functions_avx512.cpp, after a target pragma. Those files include the
+/// standard headers below before the pragma, so that no inline library code is compiled for the wrong target.
+
+#ifndef AITOOLS_NUMERICS_DETAIL_SIMD_KERNELS_H
+#define AITOOLS_NUMERICS_DETAIL_SIMD_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace aitools::simd::detail {
+
+// Entry points of the vectorized kernels, see aitools/numerics/simd_functions.h.
+void exp_avx2(const double* first, const double* last, double* result);
+void log_avx2(const double* first, const double* last, double* result);
+double log_sum_exp_avx2(const double* first, const double* last);
+void normal_log_pdf_avx2(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer);
+
+void exp_avx512(const double* first, const double* last, double* result);
+void log_avx512(const double* first, const double* last, double* result);
+double log_sum_exp_avx512(const double* first, const double* last);
+void normal_log_pdf_avx512(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer);
+
+// V is expected to provide:
+//   reg, mask, width
+//   load(p), store(p, a), set1(x)
+//   add(a, b), sub(a, b), mul(a, b), div(a, b), max(a, b), min(a, b)
+//   fmadd(a, b, c) = a * b + c, fnmadd(a, b, c) = c - a * b
+//   round(a)                 rounds to the nearest integer
+//   lt(a, b), gt(a, b), eq(a, b), is_nan(a)
+//   blend(m, a, b)           selects b where m is set, and a elsewhere
+//   pow2(n)                  2^n for integer values n in [-1022, 1023]
+//   exponent(x), mantissa(x) x = mantissa(x) * 2^exponent(x) with mantissa(x) in [1, 2), for positive normal x
+//   reduce_add(a), reduce_max(a)
+
+// exp(x) = 2^n * exp(r) with r = x - n log(2) and |r| <= log(2) / 2. The Taylor polynomial of degree 13 has a
+// truncation error below 2^-60 on this interval. The scaling by 2^n is done in two steps, to support subnormal results.
+template <typename V>
+inline
+typename V::reg exp(typename V::reg x)
+{
+  using reg = typename V::reg;
+  constexpr double x_max = 709.782712893384;
+  constexpr double x_min = -745.1332191019412;
+  constexpr double log2e = 1.4426950408889634;
+  constexpr double ln2_hi = 6.93147180369123816490e-01; // the lower 32 bits are zero, so n * ln2_hi is exact
+  constexpr double ln2_lo = 1.90821492927058770002e-10;
+
+  reg xc = V::min(V::max(x, V::set1(-746.0)), V::set1(710.0));
+  reg n = V::round(V::mul(xc, V::set1(log2e)));
+  reg r = V::fnmadd(n, V::set1(ln2_hi), xc);
+  r = V::fnmadd(n, V::set1(ln2_lo), r);
+
+  reg p = V::set1(1.0 / 6227020800.0);
+  p = V::fmadd(p, r, V::set1(1.0 / 479001600.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 39916800.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 3628800.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 362880.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 40320.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 5040.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 720.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 120.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 24.0));
+  p = V::fmadd(p, r, V::set1(1.0 / 6.0));
+  p = V::fmadd(p, r, V::set1(0.5));
+  p = V::fmadd(p, r, V::set1(1.0));
+  p = V::fmadd(p, r, V::set1(1.0));
+
+  reg n1 = V::round(V::mul(n, V::set1(0.5)));
+  reg n2 = V::sub(n, n1);
+  reg result = V::mul(V::mul(p, V::pow2(n1)), V::pow2(n2));
+
+  result = V::blend(V::gt(x, V::set1(x_max)), result, V::set1(std::numeric_limits<double>::infinity()));
+  result = V::blend(V::lt(x, V::set1(x_min)), result, V::set1(0.0));
+  return V::blend(V::is_nan(x), result, x);
+}
+
+// log(x) = e log(2) + log(1 + f) with 1 + f in [sqrt(2)/2, sqrt(2)). The polynomial approximation of log(1 + f) is
+// the one used by fdlibm, which has an error below 1 ulp.
+template <typename V>
+inline
+typename V::reg log(typename V::reg x)
+{
+  using reg = typename V::reg;
+  constexpr double min_normal = std::numeric_limits<double>::min();
+  constexpr double two_pow_54 = 18014398509481984.0;
+  constexpr double sqrt2 = 1.4142135623730951;
+  constexpr double ln2_hi = 6.93147180369123816490e-01;
+  constexpr double ln2_lo = 1.90821492927058770002e-10;
+  constexpr double Lg1 = 6.666666666666735130e-01;
+  constexpr double Lg2 = 3.999999999940941908e-01;
+  constexpr double Lg3 = 2.857142874366239149e-01;
+  constexpr double Lg4 = 2.222219843214978396e-01;
+  constexpr double Lg5 = 1.818357216161805012e-01;
+  constexpr double Lg6 = 1.531383769920937332e-01;
+  constexpr double Lg7 = 1.479819860511658591e-01;
+
+  // scale subnormal arguments into the normal range
+  auto subnormal = V::lt(x, V::set1(min_normal));
+  reg xs = V::blend(subnormal, x, V::mul(x, V::set1(two_pow_54)));
+  reg e = V::sub(V::exponent(xs), V::blend(subnormal, V::set1(0.0), V::set1(54.0)));
+  reg m = V::mantissa(xs);
+  auto large = V::gt(m, V::set1(sqrt2));
+  m = V::blend(large, m, V::mul(m, V::set1(0.5)));
+  e = V::blend(large, e, V::add(e, V::set1(1.0)));
+
+  reg f = V::sub(m, V::set1(1.0));
+  reg s = V::div(f, V::add(f, V::set1(2.0)));
+  reg z = V::mul(s, s);
+  reg w = V::mul(z, z);
+  reg t1 = V::mul(w, V::fmadd(w, V::fmadd(w, V::set1(Lg6), V::set1(Lg4)), V::set1(Lg2)));
+  reg t2 = V::mul(z, V::fmadd(w, V::fmadd(w, V::fmadd(w, V::set1(Lg7), V::set1(Lg5)), V::set1(Lg3)), V::set1(Lg1)));
+  reg R = V::add(t1, t2);
+  reg hfsq = V::mul(V::mul(V::set1(0.5), f), f);
+
+  // result = e * ln2_hi - ((hfsq - (s * (hfsq + R) + e * ln2_lo)) - f)
+  reg u = V::fmadd(s, V::add(hfsq, R), V::mul(e, V::set1(ln2_lo)));
+  reg result = V::sub(V::mul(e, V::set1(ln2_hi)), V::sub(V::sub(hfsq, u), f));
+
+  constexpr double inf = std::numeric_limits<double>::infinity();
+  result = V::blend(V::eq(x, V::set1(0.0)), result, V::set1(-inf));
+  result = V::blend(V::lt(x, V::set1(0.0)), result, V::set1(std::numeric_limits<double>::quiet_NaN()));
+  result = V::blend(V::eq(x, V::set1(inf)), result, V::set1(inf));
+  return V::blend(V::is_nan(x), result, x);
+}
+
+template <typename V>
+struct exp_function
+{
+  typename V::reg operator()(typename V::reg x) const
+  {
+    return exp<V>(x);
+  }
+};
+
+template <typename V>
+struct log_function
+{
+  typename V::reg operator()(typename V::reg x) const
+  {
+    return log<V>(x);
+  }
+};
+
+// Applies f to the elements of [first, last), and stores the results in result. The remaining elements that do not
+// fill a complete register are processed using a buffer.
+template <typename V, typename Function>
+inline
+void transform(const double* first, const double* last, double* result, Function f)
+{
+  std::size_t n = last - first;
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width)
+  {
+    V::store(result + i, f(V::load(first + i)));
+  }
+  if (i < n)
+  {
+    double buffer[V::width] = {};
+    for (std::size_t j = i; j < n; j++)
+    {
+      buffer[j - i] = first[j];
+    }
+    V::store(buffer, f(V::load(buffer)));
+    for (std::size_t j = i; j < n; j++)
+    {
+      result[j] = buffer[j - i];
+    }
+  }
+}
+
+// Applies f to the elements of [first, last), where the last register is padded with the value fill.
+template <typename V, typename Function>
+inline
+void for_each(const double* first, const double* last, double fill, Function f)
+{
+  std::size_t n = last - first;
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width)
+  {
+    f(V::load(first + i));
+  }
+  if (i < n)
+  {
+    double buffer[V::width];
+    for (std::size_t j = 0; j < V::width; j++)
+    {
+      buffer[j] = i + j < n ? first[i + j] : fill;
+    }
+    f(V::load(buffer));
+  }
+}
+
+template <typename V>
+inline
+double log_sum_exp(const double* first, const double* last)
+{
+  using reg = typename V::reg;
+  constexpr double inf = std::numeric_limits<double>::infinity();
+
+  if (first == last)
+  {
+    return 0.0;
+  }
+
+  // N.B. The order of the arguments of max matters: NaN values are ignored when computing the maximum.
+  reg max_value = V::set1(-inf);
+  for_each<V>(first, last, -inf, [&](reg x) { max_value = V::max(x, max_value); });
+  double shift = V::reduce_max(max_value);
+  if (!std::isfinite(shift))
+  {
+    shift = 0.0; // all values are -inf, or some value is +inf
+  }
+
+  reg sum = V::set1(0.0);
+  reg s = V::set1(shift);
+  for_each<V>(first, last, -inf, [&](reg x) { sum = V::add(sum, exp<V>(V::sub(x, s))); });
+  return std::log(V::reduce_add(sum)) + shift;
+}
+
+template <typename V>
+inline
+void normal_log_pdf(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer)
+{
+  using reg = typename V::reg;
+  reg mu = V::set1(mean);
+  reg c = V::set1(inverse_sigma);
+  reg half = V::set1(0.5);
+  reg a = V::set1(log_normalizer);
+  transform<V>(first, last, result, [&](reg x)
+  {
+    reg z = V::mul(V::sub(x, mu), c);
+    return V::fnmadd(V::mul(half, z), z, a);
+  });
+}
+
+} // namespace aitools::simd::detail
+
+#endif // AITOOLS_NUMERICS_DETAIL_SIMD_KERNELS_H
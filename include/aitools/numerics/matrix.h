@@ -154,8 +154,12 @@ class matrix
       : m_rows(rows, std::vector<NumberType>(columns, NumberType())), m_column_count(columns)
     {}
 
-    explicit matrix(const std::vector<std::vector<NumberType>>& rows) // TODO: add move constructor
-     : m_rows(rows), m_column_count(rows.front().size())
+    explicit matrix(const std::vector<std::vector<NumberType>>& rows)
+     : m_rows(rows), m_column_count(rows.empty() ? 0 : rows.front().size())
+    {}
+
+    explicit matrix(std::vector<std::vector<NumberType>>&& rows)
+     : m_rows(std::move(rows)), m_column_count(m_rows.empty() ? 0 : m_rows.front().size())
     {}
 
     NumberType& operator()(std::size_t i, std::size_t j)
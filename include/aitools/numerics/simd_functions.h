@@ -0,0 +1,71 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/numerics/simd_functions.h
+/// \brief Vectorized versions of exp, log, log_sum_exp and the normal log-density.
+///
+/// The kernels are implemented for AVX-512, AVX2 and plain scalar code. The best instruction set supported by the
+/// CPU is selected at runtime, so the library can be compiled without any architecture specific compiler flags.
+///
+/// Accuracy of the vectorized kernels (ulp = unit in the last place):
+///   - exp: relative error at most 2 ulp for results in the normal range. Results below 2^-1022 are correctly
+///     scaled subnormals; exp(x) = 0 for x < -745.14 and exp(x) = inf for x > 709.78.
+///   - log: relative error at most 1 ulp. log(0) = -inf, log(x) = NaN for x < 0, subnormal arguments are supported.
+///   - log_sum_exp: absolute error at most 4 ulp of max(1, |result|).
+///   - normal_log_pdf: computed as log_normalizer - 0.5 * z * z with z = (x - mean) * inverse_sigma, the same
+///     expression as the scalar code, so the results are identical up to fused multiply-add rounding.
+/// NaN arguments produce NaN results. The scalar fallback uses std::exp and std::log.
+
+#ifndef AITOOLS_NUMERICS_SIMD_FUNCTIONS_H
+#define AITOOLS_NUMERICS_SIMD_FUNCTIONS_H
+
+#include <cstddef>
+#include <string>
+
+namespace aitools::simd {
+
+/// \brief The instruction sets for which kernels are available.
+enum class instruction_set
+{
+  scalar,
+  avx2,
+  avx512
+};
+
+/// \brief Returns the name of an instruction set.
+std::string instruction_set_name(instruction_set s);
+
+/// \brief Returns the best instruction set that is supported by the CPU.
+instruction_set detected_instruction_set();
+
+/// \brief Returns the instruction set that is currently used by the kernels.
+instruction_set selected_instruction_set();
+
+/// \brief Selects the instruction set used by the kernels. If \a s is not supported by the CPU, the best supported
+/// instruction set below \a s is used instead. This function is not thread safe; it is intended for testing and
+/// benchmarking.
+/// \return The instruction set that was actually selected.
+instruction_set select_instruction_set(instruction_set s);
+
+/// \brief Computes result[i] = exp(first[i]) for all elements of [first, last).
+/// \pre The output range may coincide with the input range, but should not partially overlap it.
+void exp(const double* first, const double* last, double* result);
+
+/// \brief Computes result[i] = log(first[i]) for all elements of [first, last).
+/// \pre The output range may coincide with the input range, but should not partially overlap it.
+void log(const double* first, const double* last, double* result);
+
+/// \brief Computes log(sum_i exp(first[i])) in a numerically stable way. Returns 0 for an empty range, and -inf
+/// if all elements are -inf.
+double log_sum_exp(const double* first, const double* last);
+
+/// \brief Computes result[i] = log_normalizer - 0.5 * z * z with z = (first[i] - mean) * inverse_sigma. For the
+/// log-density of N(mean, sigma) use inverse_sigma = 1 / sigma and log_normalizer = -log(sigma * sqrt(2 pi)).
+void normal_log_pdf(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer);
+
+} // namespace aitools::simd
+
+#endif // AITOOLS_NUMERICS_SIMD_FUNCTIONS_H
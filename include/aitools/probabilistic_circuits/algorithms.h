@@ -11,20 +11,25 @@
 #define AITOOLS_PROBABILISTIC_CIRCUITS_ALGORITHMS_H
 
 #include <cmath>
+#include <deque>
+#include <unordered_set>
 #include "aitools/datasets/dataset.h"
 #include "aitools/numerics/math_utility.h"
 #include "aitools/probabilistic_circuits/probabilistic_circuit.h"
+#include "aitools/probabilistic_circuits/scope_analysis.h"
 #include "aitools/utilities/container_utility.h"
 
 namespace aitools {
 
 /// \brief Visits the nodes of the probabilistic circuit in breadth first order. It calls the function f on each vertex
 /// \c u of the PC using <tt>f(u, depth)</tt>, where \c depth is the depth of the node in the circuit.
+/// \details Nodes that are shared by several parents are visited only once, with the smallest depth.
 template <typename Function>
 void visit_nodes_bfs(const probabilistic_circuit& pc, Function f)
 {
   std::size_t depth = 0;
   std::deque<pc_node_ptr> todo = { pc.root() };
+  std::unordered_set<const pc_node*> discovered = { pc.root().get() };
   std::size_t level = 1; // the number of nodes in the current level
   while (!todo.empty())
   {
@@ -35,7 +40,10 @@ void visit_nodes_bfs(const probabilistic_circuit& pc, Function f)
     {
       for (const auto& v: u->successors())
       {
-        todo.push_back(v);
+        if (discovered.insert(v.get()).second)
+        {
+          todo.push_back(v);
+        }
       }
     }
     f(u, depth);
@@ -47,7 +55,7 @@ void visit_nodes_bfs(const probabilistic_circuit& pc, Function f)
   }
 }
 
-/// \brief Returns the number of vertices in the probabilistic circuit \c pc.
+/// \brief Returns the number of vertices in the probabilistic circuit \c pc. Shared vertices are counted once.
 std::size_t probabilistic_circuit_size(const probabilistic_circuit& pc);
 
 /// \brief The \c topological_ordering algorithm creates a linear ordering of the vertices such that if
@@ -99,18 +107,56 @@ std::vector<double> sample_pc(const probabilistic_circuit& pc, std::mt19937& rng
 /// \brief Draw n random samples of the probabilistic circuit \c pc and put them in a dataset
 dataset sample_pc(const probabilistic_circuit& pc, std::size_t n, std::mt19937& rng);
 
+/// \brief Draw n random samples of the probabilistic circuit \c pc in parallel and put them in a dataset
+/// \details The samples are divided into blocks of \c block_size rows. Each block uses its own random number
+/// generator, that is derived from \c seed and the block index. Hence the result only depends on \c seed and
+/// \c block_size, and not on the number of threads. An exception that is thrown while sampling, e.g. by a node that
+/// does not support sampling, is rethrown to the caller.
+/// \param thread_count The number of parallel tasks. If it is 0, the number of hardware threads is used.
+/// \param block_size The number of rows in a block. A value of 0 is treated as 1.
+dataset sample_pc_parallel(const probabilistic_circuit& pc, std::size_t n, std::uint64_t seed, std::size_t thread_count = 0, std::size_t block_size = 4096);
+
 /// \brief Returns \c true if the sums of the weights of all sum nodes are in the interval [1-tolerance, 1+tolerance]
 bool is_normalized(const probabilistic_circuit& pc, double tolerance = 1e-10);
 
 /// \brief Returns \c true if all sum nodes in the probabilistic circuit \c pc are smooth.
 bool is_smooth(const probabilistic_circuit& pc);
 
+/// \brief Returns \c true if all sum nodes of the circuit that was analyzed by \c scopes are smooth.
+bool is_smooth(const scope_analysis& scopes);
+
 /// \brief Returns \c true if all product nodes in the probabilistic circuit \c pc are decomposable.
 bool is_decomposable(const probabilistic_circuit& pc);
 
+/// \brief Returns \c true if all product nodes of the circuit that was analyzed by \c scopes are decomposable.
+bool is_decomposable(const scope_analysis& scopes);
+
+/// \brief Returns \c true if it can be established that all sum nodes in the probabilistic circuit \c pc are
+/// deterministic, i.e. for each complete input at most one successor of a sum node is non-zero.
+/// \details Sum-split nodes are deterministic by construction. For other sum nodes it is checked that each pair of
+/// successors has disjoint supports for some variable, where the supports are derived from categorical leaves,
+/// truncated normal leaves and indicator nodes. Since the supports are over-approximated, the result \c false
+/// does not imply that the circuit is not deterministic.
+bool is_deterministic(const probabilistic_circuit& pc);
+
+/// \brief Overload of \c is_deterministic that reuses an existing scope analysis of \c pc.
+bool is_deterministic(const probabilistic_circuit& pc, const scope_analysis& scopes);
+
 /// \brief Does same sanity checks on the probabilistic circuit \c pc.
 bool is_valid(const probabilistic_circuit& pc);
 
+/// \brief Simplifies the probabilistic circuit \c pc without changing the values of EVI queries. The following
+/// simplifications are applied:
+/// - edges of sum nodes with weight 0, or that lead to a subcircuit that is identically 0, are removed
+/// - a sum node that is the only parent of another sum node absorbs it, by multiplying the weights
+/// - a product node that is the only parent of another product node absorbs its successors
+/// - indicator nodes that are one for all inputs are removed from product nodes
+/// - sum nodes with a single successor with weight 1, and product nodes with a single successor, are replaced by
+///   their successor
+/// \details Sum-split nodes are left unchanged. Nodes that are shared by several parents are not absorbed, since that
+/// would duplicate them. The nodes of \c pc are modified in place.
+void simplify(probabilistic_circuit& pc);
+
 } // namespace aitools
 
 #endif // AITOOLS_PROBABILISTIC_CIRCUITS_ALGORITHMS_H
@@ -0,0 +1,333 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/probabilistic_circuits/evaluation_plan.h
+/// \brief Batched forward and backward passes over a flattened probabilistic circuit.
+
+#ifndef AITOOLS_PROBABILISTIC_CIRCUITS_EVALUATION_PLAN_H
+#define AITOOLS_PROBABILISTIC_CIRCUITS_EVALUATION_PLAN_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "aitools/datasets/dataset.h"
+#include "aitools/numerics/matrix.h"
+#include "aitools/probabilistic_circuits/probabilistic_circuit.h"
+
+namespace aitools {
+
+/// \brief A flattened representation of a probabilistic circuit. The nodes are numbered in topological order, such
+/// that successors come before their predecessors, and the root is the last node. The edges are stored in compressed
+/// sparse row format: the outgoing edges of node \c i are <tt>[first_edge(i), last_edge(i))</tt>.
+class evaluation_plan
+{
+  public:
+    enum class node_kind : std::uint8_t { terminal, sum, sum_split, product };
+
+  private:
+    std::vector<pc_node_ptr> m_nodes;
+    std::vector<node_kind> m_kinds;
+    std::vector<std::uint32_t> m_offsets;    // the edges of node i are [m_offsets[i], m_offsets[i+1])
+    std::vector<std::uint32_t> m_successors; // m_successors[e] is the target of edge e
+    std::vector<double> m_log_weights;       // m_log_weights[e] is the log weight of edge e, or 0 for product edges
+    std::vector<const splitting_criterion*> m_splitters; // m_splitters[i] is the splitter of sum-split node i
+    std::vector<unsigned int> m_category_counts;
+
+  public:
+    explicit evaluation_plan(const probabilistic_circuit& pc);
+
+    /// \brief Returns the number of nodes.
+    std::size_t size() const
+    {
+      return m_nodes.size();
+    }
+
+    std::size_t edge_count() const
+    {
+      return m_successors.size();
+    }
+
+    /// \brief Returns the position of the root node.
+    std::size_t root() const
+    {
+      return m_nodes.size() - 1;
+    }
+
+    const pc_node& node(std::size_t i) const
+    {
+      return *m_nodes[i];
+    }
+
+    const pc_node_ptr& node_ptr(std::size_t i) const
+    {
+      return m_nodes[i];
+    }
+
+    node_kind kind(std::size_t i) const
+    {
+      return m_kinds[i];
+    }
+
+    std::size_t first_edge(std::size_t i) const
+    {
+      return m_offsets[i];
+    }
+
+    std::size_t last_edge(std::size_t i) const
+    {
+      return m_offsets[i + 1];
+    }
+
+    /// \brief Returns the position of the target of edge \c e.
+    std::size_t successor(std::size_t e) const
+    {
+      return m_successors[e];
+    }
+
+    double log_weight(std::size_t e) const
+    {
+      return m_log_weights[e];
+    }
+
+    /// \brief Returns the splitting criterion of sum-split node \c i.
+    const splitting_criterion& splitter(std::size_t i) const
+    {
+      return *m_splitters[i];
+    }
+
+    const std::vector<unsigned int>& category_counts() const
+    {
+      return m_category_counts;
+    }
+};
+
+/// \brief Computes the log-values of all nodes for a batch of rows (the forward pass), and the derivatives
+/// <tt>d log p / d log S_u</tt> of the log-likelihood of each row with respect to the log-value of each node \c u
+/// (the backward pass). The derivatives are called flows: the flow of the root is 1, and for a smooth and decomposable
+/// circuit the flow of a node is the posterior probability that the node contributes to the likelihood of the row.
+/// \details The values are stored node-major, i.e. the values of node \c i for all rows of the batch are stored
+/// contiguously. The memory use is <tt>2 * size() * capacity</tt> doubles. Rows with likelihood 0 get flow 0.
+/// The branches of sum-split nodes are determined by the evidence, and are treated as constants by the backward pass.
+class forward_backward_pass
+{
+  private:
+    const evaluation_plan& m_plan;
+    std::size_t m_capacity;
+    std::size_t m_row_count = 0;
+    std::vector<const std::vector<double>*> m_rows;
+    std::vector<double> m_log_values;
+    std::vector<double> m_flows;
+    std::vector<double> m_buffer1;
+    std::vector<double> m_buffer2;
+
+  public:
+    /// \param capacity The maximum number of rows in a batch.
+    forward_backward_pass(const evaluation_plan& plan, std::size_t capacity);
+
+    /// \brief Computes the log-values of all nodes for the rows <tt>X[first], ..., X[last - 1]</tt>.
+    /// \pre <tt>last - first <= capacity</tt>
+    void forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last);
+
+    /// \brief Computes the flows of all nodes for the rows of the last forward pass.
+    void backward();
+
+    const evaluation_plan& plan() const
+    {
+      return m_plan;
+    }
+
+    /// \brief Returns the number of rows of the last forward pass.
+    std::size_t row_count() const
+    {
+      return m_row_count;
+    }
+
+    /// \brief Returns row \c r of the last forward pass.
+    const std::vector<double>& row(std::size_t r) const
+    {
+      return *m_rows[r];
+    }
+
+    /// \brief Returns the log-values of node \c i, one for each row.
+    const double* log_values(std::size_t i) const
+    {
+      return m_log_values.data() + i * m_capacity;
+    }
+
+    /// \brief Returns the flows of node \c i, one for each row.
+    const double* flows(std::size_t i) const
+    {
+      return m_flows.data() + i * m_capacity;
+    }
+
+    /// \brief Returns the log-likelihood of row \c r.
+    double log_likelihood(std::size_t r) const
+    {
+      return log_values(m_plan.root())[r];
+    }
+
+    /// \brief Adds the flows through the edges to \c result, summed over the rows. The flow through edge (u, v) is
+    /// the part of the flow of \c v that comes from \c u. For the edges of sum nodes these are the expected counts
+    /// that are used by the EM algorithm.
+    /// \pre <tt>result.size() == plan().edge_count()</tt>
+    void accumulate_edge_flows(std::vector<double>& result) const;
+
+    /// \brief Adds the derivatives <tt>d log p / d w</tt> of the log-likelihood with respect to the edge weights
+    /// of sum and sum-split nodes to \c result, summed over the rows. The entries of product edges are not changed.
+    /// \pre <tt>result.size() == plan().edge_count()</tt>
+    void accumulate_weight_gradients(std::vector<double>& result) const;
+};
+
+/// \brief Computes the max-product values of all nodes for a batch of rows, and the most probable completions of
+/// the missing values of the rows by backtracking. Sum nodes take the maximum of their weighted successors instead
+/// of the sum, and a missing value of a terminal node is replaced by its mode. Sum-split nodes with a missing
+/// splitting variable take the maximum of their branches.
+/// \details For a deterministic circuit the max-product value of the root is the probability of the most probable
+/// completion. In general it is the probability of the best induced tree, which is a lower bound.
+class max_product_pass
+{
+  private:
+    const evaluation_plan& m_plan;
+    std::size_t m_capacity;
+    std::size_t m_row_count = 0;
+    std::vector<const std::vector<double>*> m_rows;
+    std::vector<double> m_log_values;
+    std::vector<double> m_modes;          // m_modes[i] is the mode of terminal node i, or NaN
+    std::vector<double> m_log_modes;      // m_log_modes[i] is the log-value of terminal node i in its mode
+    std::vector<std::size_t> m_variables; // m_variables[i] is the scope of a terminal node, or the splitting variable of a sum-split node
+    mutable std::vector<std::uint32_t> m_stack;
+
+    // Returns the position of the successor of node i with the maximal weighted log-value for row r
+    std::size_t argmax(std::size_t i, std::size_t r) const;
+
+  public:
+    /// \param capacity The maximum number of rows in a batch.
+    max_product_pass(const evaluation_plan& plan, std::size_t capacity);
+
+    /// \brief Computes the max-product log-values of all nodes for the rows <tt>X[first], ..., X[last - 1]</tt>.
+    /// \pre <tt>last - first <= capacity</tt>
+    void forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last);
+
+    /// \brief Assigns the most probable values to the missing values of row \c r of the last forward pass.
+    /// \param x A copy of row \c r. Only its missing values are changed.
+    void complete(std::size_t r, std::vector<double>& x) const;
+
+    /// \brief Returns the number of rows of the last forward pass.
+    std::size_t row_count() const
+    {
+      return m_row_count;
+    }
+
+    /// \brief Returns row \c r of the last forward pass.
+    const std::vector<double>& row(std::size_t r) const
+    {
+      return *m_rows[r];
+    }
+
+    /// \brief Returns the max-product log-values of node \c i, one for each row.
+    const double* log_values(std::size_t i) const
+    {
+      return m_log_values.data() + i * m_capacity;
+    }
+
+    /// \brief Returns the max-product log-value of the root for row \c r.
+    double log_value(std::size_t r) const
+    {
+      return log_values(m_plan.root())[r];
+    }
+};
+
+/// \brief Computes the log-values <tt>log p(x_{-c}, x_c = k)</tt> for all values \c k of a categorical variable \c c
+/// for a batch of rows in a single traversal. The nodes that depend on \c c carry a vector of K values per row, and
+/// the other nodes carry a single value per row. Each node is evaluated once, and no flows are stored. The value of
+/// \c x_c in the rows is ignored.
+class class_posterior_pass
+{
+  private:
+    const evaluation_plan& m_plan;
+    std::size_t m_variable;
+    std::size_t m_class_count;
+    std::size_t m_capacity;
+    std::vector<const std::vector<double>*> m_rows;
+    std::vector<std::uint32_t> m_nodes;        // the nodes that depend on the variable, in topological order
+    std::vector<std::uint32_t> m_scalar_nodes; // the nodes that do not depend on the variable, in topological order
+    std::vector<std::uint32_t> m_positions;    // m_positions[i] is the position of node i in m_nodes, or undefined if it does not depend on the variable
+    std::vector<std::uint32_t> m_scalar_positions; // m_scalar_positions[i] is the position of node i in m_scalar_nodes, or undefined if it depends on the variable
+    std::vector<double> m_terminal_log_values; // the K log-values of the terminal nodes in m_nodes
+    std::vector<double> m_log_values;          // the K log-values per row of the nodes in m_nodes
+    std::vector<double> m_scalar_log_values;   // the log-values per row of the nodes in m_scalar_nodes
+    std::vector<double> m_buffer1;
+    std::vector<double> m_buffer2;
+    std::vector<double> m_x;
+
+    static constexpr std::uint32_t undefined = std::numeric_limits<std::uint32_t>::max();
+
+  public:
+    /// \param variable The index of a categorical variable.
+    /// \param capacity The maximum number of rows in a batch.
+    class_posterior_pass(const evaluation_plan& plan, std::size_t variable, std::size_t capacity);
+
+    /// \brief Computes the log-values of the nodes for the rows <tt>X[first], ..., X[last - 1]</tt>.
+    /// \pre <tt>last - first <= capacity</tt>
+    void forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last);
+
+    /// \brief Returns the number of rows of the last forward pass.
+    std::size_t row_count() const
+    {
+      return m_rows.size();
+    }
+
+    std::size_t class_count() const
+    {
+      return m_class_count;
+    }
+
+    /// \brief Returns the values <tt>log p(x_{-c}, x_c = k)</tt> for <tt>k = 0, ..., K - 1</tt> of row \c r.
+    const double* log_values(std::size_t r) const
+    {
+      return m_log_values.data() + (m_positions[m_plan.root()] * m_capacity + r) * m_class_count;
+    }
+
+    /// \brief Stores the posterior probabilities <tt>p(x_c = k | x_{-c})</tt> of row \c r in \c result. If
+    /// <tt>p(x_{-c}) = 0</tt>, the probabilities are 0.
+    void posterior(std::size_t r, double* result) const;
+};
+
+/// \brief Computes the log-likelihood of all rows of the dataset \c D, using batched forward passes.
+std::vector<double> log_evi_batch(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size = 64);
+
+/// \brief Computes the conditional distributions <tt>p(x_j = k | x_{-j})</tt> of all categorical variables \c j for all
+/// rows of \c D, using one forward pass and one pass that computes the derivatives of the likelihood with respect to
+/// the nodes per batch. The observed value of x_j is ignored, and if <tt>p(x_{-j}) = 0</tt> the probabilities are 0. The result contains a matrix with a row for each row of \c D and
+/// a column for each category for the categorical variables, and an empty matrix for the other variables.
+/// \pre The circuit is smooth and decomposable. Sum-split nodes that split on a categorical variable \c j are not
+/// supported for variable \c j, since their branch depends on x_j.
+std::vector<numerics::matrix<double>> conditional_marginals(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size = 64);
+
+/// \brief Returns a copy of the rows of \c D in which the missing values are replaced by their most probable
+/// values (MPE), using batched max-product passes. See \c max_product_pass.
+numerics::matrix<double> mpe_batch(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size = 64);
+
+/// \brief Computes the class posteriors <tt>p(y = k | x)</tt> of all rows of \c D, where the class variable \c y is
+/// the last column of \c D. The result contains a row for each row of \c D and a column for each class. The posteriors
+/// of all classes are computed in one traversal of the circuit per batch, see \c class_posterior_pass.
+numerics::matrix<double> predict_proba(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size = 64);
+
+/// \brief Returns a copy of the rows of \c D in which the missing values are replaced by a sample of the
+/// conditional distribution <tt>p(x_missing | x_observed)</tt>. For each block of rows one forward pass is done,
+/// after which each row is sampled top-down: sum nodes select a successor with probability proportional to its
+/// weight times its likelihood of the evidence, and the leaves of unobserved variables draw a value.
+/// \details The blocks are divided over \c thread_count parallel tasks, and block \c b uses the random stream \c b derived
+/// from \c seed, so the result does not depend on the number of threads. Rows with likelihood 0 are not changed.
+/// Indicator nodes constrain the sampling through the forward pass, but do not draw values. Sum-split nodes use the
+/// branch that is selected by the evidence, so the splitting variables should be observed, or the sum-split nodes
+/// should be expanded first. An exception that is thrown by one of the tasks is rethrown to the caller.
+/// \param thread_count The number of parallel tasks. If it is 0, the number of hardware threads is used.
+dataset sample_pc_conditional(const probabilistic_circuit& pc, const dataset& D, std::uint64_t seed, std::size_t thread_count = 0, std::size_t block_size = 64);
+
+} // namespace aitools
+
+#endif // AITOOLS_PROBABILISTIC_CIRCUITS_EVALUATION_PLAN_H
@@ -17,6 +17,7 @@
 #include "aitools/random_forests/random_forest.h"
 #include "aitools/probabilistic_circuits/algorithms.h"
 #include "aitools/probabilistic_circuits/generative_forest_nodes.h"
+#include "aitools/probabilistic_circuits/node_factory.h"
 #include "aitools/probabilistic_circuits/probabilistic_circuit.h"
 #include "aitools/utilities/interval.h"
 
@@ -25,13 +26,24 @@ namespace aitools {
 /// \brief Fits a normal distribution to random variable \c i using the samples in <tt>u.I</tt>.
 /// \param D The data set that contains the samples in <tt>u.I</tt>.
 /// \param ab An interval that contains the values of random variable \c i in the samples <tt>u.I</tt>.
+/// \param factory The factory that is used to create the PC node.
 /// \return A PC node containing the computed distribution.
-std::shared_ptr<pc_node> fit_normal(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i, const interval& ab);
+std::shared_ptr<pc_node> fit_normal(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i, const interval& ab, pc_node_factory& factory);
 
 /// \brief Fits a categorical distribution to random variable \c i using the samples in <tt>u.I</tt>.
 /// \param D The data set that contains the samples in <tt>u.I</tt>.
+/// \param factory The factory that is used to create the PC node.
 /// \return A PC node containing the computed distribution.
-std::shared_ptr<pc_node> fit_categorical(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i);
+std::shared_ptr<pc_node> fit_categorical(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i, pc_node_factory& factory);
+
+/// \brief Fits a normal distribution to random variable \c i using precomputed statistics of the samples.
+/// \param stats The statistics of the samples, computed with \c compute_variable_statistics.
+/// \param ab An interval that contains the values of random variable \c i in the samples.
+std::shared_ptr<pc_node> fit_normal(const variable_statistics& stats, std::size_t i, const interval& ab, pc_node_factory& factory);
+
+/// \brief Fits a categorical distribution to random variable \c i using precomputed statistics of the samples.
+/// \param stats The statistics of the samples, computed with \c compute_variable_statistics.
+std::shared_ptr<pc_node> fit_categorical(const variable_statistics& stats, std::size_t i, pc_node_factory& factory);
 
 /// \brief Enumerate the nodes in the tree, together with the intervals that constitute the partition of the
 /// feature space corresponding to the node. The callback function \c report_node has the following signature:
@@ -109,16 +121,22 @@ void enumerate_intervals(const binary_decision_tree& tree, std::size_t m, Report
 }
 
 /// \brief Assigns a univariate distribution to each leaf node in the vector \c pc_nodes.
-void fit_leave_nodes(const binary_decision_tree& tree, std::vector<std::shared_ptr<pc_node>>& pc_nodes, const dataset& D);
+/// \param sequential If false, the leaves are fitted in parallel.
+void fit_leave_nodes(const binary_decision_tree& tree, std::vector<std::shared_ptr<pc_node>>& pc_nodes, const dataset& D, pc_node_factory& factory, bool sequential = false);
 
 /// \brief Converts a decision tree into a generative forest.
-std::shared_ptr<pc_node> build_generative_tree(const binary_decision_tree& tree, const dataset& D);
+/// \param sequential If false, the leaves are fitted in parallel.
+std::shared_ptr<pc_node> build_generative_tree(const binary_decision_tree& tree, const dataset& D, pc_node_factory& factory, bool sequential = false);
 
 /// \brief Converts a random forest into a generative forest.
-probabilistic_circuit build_generative_forest(const random_forest& forest, const dataset& D);
+/// \param hash_consing If true, leaf nodes with equal distributions are shared between the leaves of all trees.
+/// \param sequential If false, the trees and the leaves of each tree are converted in parallel. The result is the
+/// same as the sequential result.
+probabilistic_circuit build_generative_forest(const random_forest& forest, const dataset& D, bool hash_consing = true, bool sequential = false);
 
 /// \brief Converts a generative forest to a regular probabilistic circuit, by expanding the sum-split nodes.
-void expand_sum_split_nodes(probabilistic_circuit& pc);
+/// \param hash_consing If true, equal indicator nodes are shared.
+void expand_sum_split_nodes(probabilistic_circuit& pc, bool hash_consing = true);
 
 } // namespace aitools
 
@@ -17,7 +17,7 @@ namespace aitools {
 class less_node : public terminal_node
 {
   private:
-    int m_value;
+    double m_value;
 
     bool contains(double x) const
     {
@@ -25,11 +25,16 @@ class less_node : public terminal_node
     }
 
   public:
-    less_node(int scope, int value)
+    less_node(int scope, double value)
       : terminal_node(scope), m_value(value)
     {
     }
 
+    double value() const
+    {
+      return m_value;
+    }
+
     double evi(const std::vector<double>& x) const override
     {
       return contains(x[m_scope]) ? 1 : 0;
@@ -40,10 +45,10 @@ class less_node : public terminal_node
       return contains(x[m_scope]) ? 0 : -infinity;
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "less", index, successors);
-      out << ' ' << m_scope << ' ' << m_value << "\n";
+      fmt::format_to(std::back_inserter(out), " {} {}\n", m_scope, m_value);
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -55,7 +60,7 @@ class less_node : public terminal_node
 class greater_equal_node : public terminal_node
 {
   private:
-    int m_value;
+    double m_value;
 
     bool contains(double x) const
     {
@@ -63,11 +68,16 @@ class greater_equal_node : public terminal_node
     }
 
   public:
-    greater_equal_node(int scope, int value)
+    greater_equal_node(int scope, double value)
       : terminal_node(scope), m_value(value)
     {
     }
 
+    double value() const
+    {
+      return m_value;
+    }
+
     double evi(const std::vector<double>& x) const override
     {
       return contains(x[m_scope]) ? 1 : 0;
@@ -78,10 +88,10 @@ class greater_equal_node : public terminal_node
       return contains(x[m_scope]) ? 0 : -infinity;
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "greater_equal", index, successors);
-      out << ' ' << m_scope << ' ' << m_value << "\n";
+      fmt::format_to(std::back_inserter(out), " {} {}\n", m_scope, m_value);
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -106,6 +116,11 @@ class equal_node : public terminal_node
     {
     }
 
+    double value() const
+    {
+      return m_value;
+    }
+
     double evi(const std::vector<double>& x) const override
     {
       return contains(x[m_scope]) ? 1 : 0;
@@ -116,10 +131,10 @@ class equal_node : public terminal_node
       return contains(x[m_scope]) ? 0 : -infinity;
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
-      save_node(out, "equal_to", index, successors);
-      out << ' ' << m_scope << ' ' << m_value << "\n";
+      save_node(out, "equal", index, successors);
+      fmt::format_to(std::back_inserter(out), " {} {}\n", m_scope, m_value);
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -144,6 +159,11 @@ class not_equal_node : public terminal_node
     {
     }
 
+    double value() const
+    {
+      return m_value;
+    }
+
     double evi(const std::vector<double>& x) const override
     {
       return contains(x[m_scope]) ? 1 : 0;
@@ -154,10 +174,10 @@ class not_equal_node : public terminal_node
       return contains(x[m_scope]) ? 0 : -infinity;
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
-      save_node(out, "not_equal_to", index, successors);
-      out << ' ' << m_scope << ' ' << m_value << "\n";
+      save_node(out, "not_equal", index, successors);
+      fmt::format_to(std::back_inserter(out), " {} {}\n", m_scope, m_value);
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -182,6 +202,11 @@ class subset_node : public terminal_node
     {
     }
 
+    uint32_t mask() const
+    {
+      return m_mask;
+    }
+
     double evi(const std::vector<double>& x) const override
     {
       return contains(x[m_scope]) ? 1 : 0;
@@ -192,10 +217,10 @@ class subset_node : public terminal_node
       return contains(x[m_scope]) ? 0 : -infinity;
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "subset", index, successors);
-      out << ' ' << m_scope << ' ' << std::bitset<32>(m_mask) << "\n";
+      fmt::format_to(std::back_inserter(out), " {} {:032b}\n", m_scope, m_mask);
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -0,0 +1,71 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/probabilistic_circuits/incremental_evaluation.h
+/// \brief Incremental evaluation of EVI queries that differ in only a few variables.
+
+#ifndef AITOOLS_PROBABILISTIC_CIRCUITS_INCREMENTAL_EVALUATION_H
+#define AITOOLS_PROBABILISTIC_CIRCUITS_INCREMENTAL_EVALUATION_H
+
+#include <cstdint>
+#include <vector>
+#include "aitools/probabilistic_circuits/probabilistic_circuit.h"
+#include "aitools/probabilistic_circuits/scope_analysis.h"
+
+namespace aitools {
+
+/// \brief Evaluates a sequence of EVI queries on a probabilistic circuit. Only the nodes that depend on a variable
+/// that changed since the previous query are recomputed. The changes are propagated upward in topological order,
+/// starting from the nodes that read the changed variables directly (terminal nodes and the splitting variables of
+/// sum-split nodes).
+/// \details The values of the previous query are kept in the \c value fields of the nodes. If the nodes are
+/// evaluated by other means in between two queries, for example by \c evi_query_iterative, \c reset must be called.
+class incremental_evaluator
+{
+  private:
+    std::vector<pc_node_ptr> m_nodes;                    // the nodes in topological order
+    std::vector<std::vector<std::uint32_t>> m_parents;   // m_parents[i] contains the positions of the parents of node i
+    std::vector<std::vector<std::uint32_t>> m_readers;   // m_readers[j] contains the positions of the nodes that read variable j
+    std::vector<double> m_x;                             // the evidence of the previous query
+    std::vector<char> m_scheduled;                       // m_scheduled[i] is true if node i is scheduled for recomputation
+    std::vector<std::uint32_t> m_heap;                   // a min-heap of nodes that are scheduled for recomputation
+    std::size_t m_update_count = 0;
+    bool m_log_space = false;
+    bool m_valid = false;
+
+    template <bool LogSpace>
+    void update(const std::vector<double>& x);
+
+    template <bool LogSpace>
+    double evaluate(const std::vector<double>& x);
+
+  public:
+    explicit incremental_evaluator(const probabilistic_circuit& pc);
+
+    incremental_evaluator(const probabilistic_circuit& pc, const scope_analysis& scopes);
+
+    /// \brief Computes the EVI query for evidence \c x.
+    double evi(const std::vector<double>& x);
+
+    /// \brief Computes the log EVI query for evidence \c x.
+    double log_evi(const std::vector<double>& x);
+
+    /// \brief Discards the values of the previous query. The next query recomputes all nodes.
+    void reset()
+    {
+      m_valid = false;
+    }
+
+    /// \brief Returns the number of nodes that were recomputed by the last query.
+    std::size_t update_count() const
+    {
+      return m_update_count;
+    }
+};
+
+} // namespace aitools
+
+#endif // AITOOLS_PROBABILISTIC_CIRCUITS_INCREMENTAL_EVALUATION_H
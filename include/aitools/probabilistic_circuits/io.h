@@ -10,11 +10,15 @@
 #ifndef AITOOLS_PROBABILISTIC_CIRCUITS_IO_H
 #define AITOOLS_PROBABILISTIC_CIRCUITS_IO_H
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include "aitools/decision_trees/splitters_io.h"
+#include "aitools/utilities/format.h"
 #include "aitools/utilities/parse_numbers.h"
 #include "aitools/probabilistic_circuits/probabilistic_circuit.h"
 #include "aitools/utilities/print.h"
@@ -45,66 +49,313 @@ std::unordered_map<std::shared_ptr<pc_node>, std::size_t> make_node_index(const
 inline
 void save_probabilistic_circuit(std::ostream& to, const probabilistic_circuit& pc)
 {
-  std::vector<std::size_t> successors;
-
-  to << "probabilistic_circuit: 1.0\n";
+  utilities::text_buffer out;
+  utilities::format_text(out, "probabilistic_circuit: 1.0\n");
 
   std::unordered_map<std::shared_ptr<pc_node>, std::size_t> node_index = detail::make_node_index(pc);
 
   std::size_t N = node_index.size();
-  to << "pc_size: " << N << "\n";
-  to << "category_counts: " << print_container(pc.category_counts()) << "\n";
+  fmt::format_to(std::back_inserter(out), "pc_size: {}\n", N);
+  utilities::format_container(out, pc.category_counts(), "category_counts: ", "\n");
+  utilities::write_buffer(to, out);
 
-  auto compute_successors = [&node_index, &successors](const std::shared_ptr<pc_node>& u)
+  // the nodes are formatted in parallel; node_index is only read
+  std::vector<std::shared_ptr<pc_node>> order = topological_ordering(pc);
+  utilities::write_parallel(to, order.size(), [&order, &node_index](utilities::text_buffer& out, std::size_t i)
   {
-    successors.clear();
+    const auto& u = order[i];
+    std::vector<std::size_t> successors;
+    successors.reserve(u->successors().size());
     for (const auto& v: u->successors())
     {
-      successors.push_back(node_index[v]);
+      successors.push_back(node_index.at(v));
     }
+    u->save(out, node_index.at(u), successors);
+  });
+}
+
+/// \brief Builds the generative forest of \c forest and saves it to \c to in the same format as
+/// \c save_probabilistic_circuit, without holding the complete circuit in memory. The trees are converted one at a
+/// time; the nodes of a tree are written as soon as it has been converted, after which the tree is released.
+/// With \c hash_consing the terminal nodes are shared between trees, so all terminal nodes of the forest and their
+/// indices are kept in memory until the end. For large forests most nodes are terminal nodes, so then the memory
+/// usage is not much lower than that of \c build_generative_forest, but the output is smaller. Without
+/// \c hash_consing only the nodes of the current tree are kept, at the cost of writing duplicate terminal nodes.
+/// \details The root gets index 0 and is written last. Since the number of nodes is not known in advance, a
+/// placeholder is written in the header, that is overwritten at the end. The circuit is the same as the one returned
+/// by \c build_generative_forest, but the nodes may be numbered differently.
+/// \pre The stream \c to must support seeking.
+/// \return The number of nodes of the circuit.
+inline
+std::size_t build_and_save_generative_forest(std::ostream& to, const random_forest& forest, const dataset& D, bool hash_consing = true, bool sequential = false)
+{
+  const auto& trees = forest.trees();
+  std::size_t N = trees.size();
+  pc_node_factory factory(hash_consing);
+
+  to << "probabilistic_circuit: 1.0\n";
+  to << "pc_size: ";
+  auto pc_size_position = to.tellp();
+  if (pc_size_position == std::ostream::pos_type(-1))
+  {
+    throw std::runtime_error("build_and_save_generative_forest: the output stream does not support seeking");
+  }
+  to << std::string(20, ' ') << "\n";
+  to << "category_counts: " << print_container(D.category_counts()) << "\n";
+
+  utilities::text_buffer out; // the nodes of a tree are collected in a buffer, that is written after each tree
+
+  std::unordered_map<pc_node_ptr, std::size_t> shared_index; // the indices of the terminal nodes
+  std::unordered_map<const pc_node*, std::size_t> tree_index; // the indices of the other nodes of the current tree
+  std::size_t node_count = 1; // index 0 is reserved for the root
+  std::vector<std::size_t> roots;
+  std::vector<std::size_t> successors;
+
+  auto index = [&](const pc_node_ptr& u)
+  {
+    return u->is_leaf() ? shared_index.at(u) : tree_index.at(u.get());
   };
 
-  std::vector<std::shared_ptr<pc_node>> order = topological_ordering(pc);
-  // utilities::stopwatch watch;
-  for (const auto& u: order)
+  for (std::size_t i = 0; i < N; i++)
   {
-    std::size_t ui = node_index[u];
-    compute_successors(u);
-    u->save(to, ui, successors);
+    pc_node_ptr root = build_generative_tree(trees[i], D, factory, sequential);
+    for (const auto& u: topological_ordering(probabilistic_circuit(root, D.category_counts())))
+    {
+      if (u->is_leaf())
+      {
+        if (shared_index.find(u) != shared_index.end())
+        {
+          continue;
+        }
+        shared_index[u] = node_count;
+      }
+      else
+      {
+        tree_index[u.get()] = node_count;
+      }
+      successors.clear();
+      for (const auto& v: u->successors())
+      {
+        successors.push_back(index(v));
+      }
+      u->save(out, node_count++, successors);
+    }
+    utilities::write_buffer(to, out);
+    roots.push_back(index(root));
+    tree_index.clear();
+    if (!hash_consing)
+    {
+      shared_index.clear(); // the terminal nodes are not shared between trees
+    }
   }
-  // AITOOLS_LOG(log::verbose) << "successor computation " << watch.seconds() << " seconds" << std::endl;
+
+  sum_node root(std::vector<double>(N, 1.0 / N));
+  root.save(out, 0, roots);
+  utilities::write_buffer(to, out);
+
+  auto end_position = to.tellp();
+  to.seekp(pc_size_position);
+  to << node_count;
+  to.seekp(end_position);
+  return node_count;
 }
 
+namespace detail {
+
+// A scanner for the lines of the probabilistic circuit format, that reads the tokens of a line in a single pass
+// without allocating memory. Each function skips the spaces behind the token it reads, and throws an exception if the
+// token could not be read.
+class pc_line_scanner
+{
+  private:
+    const std::string& m_line;
+    const char* m_first;
+    const char* m_last;
+
+    [[noreturn]] void fail() const
+    {
+      throw std::runtime_error("Could not parse line '" + m_line + "'");
+    }
+
+    void skip_spaces()
+    {
+      while (m_first != m_last && std::isspace(static_cast<unsigned char>(*m_first)))
+      {
+        ++m_first;
+      }
+    }
+
+  public:
+    explicit pc_line_scanner(const std::string& line)
+      : m_line(line), m_first(line.data()), m_last(line.data() + line.size())
+    {}
+
+    // Skips the keyword at the start of the line, e.g. "sum:"
+    void skip_keyword(std::size_t size)
+    {
+      m_first += size;
+      skip_spaces();
+    }
+
+    bool at(char c) const
+    {
+      return m_first != m_last && *m_first == c;
+    }
+
+    bool at_end() const
+    {
+      return m_first == m_last;
+    }
+
+    void expect(char c)
+    {
+      if (!at(c))
+      {
+        fail();
+      }
+      ++m_first;
+      skip_spaces();
+    }
+
+    void expect_end() const
+    {
+      if (!at_end())
+      {
+        fail();
+      }
+    }
+
+    template <typename Number = std::size_t>
+    Number natural_number()
+    {
+      Number result;
+      auto [p, ec] = std::from_chars(m_first, m_last, result);
+      if (ec != std::errc())
+      {
+        fail();
+      }
+      m_first = p;
+      skip_spaces();
+      return result;
+    }
+
+    double real()
+    {
+      double result;
+      const char* p = parse_next_double(m_first, m_last, result);
+      if (p == m_first)
+      {
+        fail();
+      }
+      m_first = p;
+      skip_spaces();
+      return result;
+    }
+
+    // Reads a binary number, e.g. 0011
+    std::uint32_t binary_number()
+    {
+      if (!at('0') && !at('1'))
+      {
+        fail();
+      }
+      std::uint32_t result = 0;
+      while (at('0') || at('1'))
+      {
+        result = 2 * result + (*m_first - '0');
+        ++m_first;
+      }
+      skip_spaces();
+      return result;
+    }
+
+    // Reads a sequence of natural numbers enclosed in brackets, e.g. [1 2 3]
+    void natural_number_sequence(std::vector<std::size_t>& result)
+    {
+      result.clear();
+      expect('[');
+      while (!at(']'))
+      {
+        result.push_back(natural_number());
+      }
+      expect(']');
+    }
+
+    // Reads a sequence of real numbers enclosed in brackets, e.g. [0.25 0.75]
+    std::vector<double> real_sequence()
+    {
+      std::vector<double> result;
+      expect('[');
+      while (!at(']'))
+      {
+        result.push_back(real());
+      }
+      expect(']');
+      return result;
+    }
+
+    // Reads a splitting criterion, e.g. ThresholdSplit(1, 5.2187)
+    splitting_criterion splitter()
+    {
+      const char* close = std::find(m_first, m_last, ')');
+      if (close == m_last)
+      {
+        fail();
+      }
+      splitting_criterion result = parse_splitting_criterion(std::string(m_first, close + 1));
+      m_first = close + 1;
+      skip_spaces();
+      return result;
+    }
+};
+
+} // namespace detail
+
+/// \brief A parser for the textual format of probabilistic circuits. Each line is scanned once with a hand-written
+/// scanner based on \c std::from_chars.
 class probabilistic_circuit_parser
 {
   protected:
     probabilistic_circuit pc;
     std::vector<std::shared_ptr<pc_node>> vertices;
-    std::regex re_pc_size{R"(pc_size:\s*(\d+)\s*)"};
-    std::regex re_category_counts {R"(category_counts:(.*))"};
-    std::regex re_sum{R"(sum:\s*(\d+)\s*\[([^\]]*)\]\s*\[([^\]]*)\]\s*)"};
-    std::regex re_sum_split{R"(sum_split:\s*(\d+)\s*\[([^\]]*)\]\s*\[([^\]]*)\]\s*(\w+\([^)]*\))\s*)"};
-    std::regex re_product{R"(product:\s*(\d+)\s*\[([^\]]*)\]\s*)"};
-    std::regex re_categorical{R"(categorical:\s*(\d+)\s*\[\]\s*(\d+)\s*\[([^\]]*)\]\s*)"};
-    std::regex re_normal{R"(normal:\s*(\d+)\s*\[\]\s*(\d+)\s*([^\s]+)\s*([^\s]+)\s*)"};
-    std::regex re_truncated_normal{R"(truncated_normal:\s*(\d+)\s*\[\]\s*(\d+)\s*([^\s]+)\s*([^\s]+)\s*([^\s]+)\s*([^\s]+)\s*)"};
-    std::regex re_less{R"(less:\s*(\d+)\s*\[\]\s*(\d+)\s*(.*)\s*)"};
-    std::regex re_greater_equal{R"(greater_equal:\s*(\d+)\s*\[\]\s*(\d+)\s*(.*)\s*)"};
-    std::regex re_equal{R"(equal:\s*(\d+)\s*\[\]\s*(\d+)\s*(.*)\s*)"};
-    std::regex re_not_equal{R"(not_equal:\s*(\d+)\s*\[\]\s*(\d+)\s*(.*)\s*)"};
-    std::regex re_subset{R"(subset:\s*(\d+)\s*\[\]\s*(\d+)\s*([01]+)\s*)"};
-
-    std::vector<std::shared_ptr<pc_node>> parse_successors(const std::string& text) const
-    {
-      std::vector<std::size_t> S = parse_natural_number_sequence(text);
+    std::vector<std::size_t> successor_indices;
+
+    std::vector<std::shared_ptr<pc_node>> parse_successors(detail::pc_line_scanner& scanner)
+    {
+      scanner.natural_number_sequence(successor_indices);
       std::vector<std::shared_ptr<pc_node>> result;
-      result.reserve(S.size());
-      for (auto s: S)
+      result.reserve(successor_indices.size());
+      for (auto s: successor_indices)
       {
+        if (s >= vertices.size() || !vertices[s])
+        {
+          throw std::runtime_error("Undefined successor " + std::to_string(s));
+        }
         result.push_back(vertices[s]);
       }
       return result;
-    };
+    }
+
+    // Reads the index of a node, and makes sure that vertices contains it
+    std::size_t parse_index(detail::pc_line_scanner& scanner)
+    {
+      auto index = scanner.natural_number();
+      if (index >= vertices.size())
+      {
+        vertices.resize(index + 1);
+      }
+      return index;
+    }
+
+    // Reads the index and the scope of a terminal node, e.g. 11 [] 2
+    std::pair<std::size_t, std::size_t> parse_terminal_node(detail::pc_line_scanner& scanner)
+    {
+      auto index = parse_index(scanner);
+      scanner.expect('[');
+      scanner.expect(']');
+      auto scope = scanner.natural_number();
+      return {index, scope};
+    }
 
     void parse_probabilistic_circuit(const std::string& line)
     {
@@ -113,205 +364,186 @@ class probabilistic_circuit_parser
 
     void parse_pc_size(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_pc_size);
-      const auto& m1 = match[1];
-      std::size_t N = parse_natural_number(m1.first, m1.second);
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("pc_size:"));
+      std::size_t N = scanner.natural_number();
+      scanner.expect_end();
       vertices.resize(N);
     }
 
     void parse_category_counts(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_category_counts);
-      const auto& m1 = match[1];
-      pc.category_counts() = parse_natural_number_sequence<unsigned int>(m1.first, m1.second);
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("category_counts:"));
+      std::vector<unsigned int> category_counts;
+      while (!scanner.at_end())
+      {
+        category_counts.push_back(scanner.natural_number<unsigned int>());
+      }
+      pc.category_counts() = std::move(category_counts);
     }
 
     void parse_sum(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_sum);
-      const auto& m1 = match[1];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto successors = parse_successors(match.str(2));
-      auto weights = parse_double_sequence(match.str(3));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("sum:"));
+      auto index = parse_index(scanner);
+      auto successors = parse_successors(scanner);
+      auto weights = scanner.real_sequence();
+      scanner.expect_end();
       vertices[index] = std::make_shared<sum_node>(std::move(weights));
       vertices[index]->successors() = std::move(successors);
     }
 
     void parse_sum_split(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_sum_split);
-      const auto& m1 = match[1];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto successors = parse_successors(match.str(2));
-      auto weights = parse_double_sequence(match.str(3));
-      splitting_criterion split = parse_splitting_criterion(match.str(4));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("sum_split:"));
+      auto index = parse_index(scanner);
+      auto successors = parse_successors(scanner);
+      auto weights = scanner.real_sequence();
+      splitting_criterion split = scanner.splitter();
+      scanner.expect_end();
       vertices[index] = std::make_shared<sum_split_node>(std::move(weights), split);
       vertices[index]->successors() = std::move(successors);
     }
 
     void parse_product(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_product);
-      const auto& m1 = match[1];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto successors = parse_successors(match.str(2));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("product:"));
+      auto index = parse_index(scanner);
+      auto successors = parse_successors(scanner);
+      scanner.expect_end();
       vertices[index] = std::make_shared<product_node>();
       vertices[index]->successors() = std::move(successors);
     }
 
     void parse_categorical(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_categorical);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto probabilities = parse_double_sequence(match.str(3));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("categorical:"));
+      auto [index, scope] = parse_terminal_node(scanner);
+      auto probabilities = scanner.real_sequence();
+      scanner.expect_end();
       vertices[index] = std::make_shared<categorical_node>(scope, std::move(probabilities));
     }
 
     void parse_normal(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_normal);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto mu = parse_double(match.str(3));
-      auto sigma = parse_double(match.str(4));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("normal:"));
+      auto [index, scope] = parse_terminal_node(scanner);
+      auto mu = scanner.real();
+      auto sigma = scanner.real();
+      scanner.expect_end();
       vertices[index] = std::make_shared<normal_node>(scope, mu, sigma);
     }
 
     void parse_truncated_normal(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_truncated_normal);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto mu = parse_double(match.str(3));
-      auto sigma = parse_double(match.str(4));
-      auto a = parse_double(match.str(5));
-      auto b = parse_double(match.str(6));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("truncated_normal:"));
+      auto [index, scope] = parse_terminal_node(scanner);
+      auto mu = scanner.real();
+      auto sigma = scanner.real();
+      auto a = scanner.real();
+      auto b = scanner.real();
+      scanner.expect_end();
       vertices[index] = std::make_shared<truncated_normal_node>(scope, mu, sigma, a, b);
     }
 
-    void parse_less(const std::string& line)
-    {
-      std::smatch match = utilities::regex_match(line, re_less);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto value = parse_double(match.str(3));
-      vertices[index] = std::make_shared<less_node>(scope, value);
-    }
-
-    void parse_greater_equal(const std::string& line)
+    // Parses an indicator node with a value, e.g. less: 5 [] 1 2.5
+    template <typename Node>
+    void parse_indicator(const std::string& line, std::size_t keyword_size)
     {
-      std::smatch match = utilities::regex_match(line, re_greater_equal);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto value = parse_double(match.str(3));
-      vertices[index] = std::make_shared<greater_equal_node>(scope, value);
-    }
-
-    void parse_equal(const std::string& line)
-    {
-      std::smatch match = utilities::regex_match(line, re_equal);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto value = parse_double(match.str(3));
-      vertices[index] = std::make_shared<equal_node>(scope, value);
-    }
-
-    void parse_not_equal(const std::string& line)
-    {
-      std::smatch match = utilities::regex_match(line, re_not_equal);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      auto value = parse_double(match.str(3));
-      vertices[index] = std::make_shared<not_equal_node>(scope, value);
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(keyword_size);
+      auto [index, scope] = parse_terminal_node(scanner);
+      auto value = scanner.real();
+      scanner.expect_end();
+      vertices[index] = std::make_shared<Node>(scope, value);
     }
 
     void parse_subset(const std::string& line)
     {
-      std::smatch match = utilities::regex_match(line, re_subset);
-      const auto& m1 = match[1];
-      const auto& m2 = match[2];
-      auto index = parse_natural_number(m1.first, m1.second);
-      auto scope = parse_natural_number(m2.first, m2.second);
-      uint32_t mask = parse_binary_number(match.str(2));
+      detail::pc_line_scanner scanner(line);
+      scanner.skip_keyword(std::strlen("subset:"));
+      auto [index, scope] = parse_terminal_node(scanner);
+      uint32_t mask = scanner.binary_number();
+      scanner.expect_end();
       vertices[index] = std::make_shared<subset_node>(scope, mask);
     }
 
   public:
     void parse_line(const std::string& line)
     {
-      if (utilities::starts_with(line, "probabilistic_circuit:"))
+      auto starts_with = [&line](const char* prefix)
+      {
+        return line.compare(0, std::strlen(prefix), prefix) == 0;
+      };
+
+      if (starts_with("probabilistic_circuit:"))
       {
         parse_probabilistic_circuit(line);
       }
-      else if (utilities::starts_with(line, "pc_size:"))
+      else if (starts_with("pc_size:"))
       {
         parse_pc_size(line);
       }
-      else if (utilities::starts_with(line, "category_counts:"))
+      else if (starts_with("category_counts:"))
       {
         parse_category_counts(line);
       }
       // sum: 0 [1 2 3 4 5 6 7 8 9 10] [0.1 0.1 0.1 0.1 0.1 0.1 0.1 0.1 0.1 0.1]
-      else if (utilities::starts_with(line, "sum:"))
+      else if (starts_with("sum:"))
       {
         parse_sum(line);
       }
       // sum_split: 3 [7 8] [0.166667 0.833333] SingleSplit(1, 0)
-      else if (utilities::starts_with(line, "sum_split:"))
+      else if (starts_with("sum_split:"))
       {
         parse_sum_split(line);
       }
       // product: 4 [9 10 11]
-      else if (utilities::starts_with(line, "product:"))
+      else if (starts_with("product:"))
       {
         parse_product(line);
       }
       // categorical: 11 [] 2 [0.333333 0.666667]
-      else if (utilities::starts_with(line, "categorical:"))
+      else if (starts_with("categorical:"))
       {
         parse_categorical(line);
       }
       // normal: 96 [] 17 100.181 1e-5
-      else if (utilities::starts_with(line, "normal:"))
+      else if (starts_with("normal:"))
       {
         parse_normal(line);
       }
-      else if (utilities::starts_with(line, "truncated_normal:"))
+      // truncated_normal: 7482 [] 0 -1.54837 0.472953 -1.79769e+308 -0.5058
+      else if (starts_with("truncated_normal:"))
       {
         parse_truncated_normal(line);
       }
-      else if (utilities::starts_with(line, "less:"))
+      // less: 5 [] 1 2.5
+      else if (starts_with("less:"))
       {
-        parse_less(line);
+        parse_indicator<less_node>(line, std::strlen("less:"));
       }
-      else if (utilities::starts_with(line, "greater_equal:"))
+      else if (starts_with("greater_equal:"))
       {
-        parse_greater_equal(line);
+        parse_indicator<greater_equal_node>(line, std::strlen("greater_equal:"));
       }
-      else if (utilities::starts_with(line, "equal:"))
+      else if (starts_with("equal:"))
       {
-        parse_equal(line);
+        parse_indicator<equal_node>(line, std::strlen("equal:"));
       }
-      else if (utilities::starts_with(line, "not_equal:"))
+      else if (starts_with("not_equal:"))
       {
-        parse_not_equal(line);
+        parse_indicator<not_equal_node>(line, std::strlen("not_equal:"));
       }
-      else if (utilities::starts_with(line, "subset:"))
+      // subset: 6 [] 2 0011
+      else if (starts_with("subset:"))
       {
         parse_subset(line);
       }
@@ -0,0 +1,171 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/probabilistic_circuits/layered_circuit.h
+/// \brief A representation of probabilistic circuits as a sequence of dense layers.
+
+#ifndef AITOOLS_PROBABILISTIC_CIRCUITS_LAYERED_CIRCUIT_H
+#define AITOOLS_PROBABILISTIC_CIRCUITS_LAYERED_CIRCUIT_H
+
+#include <cstdint>
+#include <vector>
+#include "aitools/datasets/dataset.h"
+#include "aitools/numerics/matrix.h"
+#include "aitools/probabilistic_circuits/probabilistic_circuit.h"
+
+namespace aitools {
+
+/// \brief A probabilistic circuit in which the nodes are grouped into layers. The depth of a terminal node is 0, and
+/// the depth of another node is one more than the maximum depth of its successors. A layer consists of the nodes with
+/// the same depth and the same type, so the nodes of a layer only depend on the nodes of earlier layers.
+/// \details The nodes are numbered layer by layer, so each layer occupies a contiguous range of positions. The
+/// inputs of sum and product layers are stored as gather-index arrays in compressed sparse row format: the inputs of
+/// node \c i are <tt>[first_input(i), last_input(i))</tt>. For sum nodes the log weights of the inputs are stored
+/// alongside. The root is the last node.
+class layered_circuit
+{
+  public:
+    enum class layer_kind : std::uint8_t { input, sum, product };
+
+    /// \brief A layer consists of the nodes <tt>[first, last)</tt>.
+    struct layer
+    {
+      layer_kind kind;
+      std::uint32_t first;
+      std::uint32_t last;
+
+      std::size_t width() const
+      {
+        return last - first;
+      }
+    };
+
+  private:
+    std::vector<layer> m_layers;
+    std::vector<pc_node_ptr> m_nodes;
+    std::vector<std::uint32_t> m_offsets;  // the inputs of node i are [m_offsets[i], m_offsets[i+1])
+    std::vector<std::uint32_t> m_inputs;   // m_inputs[e] is the position of input e
+    std::vector<double> m_log_weights;     // m_log_weights[e] is the log weight of input e, or 0 for product inputs
+    std::vector<unsigned int> m_category_counts;
+
+  public:
+    /// \pre The circuit contains no sum-split nodes. They can be removed with \c expand_sum_split_nodes.
+    explicit layered_circuit(const probabilistic_circuit& pc);
+
+    /// \brief Returns the number of nodes.
+    std::size_t size() const
+    {
+      return m_nodes.size();
+    }
+
+    /// \brief Returns the position of the root node.
+    std::size_t root() const
+    {
+      return m_nodes.size() - 1;
+    }
+
+    const std::vector<layer>& layers() const
+    {
+      return m_layers;
+    }
+
+    const pc_node& node(std::size_t i) const
+    {
+      return *m_nodes[i];
+    }
+
+    std::size_t first_input(std::size_t i) const
+    {
+      return m_offsets[i];
+    }
+
+    std::size_t last_input(std::size_t i) const
+    {
+      return m_offsets[i + 1];
+    }
+
+    /// \brief Returns the position of input \c e.
+    std::size_t input(std::size_t e) const
+    {
+      return m_inputs[e];
+    }
+
+    double log_weight(std::size_t e) const
+    {
+      return m_log_weights[e];
+    }
+
+    const std::vector<unsigned int>& category_counts() const
+    {
+      return m_category_counts;
+    }
+};
+
+/// \brief Evaluates a layered circuit on batches of rows. The log-values of node \c i for all rows of a batch are
+/// stored contiguously, so a layer of width \c w occupies a contiguous block of <tt>w * capacity</tt> doubles, and
+/// each layer is evaluated by one kernel that runs over its nodes and the rows of the batch.
+/// \details Normal and truncated normal leaves are evaluated with the vectorized \c simd::normal_log_pdf kernel on the
+/// columns of the batch. Other leaves are evaluated with \c log_evi.
+class layered_evaluator
+{
+  private:
+    const layered_circuit& m_circuit;
+    std::size_t m_capacity;
+    std::size_t m_row_count = 0;
+    std::vector<double> m_log_values;
+    std::vector<double> m_columns;  // the columns of the batch, m_columns[j * capacity + r] = X[first + r][j]
+    std::size_t m_grain_size;
+    std::vector<double> m_buffers;       // two scratch buffers of size capacity for each chunk of a layer
+    std::vector<std::size_t> m_chunks;   // the indices of the chunks of the widest layer
+
+    // Checks the size of the batch, and stores its columns in m_columns
+    void start_batch(const numerics::matrix<double>& X, std::size_t first, std::size_t last);
+
+    // Evaluates the nodes [first, last) of layer l
+    void evaluate_layer(const layered_circuit::layer& l, std::size_t first, std::size_t last, const numerics::matrix<double>& X, std::size_t row_offset, double* max_value, double* term);
+
+  public:
+    /// \param capacity The maximum number of rows in a batch.
+    /// \param grain_size The number of nodes of a layer that are evaluated by one task in \c forward_parallel.
+    layered_evaluator(const layered_circuit& circuit, std::size_t capacity, std::size_t grain_size = 256);
+
+    /// \brief Computes the log-values of all nodes for the rows <tt>X[first], ..., X[last - 1]</tt>.
+    /// \pre <tt>last - first <= capacity</tt>
+    void forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last);
+
+    /// \brief Computes the same values as \c forward, but evaluates the nodes of each layer in parallel. The layers
+    /// are divided into chunks of \c grain_size nodes, that are evaluated as parallel tasks. Layers consisting of a
+    /// single chunk are evaluated sequentially. This reduces the latency of very large circuits, also for a
+    /// single row.
+    /// \pre <tt>last - first <= capacity</tt>
+    void forward_parallel(const numerics::matrix<double>& X, std::size_t first, std::size_t last);
+
+    /// \brief Returns the number of rows of the last forward pass.
+    std::size_t row_count() const
+    {
+      return m_row_count;
+    }
+
+    /// \brief Returns the log-values of node \c i, one for each row.
+    const double* log_values(std::size_t i) const
+    {
+      return m_log_values.data() + i * m_capacity;
+    }
+
+    /// \brief Returns the log-likelihood of row \c r.
+    double log_likelihood(std::size_t r) const
+    {
+      return log_values(m_circuit.root())[r];
+    }
+};
+
+/// \brief Computes the log-likelihood of all rows of the dataset \c D with a layered circuit.
+/// \param parallel If true, the layers are evaluated with \c layered_evaluator::forward_parallel.
+std::vector<double> log_evi_layered(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size = 64, bool parallel = false);
+
+} // namespace aitools
+
+#endif // AITOOLS_PROBABILISTIC_CIRCUITS_LAYERED_CIRCUIT_H
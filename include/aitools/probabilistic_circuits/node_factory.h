@@ -0,0 +1,184 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/probabilistic_circuits/node_factory.h
+/// \brief A factory for terminal nodes that shares structurally equal nodes.
+
+#ifndef AITOOLS_PROBABILISTIC_CIRCUITS_NODE_FACTORY_H
+#define AITOOLS_PROBABILISTIC_CIRCUITS_NODE_FACTORY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <boost/container_hash/hash.hpp>
+#include "aitools/probabilistic_circuits/generative_forest_nodes.h"
+#include "aitools/probabilistic_circuits/probabilistic_circuit_nodes.h"
+
+namespace aitools {
+
+/// \brief Creates the terminal nodes (leaves and indicators) of a probabilistic circuit. If hash-consing is enabled,
+/// a node with the same type, scope and parameters as a node that was created before is not created again; instead
+/// the existing node is returned. This way structurally equal nodes are shared in the circuit.
+/// \details Parameters are compared exactly; nodes with NaN parameters are never shared. The factory is thread safe:
+/// the nodes are stored in a number of shards that are each protected by a mutex, so threads that request nodes
+/// with different keys rarely block each other. Each key is mapped to exactly one node, so the sharing structure of
+/// the created circuit does not depend on the order in which the threads request the nodes.
+class pc_node_factory
+{
+  private:
+    enum class node_type { categorical, normal, truncated_normal, less, greater_equal, equal, not_equal, subset };
+
+    struct node_key
+    {
+      node_type type;
+      unsigned int scope;
+      std::vector<double> parameters;
+
+      bool operator==(const node_key& other) const
+      {
+        return type == other.type && scope == other.scope && parameters == other.parameters;
+      }
+    };
+
+    struct node_key_hash
+    {
+      std::size_t operator()(const node_key& key) const
+      {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, static_cast<int>(key.type));
+        boost::hash_combine(seed, key.scope);
+        boost::hash_range(seed, key.parameters.begin(), key.parameters.end());
+        return seed;
+      }
+    };
+
+    struct shard
+    {
+      std::mutex mutex;
+      std::unordered_map<node_key, pc_node_ptr, node_key_hash> nodes;
+    };
+
+    static constexpr std::size_t shard_count = 64;
+
+    bool m_hash_consing;
+    std::array<shard, shard_count> m_shards;
+    std::atomic<std::size_t> m_request_count{0};
+
+    // Returns the node with the given key. If it does not exist, it is created using make_node.
+    template <typename MakeNode>
+    pc_node_ptr find_or_create(node_key key, MakeNode make_node)
+    {
+      m_request_count++;
+      if (!m_hash_consing)
+      {
+        return make_node();
+      }
+      shard& s = m_shards[node_key_hash()(key) % shard_count];
+      std::lock_guard<std::mutex> lock(s.mutex);
+      auto i = s.nodes.find(key);
+      if (i != s.nodes.end())
+      {
+        return i->second;
+      }
+      pc_node_ptr result = make_node();
+      s.nodes.emplace(std::move(key), result);
+      return result;
+    }
+
+  public:
+    explicit pc_node_factory(bool hash_consing = true)
+      : m_hash_consing(hash_consing)
+    {}
+
+    pc_node_ptr make_categorical(unsigned int scope, std::vector<double> probabilities)
+    {
+      return find_or_create({node_type::categorical, scope, probabilities}, [&]()
+      {
+        return std::make_shared<categorical_node>(scope, std::move(probabilities));
+      });
+    }
+
+    pc_node_ptr make_normal(unsigned int scope, double mean, double standard_deviation)
+    {
+      return find_or_create({node_type::normal, scope, {mean, standard_deviation}}, [&]()
+      {
+        return std::make_shared<normal_node>(scope, mean, standard_deviation);
+      });
+    }
+
+    pc_node_ptr make_truncated_normal(unsigned int scope, double mean, double standard_deviation, double a, double b)
+    {
+      return find_or_create({node_type::truncated_normal, scope, {mean, standard_deviation, a, b}}, [&]()
+      {
+        return std::make_shared<truncated_normal_node>(scope, mean, standard_deviation, a, b);
+      });
+    }
+
+    pc_node_ptr make_less(unsigned int scope, double value)
+    {
+      return find_or_create({node_type::less, scope, {value}}, [&]()
+      {
+        return std::make_shared<less_node>(scope, value);
+      });
+    }
+
+    pc_node_ptr make_greater_equal(unsigned int scope, double value)
+    {
+      return find_or_create({node_type::greater_equal, scope, {value}}, [&]()
+      {
+        return std::make_shared<greater_equal_node>(scope, value);
+      });
+    }
+
+    pc_node_ptr make_equal(unsigned int scope, double value)
+    {
+      return find_or_create({node_type::equal, scope, {value}}, [&]()
+      {
+        return std::make_shared<equal_node>(scope, value);
+      });
+    }
+
+    pc_node_ptr make_not_equal(unsigned int scope, double value)
+    {
+      return find_or_create({node_type::not_equal, scope, {value}}, [&]()
+      {
+        return std::make_shared<not_equal_node>(scope, value);
+      });
+    }
+
+    pc_node_ptr make_subset(unsigned int scope, std::uint32_t mask)
+    {
+      return find_or_create({node_type::subset, scope, {static_cast<double>(mask)}}, [&]()
+      {
+        return std::make_shared<subset_node>(scope, mask);
+      });
+    }
+
+    /// \brief Returns the number of nodes that were requested from the factory.
+    std::size_t request_count() const
+    {
+      return m_request_count;
+    }
+
+    /// \brief Returns the number of distinct nodes that were created (only maintained if hash-consing is enabled).
+    std::size_t size() const
+    {
+      std::size_t result = 0;
+      for (const shard& s: m_shards)
+      {
+        result += s.nodes.size();
+      }
+      return result;
+    }
+};
+
+} // namespace aitools
+
+#endif // AITOOLS_PROBABILISTIC_CIRCUITS_NODE_FACTORY_H
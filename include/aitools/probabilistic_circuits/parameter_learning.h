@@ -0,0 +1,57 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/probabilistic_circuits/parameter_learning.h
+/// \brief Learning the parameters of a probabilistic circuit with the EM algorithm.
+
+#ifndef AITOOLS_PROBABILISTIC_CIRCUITS_PARAMETER_LEARNING_H
+#define AITOOLS_PROBABILISTIC_CIRCUITS_PARAMETER_LEARNING_H
+
+#include <iostream>
+#include <vector>
+#include "aitools/datasets/dataset.h"
+#include "aitools/probabilistic_circuits/probabilistic_circuit.h"
+
+namespace aitools {
+
+struct em_options
+{
+  std::size_t iterations = 10;
+  std::size_t batch_size = 64;            // the number of rows in a minibatch
+  std::size_t thread_count = 0;           // the number of threads; if it is 0, the number of hardware threads is used
+  double weight_smoothing = 0;            // a pseudo count that is added to the expected counts of sum edges and categories
+  double min_standard_deviation = 1e-6;   // a lower bound for the standard deviations of (truncated) normal leaves
+};
+
+inline
+std::ostream& operator<<(std::ostream& out, const em_options& options)
+{
+  out << "iterations = " << options.iterations << std::endl;
+  out << "batch-size = " << options.batch_size << std::endl;
+  out << "thread-count = " << options.thread_count << std::endl;
+  out << "weight-smoothing = " << options.weight_smoothing << std::endl;
+  out << "min-standard-deviation = " << options.min_standard_deviation << std::endl;
+  return out;
+}
+
+/// \brief Learns the weights of the sum nodes and the parameters of the leaves of \c pc from the dataset \c D, using
+/// the EM algorithm. In each iteration the dataset is processed in minibatches of rows. Each thread computes the
+/// expected counts of its minibatches with a forward and a backward pass, and the per-thread counts are merged
+/// with a parallel reduction. Then all parameters are replaced by their maximum likelihood estimates:
+/// - the weights of sum and sum-split nodes become the normalized expected counts of their edges
+/// - the probabilities of categorical leaves become the normalized expected counts of the categories
+/// - the mean and standard deviation of (truncated) normal leaves become the weighted mean and standard deviation
+///   of the observed values, with the flows of the leaf as weights. The bounds of truncated normal leaves are not
+///   changed, and the truncation is not taken into account.
+/// Missing values do not contribute to the statistics of a leaf. Parameters without any expected counts are kept.
+/// \details The minibatches are assigned to the threads in a fixed pattern, so the result only depends on the
+/// number of threads. Nodes that are shared by multiple parents are updated once, using the flows of all parents.
+/// \return The average log-likelihood of \c D before each iteration.
+std::vector<double> learn_parameters_em(probabilistic_circuit& pc, const dataset& D, const em_options& options = em_options());
+
+} // namespace aitools
+
+#endif // AITOOLS_PROBABILISTIC_CIRCUITS_PARAMETER_LEARNING_H
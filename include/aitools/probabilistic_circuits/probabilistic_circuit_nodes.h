@@ -10,15 +10,20 @@
 #ifndef AITOOLS_PROBABILISTIC_CIRCUITS_PROBABILISTIC_CIRCUIT_NODES_H
 #define AITOOLS_PROBABILISTIC_CIRCUITS_PROBABILISTIC_CIRCUIT_NODES_H
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <random>
 #include <stdexcept>
+#include <string_view>
 #include <vector>
 #include "aitools/decision_trees/splitters.h"
 #include "aitools/numerics/math_functions.h"
+#include "aitools/numerics/simd_functions.h"
 #include "aitools/statistics/distributions.h"
 #include "aitools/statistics/sampling.h"
+#include "aitools/utilities/format.h"
 #include "aitools/utilities/logger.h"
 #include "aitools/utilities/print.h"
 #include "aitools/utilities/stack_array.h"
@@ -36,10 +41,10 @@ class pc_node : public std::enable_shared_from_this<pc_node>
     std::vector<pc_node_ptr> m_successors;
 
     // saves the common part of all PC nodes
-    void save_node(std::ostream& out, const std::string& name, std::size_t index, const std::vector <std::size_t>& successors) const
+    void save_node(utilities::text_buffer& out, std::string_view name, std::size_t index, const std::vector <std::size_t>& successors) const
     {
-      out << name << ": " << index << ' ';
-      print_container(out, successors, "[", "]", " ");
+      fmt::format_to(std::back_inserter(out), "{}: {} ", name, index);
+      utilities::format_container(out, successors, "[", "]", " ");
     }
 
   public:
@@ -78,22 +83,42 @@ class pc_node : public std::enable_shared_from_this<pc_node>
     /// \brief Draw a random sample. This is a generic implementation for PCs.
     virtual void sample(std::vector<double>& x, std::mt19937& rng) const = 0;
 
-    /// \brief Saves the node in a simple textual format to the stream \c out.
+    /// \brief Appends the node in a simple textual format to the buffer \c out.
     /// \param i The index of the node.
     /// \param successors The successors of the nodes: <tt>successors[i]</tt> contains the indices of the successors
     /// of the node with index \c i.
-    virtual void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const = 0;
+    virtual void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const = 0;
 };
 
 class sum_node : public pc_node
 {
   protected:
     std::vector<double> m_weights;
+    std::vector<double> m_log_weights; // m_log_weights[i] = log(m_weights[i])
+    lazy_alias_table m_alias_table;    // used for sampling a successor, constructed on first use
+
+    void compute_log_weights()
+    {
+      m_log_weights.clear();
+      m_log_weights.reserve(m_weights.size());
+      for (double w: m_weights)
+      {
+        m_log_weights.push_back(std::log(w));
+      }
+    }
+
+    // For a few successors the inline scalar version is faster than a call to the vectorized kernel
+    static double log_sum_exp_successors(const double* first, const double* last)
+    {
+      constexpr std::ptrdiff_t simd_threshold = 8;
+      return last - first < simd_threshold ? log_sum_exp(first, last) : simd::log_sum_exp(first, last);
+    }
 
   public:
     explicit sum_node(std::vector<double> weights)
       : m_weights(std::move(weights))
     {
+      compute_log_weights();
     }
 
     const std::vector<double>& weights() const
@@ -101,11 +126,20 @@ class sum_node : public pc_node
       return m_weights;
     };
 
-    std::vector<double>& weights()
+    const std::vector<double>& log_weights() const
     {
-      return m_weights;
+      return m_log_weights;
     };
 
+    /// \brief Replaces the weights of the node. The cached logarithms of the weights and the alias table are updated
+    /// accordingly.
+    void set_weights(std::vector<double> weights)
+    {
+      m_weights = std::move(weights);
+      compute_log_weights();
+      m_alias_table.reset();
+    }
+
     double evi(const std::vector<double>& x) const override
     {
       std::size_t p = m_successors.size();
@@ -123,9 +157,9 @@ class sum_node : public pc_node
       AITOOLS_DECLARE_STACK_ARRAY(result, double, p);
       for (std::size_t i = 0; i < p; i++)
       {
-        result[i] = std::log(m_weights[i]) + m_successors[i]->log_evi(x);
+        result[i] = m_log_weights[i] + m_successors[i]->log_evi(x);
       }
-      return log_sum_exp(result.begin(), result.end());
+      return log_sum_exp_successors(result.begin(), result.end());
     }
 
     void evi_iterative(const std::vector<double>& x) const override
@@ -144,24 +178,22 @@ class sum_node : public pc_node
       AITOOLS_DECLARE_STACK_ARRAY(result, double, p);
       for (std::size_t i = 0; i < p; i++)
       {
-        result[i] = std::log(m_weights[i]) + m_successors[i]->log_evi(x);
+        result[i] = m_log_weights[i] + m_successors[i]->value;
       }
-      value = log_sum_exp(result.begin(), result.end());
+      value = log_sum_exp_successors(result.begin(), result.end());
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
     {
-      std::uniform_real_distribution<double> uni(0, 1);
-      double p = uni(rng);
-      std::size_t j = detail::find_categorical_section(m_weights, p);
+      std::size_t j = m_alias_table.get(m_weights).sample(rng);
       const auto& v_j = m_successors[j];
       v_j->sample(x, rng);
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "sum", index, successors);
-      out << ' ' << print_container(m_weights, "[", "]", " ") << "\n";
+      utilities::format_container(out, m_weights, " [", "]\n", " ");
     }
 };
 
@@ -185,7 +217,7 @@ class sum_split_node : public sum_node
     double log_evi(const std::vector<double>& x) const override
     {
       std::size_t i = select(m_splitter, x);
-      return std::log(m_weights[i]) + m_successors[i]->log_evi(x);
+      return m_log_weights[i] + m_successors[i]->log_evi(x);
     }
 
     void evi_iterative(const std::vector<double>& x) const override
@@ -197,13 +229,15 @@ class sum_split_node : public sum_node
     void log_evi_iterative(const std::vector<double>& x) const override
     {
       std::size_t i = select(m_splitter, x);
-      value = std::log(m_weights[i]) + m_successors[i]->value;
+      value = m_log_weights[i] + m_successors[i]->value;
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "sum_split", index, successors);
-      out << ' ' << print_container(m_weights, "[", "]", " ") << ' ' << m_splitter << "\n";
+      utilities::format_container(out, m_weights, " [", "] ", " ");
+      format_split(out, m_splitter);
+      out.push_back('\n');
     }
 
     const splitting_criterion& splitter() const
@@ -213,9 +247,7 @@ class sum_split_node : public sum_node
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
     {
-      std::uniform_real_distribution<double> uni(0, 1);
-      double p = uni(rng);
-      std::size_t j = detail::find_categorical_section(m_weights, p);
+      std::size_t j = m_alias_table.get(m_weights).sample(rng);
       const auto& v_j = m_successors[j];
       v_j->sample(x, rng);
     }
@@ -261,7 +293,7 @@ class product_node : public pc_node
       value = 1;
       for (std::size_t i = 0; i < p; i++)
       {
-        value *= m_successors[i]->evi(x);
+        value *= m_successors[i]->value;
         if (value <= 0)
         {
           break;
@@ -275,7 +307,7 @@ class product_node : public pc_node
       value = 0;
       for (std::size_t i = 0; i < p; i++)
       {
-        value += m_successors[i]->log_evi(x);
+        value += m_successors[i]->value;
         if (value <= -infinity)
         {
           break;
@@ -291,10 +323,10 @@ class product_node : public pc_node
       }
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "product", index, successors);
-      out << "\n";
+      out.push_back('\n');
     }
 };
 
@@ -323,6 +355,13 @@ class terminal_node : public pc_node
     {
       value = log_evi(x);
     }
+
+    /// \brief Returns a value of the variable for which the terminal node attains its maximum, or NaN if the node
+    /// has no preferred value (e.g. an indicator).
+    virtual double mode() const
+    {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
 };
 
 /// \brief A terminal node that models a categorical distribution
@@ -351,7 +390,12 @@ class categorical_node : public terminal_node
 
     double log_evi(const std::vector<double>& x) const override
     {
-      return std::log(evi(x));
+      double x_i = x[m_scope];
+      if (is_missing(x_i))
+      {
+        return 0;
+      }
+      return m_dist.log_pdf(x_i);
     }
 
     std::vector<double> probabilities() const
@@ -359,10 +403,22 @@ class categorical_node : public terminal_node
       return m_dist.probabilities();
     };
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void set_probabilities(std::vector<double> probabilities)
+    {
+      m_dist = categorical_distribution(std::move(probabilities));
+    }
+
+    double mode() const override
+    {
+      const auto& p = m_dist.probabilities();
+      return static_cast<double>(std::max_element(p.begin(), p.end()) - p.begin());
+    }
+
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "categorical", index, successors);
-      out << ' ' << m_scope << ' ' << print_container(m_dist.probabilities(), "[", "]", " ") << "\n";
+      fmt::format_to(std::back_inserter(out), " {} ", m_scope);
+      utilities::format_container(out, m_dist.probabilities(), "[", "]\n", " ");
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -397,6 +453,16 @@ class normal_node : public terminal_node
       return m_dist.standard_deviation();
     };
 
+    void set_parameters(double mean, double standard_deviation)
+    {
+      m_dist = normal_distribution(mean, standard_deviation);
+    }
+
+    double mode() const override
+    {
+      return m_dist.mean();
+    }
+
     /// \brief The probability density function
     double evi(const std::vector<double>& x) const override
     {
@@ -413,13 +479,18 @@ class normal_node : public terminal_node
     /// \brief The log probability density function
     double log_evi(const std::vector<double>& x) const override
     {
-      return std::log(evi(x));
+      double x_i = x[m_scope];
+      if (is_missing(x_i))
+      {
+        return 0;
+      }
+      return m_dist.log_pdf(x_i);
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "normal", index, successors);
-      out << ' ' << m_scope << ' ' << m_dist.mean() << ' ' << m_dist.standard_deviation() << "\n";
+      fmt::format_to(std::back_inserter(out), " {} {} {}\n", m_scope, m_dist.mean(), m_dist.standard_deviation());
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
@@ -462,6 +533,22 @@ class truncated_normal_node : public terminal_node
       return m_dist.normal().standard_deviation();
     };
 
+    const truncated_normal_distribution& distribution() const
+    {
+      return m_dist;
+    }
+
+    /// \brief Changes the mean and standard deviation of the underlying normal distribution. The bounds are unchanged.
+    void set_parameters(double mean, double standard_deviation)
+    {
+      m_dist = truncated_normal_distribution(mean, standard_deviation, m_dist.a(), m_dist.b());
+    }
+
+    double mode() const override
+    {
+      return std::clamp(m_dist.normal().mean(), m_dist.a(), m_dist.b());
+    }
+
     double a() const
     {
       return m_dist.a();
@@ -488,14 +575,18 @@ class truncated_normal_node : public terminal_node
     /// \brief The log probability density function
     double log_evi(const std::vector<double>& x) const override
     {
-      return std::log(evi(x));
+      double x_i = x[m_scope];
+      if (is_missing(x_i))
+      {
+        return 0;
+      }
+      return m_dist.log_pdf(x_i);
     }
 
-    void save(std::ostream& out, std::size_t index, const std::vector <std::size_t>& successors) const override
+    void save(utilities::text_buffer& out, std::size_t index, const std::vector <std::size_t>& successors) const override
     {
       save_node(out, "truncated_normal", index, successors);
-      out << ' ' << m_scope << ' ' << m_dist.normal().mean() << ' ' << m_dist.normal().standard_deviation() << ' '
-          << m_dist.a() << ' ' << m_dist.b() << "\n";
+      fmt::format_to(std::back_inserter(out), " {} {} {} {} {}\n", m_scope, m_dist.normal().mean(), m_dist.normal().standard_deviation(), m_dist.a(), m_dist.b());
     }
 
     void sample(std::vector<double>& x, std::mt19937& rng) const override
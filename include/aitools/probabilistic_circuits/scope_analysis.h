@@ -0,0 +1,68 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/probabilistic_circuits/scope_analysis.h
+/// \brief Computes the scopes of the nodes of a probabilistic circuit.
+
+#ifndef AITOOLS_PROBABILISTIC_CIRCUITS_SCOPE_ANALYSIS_H
+#define AITOOLS_PROBABILISTIC_CIRCUITS_SCOPE_ANALYSIS_H
+
+#include <unordered_map>
+#include <vector>
+#include <boost/dynamic_bitset.hpp>
+#include "aitools/probabilistic_circuits/probabilistic_circuit.h"
+
+namespace aitools {
+
+/// \brief The scope of a node is the set of random variables of the leaves below it. The scope analysis visits the
+/// nodes of a probabilistic circuit once, in topological order, and stores the scopes as bitsets. Nodes that are
+/// shared by several parents are analyzed only once.
+class scope_analysis
+{
+  public:
+    using scope_type = boost::dynamic_bitset<>;
+
+  private:
+    std::vector<pc_node_ptr> m_nodes; // the nodes in topological order, successors before predecessors
+    std::unordered_map<const pc_node*, std::size_t> m_index; // m_index[u] is the position of u in m_nodes
+    std::vector<scope_type> m_scopes;
+
+  public:
+    explicit scope_analysis(const probabilistic_circuit& pc);
+
+    /// \brief Returns the nodes of the circuit in topological order: successors appear before their predecessors.
+    const std::vector<pc_node_ptr>& nodes() const
+    {
+      return m_nodes;
+    }
+
+    /// \brief Returns the position of node \c u in \c nodes().
+    std::size_t index(const pc_node* u) const
+    {
+      return m_index.at(u);
+    }
+
+    std::size_t index(const pc_node_ptr& u) const
+    {
+      return index(u.get());
+    }
+
+    /// \brief Returns the scope of the node with position \c i in \c nodes().
+    const scope_type& scope(std::size_t i) const
+    {
+      return m_scopes[i];
+    }
+
+    /// \brief Returns the scope of node \c u.
+    const scope_type& scope(const pc_node_ptr& u) const
+    {
+      return m_scopes[index(u)];
+    }
+};
+
+} // namespace aitools
+
+#endif // AITOOLS_PROBABILISTIC_CIRCUITS_SCOPE_ANALYSIS_H
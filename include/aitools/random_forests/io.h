@@ -10,8 +10,15 @@
 #ifndef AITOOLS_RANDOM_FORESTS_IO_H
 #define AITOOLS_RANDOM_FORESTS_IO_H
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
 #include "aitools/decision_trees/io.h"
 #include "aitools/random_forests/random_forest.h"
+#include "aitools/utilities/parallel.h"
 #include "aitools/utilities/string_utility.h"
 #include "aitools/utilities/text_utility.h"
 
@@ -66,20 +73,62 @@ class random_forest_parser
 
       void parse(std::istream& from)
       {
-        for (std::string line; std::getline(from, line); )
+        parse_text(std::string(std::istreambuf_iterator<char>(from), std::istreambuf_iterator<char>()));
+      }
+
+      /// \brief Parses the contents of a random forest file. The trees are delimited by \c binary_decision_tree:
+      /// lines, and they are parsed in parallel. The lines before the first tree are parsed sequentially.
+      void parse_text(const std::string& text)
+      {
+        const char* first = text.data();
+        const char* last = text.data() + text.size();
+
+        // find the start positions of the trees
+        const std::string tree_header = "binary_decision_tree:";
+        std::vector<const char*> boundaries;
+        for (std::size_t pos = 0; (pos = text.find(tree_header, pos)) != std::string::npos; pos += tree_header.size())
         {
+          if (pos == 0 || text[pos - 1] == '\n')
+          {
+            boundaries.push_back(first + pos);
+          }
+        }
+        boundaries.push_back(last);
+
+        // the lines before the first tree
+        std::string line;
+        for (const char* i = first; i != boundaries.front(); )
+        {
+          const char* eol = std::find(i, boundaries.front(), '\n');
+          line.assign(i, eol);
           AITOOLS_LOG(log::debug) << "LINE: " << line << std::endl;
           parse_line(line);
+          i = eol == boundaries.front() ? eol : eol + 1;
         }
+        if (dt_parser.has_tree())
+        {
+          forest.trees().push_back(dt_parser.get_result());
+        }
+
+        // the trees are parsed in parallel
+        auto& trees = forest.trees();
+        std::size_t offset = trees.size();
+        std::size_t N = boundaries.size() - 1;
+        trees.resize(offset + N);
+        utilities::run_parallel(N, [&](std::size_t k)
+        {
+          decision_tree_parser parser;
+          parser.parse_text(boundaries[k], boundaries[k + 1]);
+          trees[offset + k] = parser.get_result();
+        });
+
+        // remove the trees without vertices, like the sequential parser does
+        trees.erase(std::remove_if(trees.begin() + offset, trees.end(), [](const binary_decision_tree& tree) { return tree.vertices().empty(); }), trees.end());
       }
 
       void parse(const std::string& filename)
       {
-        for (const std::string& line: utilities::split_lines(read_text_fast(filename)))
-        {
-          AITOOLS_LOG(log::debug) << "LINE: " << line << std::endl;
-          parse_line(line);
-        }
+        parse_text(read_text_fast(filename));
       }
 
       random_forest get_result()
@@ -105,8 +154,9 @@ random_forest parse_random_forest(std::istream& from)
 inline
 random_forest parse_random_forest(const std::string& text)
 {
-  std::istringstream stream(text);
-  return parse_random_forest(stream);
+  random_forest_parser parser;
+  parser.parse_text(text);
+  return parser.get_result();
 }
 
 inline
@@ -117,17 +167,162 @@ random_forest load_random_forest(const std::string& filename)
   return parser.get_result();
 }
 
+/// \param packed If true, the classes and indices of the trees are written in the compact encoding of
+/// \c format_decision_tree.
 inline
-void save_random_forest(const std::string& filename, const random_forest& forest)
+void save_random_forest(const std::string& filename, const random_forest& forest, bool packed = false)
 {
   std::ofstream to(filename);
   if (!to)
   {
     throw std::runtime_error("Could not open file '" + filename + "' for writing.");
   }
-  to << forest;
+  save_random_forest(to, forest, packed);
 }
 
+/// \brief Writes the trees of a random forest to a stream while they are being learned, in the same format as
+/// \c save_random_forest. The trees are formatted and written by a background thread in the order of their
+/// indices, and released after they have been written. Trees that arrive out of order are kept until the trees
+/// before them have been written. If \c max_pending trees are kept, \c add blocks until a tree has been written.
+/// The next tree in order is always accepted, so at most <tt>max_pending + 1</tt> trees are kept, and \c add cannot
+/// block forever as long as the next tree is added by a thread that is not blocked in \c add.
+class random_forest_writer
+{
+  private:
+    std::ostream& m_to;
+    std::size_t m_forest_size;
+    bool m_packed;
+    std::size_t m_max_pending;
+    std::size_t m_max_pending_size = 0; // the maximum size of m_pending so far
+    std::size_t m_next = 0; // the index of the next tree that is written
+    std::map<std::size_t, binary_decision_tree> m_pending;
+    bool m_closed = false;
+    std::exception_ptr m_error;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;     // notifies the background thread that a tree was added
+    std::condition_variable m_room_condition; // notifies add that a tree was removed from m_pending
+    std::thread m_thread;
+
+    void run()
+    {
+      utilities::text_buffer out;
+      std::unique_lock<std::mutex> lock(m_mutex);
+      for (;;)
+      {
+        m_condition.wait(lock, [this]() { return m_closed || m_pending.find(m_next) != m_pending.end(); });
+        auto i = m_pending.find(m_next);
+        if (i == m_pending.end())
+        {
+          return;
+        }
+        binary_decision_tree tree = std::move(i->second);
+        m_pending.erase(i);
+        m_next++;
+        lock.unlock();
+        m_room_condition.notify_all();
+
+        try
+        {
+          if (!m_error)
+          {
+            format_decision_tree(out, tree, m_packed);
+            utilities::write_buffer(m_to, out);
+            if (!m_to)
+            {
+              throw std::runtime_error("random_forest_writer: could not write to the output stream");
+            }
+          }
+        }
+        catch (...)
+        {
+          m_error = std::current_exception();
+        }
+        tree = binary_decision_tree();
+        lock.lock();
+      }
+    }
+
+  public:
+    /// \brief Writes the header of the forest, and starts the background thread.
+    /// \param packed If true, the classes and indices of the trees are written in the compact encoding of
+    /// \c format_decision_tree.
+    /// \param max_pending The maximum number of trees that are kept. If it is 0, twice the number of hardware
+    /// threads is used.
+    random_forest_writer(std::ostream& to, std::size_t forest_size, bool packed = false, std::size_t max_pending = 0)
+      : m_to(to),
+        m_forest_size(forest_size),
+        m_packed(packed),
+        m_max_pending(max_pending > 0 ? max_pending : 2 * std::max(1u, std::thread::hardware_concurrency()))
+    {
+      m_to << "random_forest: 1.0\n";
+      m_to << "forest_size: " << forest_size << '\n';
+      m_thread = std::thread([this]() { run(); });
+    }
+
+    random_forest_writer(const random_forest_writer&) = delete;
+    random_forest_writer& operator=(const random_forest_writer&) = delete;
+
+    ~random_forest_writer()
+    {
+      if (m_thread.joinable())
+      {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_closed = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+      }
+    }
+
+    /// \brief Adds the tree with index \c i. This function may be called concurrently. If \c max_pending trees
+    /// are kept and \c i is not the index of the next tree in order, it blocks until a tree has been written.
+    void add(std::size_t i, binary_decision_tree tree)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (i < m_next || i >= m_forest_size || m_pending.find(i) != m_pending.end())
+        {
+          throw std::runtime_error("random_forest_writer: invalid tree index " + std::to_string(i));
+        }
+        m_room_condition.wait(lock, [&]() { return m_pending.size() < m_max_pending || i == m_next; });
+        m_pending.emplace(i, std::move(tree));
+        m_max_pending_size = std::max(m_max_pending_size, m_pending.size());
+      }
+      m_condition.notify_one();
+    }
+
+    /// \brief Returns the maximum number of trees that were kept at the same time.
+    std::size_t max_pending_size()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_max_pending_size;
+    }
+
+    /// \brief Waits until all trees have been written, and stops the background thread. Rethrows an error that
+    /// occurred while writing.
+    void close()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+      }
+      m_condition.notify_one();
+      if (m_thread.joinable())
+      {
+        m_thread.join();
+      }
+      if (m_error)
+      {
+        std::rethrow_exception(m_error);
+      }
+      if (m_next != m_forest_size)
+      {
+        throw std::runtime_error("random_forest_writer: " + std::to_string(m_forest_size - m_next) + " trees were not written");
+      }
+    }
+};
+
 } // namespace aitools
 
 #endif // AITOOLS_RANDOM_FORESTS_IO_H
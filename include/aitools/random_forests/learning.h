@@ -10,12 +10,17 @@
 #ifndef AITOOLS_RANDOM_FORESTS_LEARNING_H
 #define AITOOLS_RANDOM_FORESTS_LEARNING_H
 
+#include <condition_variable>
 #include <execution>
 #include <iostream>
+#include <mutex>
+#include <numeric>
 #include <random>
+#include <thread>
 #include "aitools/datasets/sampling.h"
 #include "aitools/decision_trees/learning.h"
 #include "aitools/random_forests/random_forest.h"
+#include "aitools/utilities/parallel.h"
 
 namespace aitools {
 
@@ -40,29 +45,157 @@ std::ostream& operator<<(std::ostream& out, const random_forest_options& options
   return out;
 }
 
-template<typename SplitFamily, typename Gain, typename StopCriterion>
-random_forest learn_random_forest_sequential(const dataset& D,
-                                             const std::vector <std::uint32_t>& indices,
-                                             random_forest_options forest_options,
-                                             const decision_tree_options& tree_options,
-                                             SplitFamily split_family,
-                                             Gain gain,
-                                             StopCriterion node_finished,
-                                             std::size_t seed = std::random_device{}())
+/// \brief Learns the trees of a random forest one by one. Each tree is passed to <tt>report_tree(i, tree)</tt> as
+/// soon as it has been learned, with \c i the index of the tree in the forest.
+template<typename SplitFamily, typename Gain, typename StopCriterion, typename ReportTree>
+void learn_random_forest_trees_sequential(const dataset& D,
+                                          const std::vector <std::uint32_t>& indices,
+                                          random_forest_options forest_options,
+                                          const decision_tree_options& tree_options,
+                                          SplitFamily split_family,
+                                          Gain gain,
+                                          StopCriterion node_finished,
+                                          ReportTree report_tree,
+                                          std::size_t seed = std::random_device{}())
 {
   std::mt19937 rng{static_cast<unsigned int>(seed)};
   std::uniform_int_distribution <std::size_t> dist(std::numeric_limits<std::size_t>::min(),
                                                    std::numeric_limits<std::size_t>::max());
 
-  std::vector <binary_decision_tree> trees;
   dataset_sampler sampler(D, indices, forest_options.sample_criterion, dist(rng));
 
   for (std::size_t i = 0; i < forest_options.forest_size; i++)
   {
     std::vector <std::uint32_t> I = sampler.sample(forest_options.sample_fraction);
-    trees.push_back(learn_decision_tree(D, I, tree_options, split_family, gain, node_finished, dist(rng)));
+    report_tree(i, learn_decision_tree(D, I, tree_options, split_family, gain, node_finished, dist(rng)));
+  }
+}
+
+/// \brief Learns the trees of a random forest in parallel. Each tree is passed to <tt>report_tree(i, tree)</tt> as
+/// soon as it has been learned, with \c i the index of the tree in the forest. The trees are reported in arbitrary
+/// order, and \c report_tree may be called concurrently.
+/// \details The indices are handed out in increasing order, and a tree is only started if its index is less than
+/// the index of the first unreported tree plus twice the number of threads. So a \c report_tree that keeps the
+/// trees until the earlier ones have arrived needs to keep a bounded number of trees. The samples of the trees are
+/// drawn in the order of the indices, under the same lock. If learning a tree fails, no new trees are started, and
+/// the exception is rethrown.
+template<typename SplitFamily, typename Gain, typename StopCriterion, typename ReportTree>
+void learn_random_forest_trees_parallel(const dataset& D,
+                                        const std::vector <std::uint32_t>& indices,
+                                        random_forest_options forest_options,
+                                        const decision_tree_options& tree_options,
+                                        SplitFamily split_family,
+                                        Gain gain,
+                                        StopCriterion node_finished,
+                                        ReportTree report_tree)
+{
+  std::size_t N = forest_options.forest_size;
+  std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t window = 2 * thread_count;
+  dataset_sampler sampler(D, indices, forest_options.sample_criterion);
+
+  std::size_t next = 0;             // the index of the next tree that is started
+  std::size_t first_unreported = 0; // the index of the first tree that has not been reported
+  std::vector<bool> reported(N, false);
+  bool failed = false;
+  std::mutex mutex;
+  std::condition_variable condition;
+
+  utilities::run_parallel(thread_count, [&](std::size_t)
+  {
+    for (;;)
+    {
+      std::size_t i;
+      std::vector <std::uint32_t> I;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return failed || next == N || next < first_unreported + window; });
+        if (failed || next == N)
+        {
+          return;
+        }
+        i = next++;
+
+        // the sampler has a single random number generator, so the samples are drawn one at a time
+        try
+        {
+          I = sampler.sample(forest_options.sample_fraction);
+        }
+        catch (...)
+        {
+          failed = true;
+          lock.unlock();
+          condition.notify_all();
+          throw;
+        }
+      }
+
+      try
+      {
+        report_tree(i, learn_decision_tree(D, I, tree_options, split_family, gain, node_finished));
+      }
+      catch (...)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          failed = true;
+        }
+        condition.notify_all();
+        throw;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        reported[i] = true;
+        while (first_unreported < N && reported[first_unreported])
+        {
+          first_unreported++;
+        }
+      }
+      condition.notify_all();
+    }
+  });
+}
+
+template<typename SplitFamily, typename Gain, typename StopCriterion, typename ReportTree>
+void learn_random_forest_trees(const dataset& D,
+                               const std::vector <std::uint32_t>& indices,
+                               random_forest_options forest_options,
+                               const decision_tree_options& tree_options,
+                               SplitFamily split_family,
+                               Gain gain,
+                               StopCriterion node_finished,
+                               bool sequential,
+                               ReportTree report_tree,
+                               std::size_t seed = std::random_device{}())
+{
+  if (sequential)
+  {
+    learn_random_forest_trees_sequential(D, indices, forest_options, tree_options, split_family, gain, node_finished,
+                                         report_tree, seed);
+  }
+  else
+  {
+    learn_random_forest_trees_parallel(D, indices, forest_options, tree_options, split_family, gain, node_finished,
+                                       report_tree);
   }
-  return random_forest(trees);
+}
+
+template<typename SplitFamily, typename Gain, typename StopCriterion>
+random_forest learn_random_forest_sequential(const dataset& D,
+                                             const std::vector <std::uint32_t>& indices,
+                                             random_forest_options forest_options,
+                                             const decision_tree_options& tree_options,
+                                             SplitFamily split_family,
+                                             Gain gain,
+                                             StopCriterion node_finished,
+                                             std::size_t seed = std::random_device{}())
+{
+  std::vector <binary_decision_tree> trees(forest_options.forest_size);
+  learn_random_forest_trees_sequential(D, indices, forest_options, tree_options, split_family, gain, node_finished,
+                                       [&trees](std::size_t i, binary_decision_tree&& tree) { trees[i] = std::move(tree); },
+                                       seed);
+  return random_forest(std::move(trees));
 }
 
 template<typename SplitFamily, typename Gain, typename StopCriterion>
@@ -75,14 +208,9 @@ random_forest learn_random_forest_parallel(const dataset& D,
                                            StopCriterion node_finished)
 {
   std::vector <binary_decision_tree> trees(forest_options.forest_size);
-  dataset_sampler sampler(D, indices, forest_options.sample_criterion);
-
-  std::for_each(std::execution::par_unseq, trees.begin(), trees.end(), [&](binary_decision_tree& tree) {
-    std::vector <std::uint32_t> I = sampler.sample(forest_options.sample_fraction);
-    tree = learn_decision_tree(D, I, tree_options, split_family, gain, node_finished);
-  });
-
-  return random_forest(trees);
+  learn_random_forest_trees_parallel(D, indices, forest_options, tree_options, split_family, gain, node_finished,
+                                     [&trees](std::size_t i, binary_decision_tree&& tree) { trees[i] = std::move(tree); });
+  return random_forest(std::move(trees));
 }
 
 template<typename SplitFamily, typename Gain, typename StopCriterion>
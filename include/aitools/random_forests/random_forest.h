@@ -53,15 +53,26 @@ void swap(random_forest& forest1, random_forest& forest2)
 }
 
 /// \brief Saves a decision forest in a simple textual file format
+/// \param packed If true, the classes and indices of the trees are written in the compact encoding of
+/// \c format_decision_tree.
 inline
-std::ostream& operator<<(std::ostream& out, const random_forest& forest)
+void save_random_forest(std::ostream& out, const random_forest& forest, bool packed = false)
 {
   out << "random_forest: 1.0\n";
   out << "forest_size: " << forest.trees().size() << '\n';
-  for (const auto& tree: forest.trees())
+
+  // the trees are formatted in parallel
+  const auto& trees = forest.trees();
+  utilities::write_parallel(out, trees.size(), [&trees, packed](utilities::text_buffer& buffer, std::size_t i)
   {
-    out << tree;
-  }
+    format_decision_tree(buffer, trees[i], packed);
+  }, 1);
+}
+
+inline
+std::ostream& operator<<(std::ostream& out, const random_forest& forest)
+{
+  save_random_forest(out, forest);
   return out;
 }
 
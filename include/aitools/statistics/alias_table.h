@@ -0,0 +1,146 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/statistics/alias_table.h
+/// \brief Alias tables for drawing samples from a discrete distribution in constant time.
+
+#ifndef AITOOLS_STATISTICS_ALIAS_TABLE_H
+#define AITOOLS_STATISTICS_ALIAS_TABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace aitools {
+
+/// \brief An alias table for a discrete distribution with (not necessarily normalized) weights w[0], ..., w[K-1].
+/// A sample is drawn in constant time, using a single uniform random number. The table is constructed using Vose's
+/// algorithm in O(K) time.
+class alias_table
+{
+  private:
+    std::vector<double> m_probability; // the probability of keeping column i
+    std::vector<std::size_t> m_alias;  // the alternative for column i
+
+  public:
+    template <typename NumberSequence>
+    explicit alias_table(const NumberSequence& w)
+      : m_probability(w.size()), m_alias(w.size())
+    {
+      std::size_t K = w.size();
+      double total = std::accumulate(w.begin(), w.end(), 0.0);
+      std::vector<double> q(K);
+      std::vector<std::size_t> small;
+      std::vector<std::size_t> large;
+      for (std::size_t i = 0; i < K; i++)
+      {
+        q[i] = w[i] * K / total;
+        (q[i] < 1 ? small : large).push_back(i);
+      }
+
+      while (!small.empty() && !large.empty())
+      {
+        std::size_t s = small.back();
+        small.pop_back();
+        std::size_t l = large.back();
+        m_probability[s] = q[s];
+        m_alias[s] = l;
+        q[l] = (q[l] + q[s]) - 1;
+        if (q[l] < 1)
+        {
+          large.pop_back();
+          small.push_back(l);
+        }
+      }
+
+      // The remaining columns have q[i] = 1 up to rounding errors. Columns with weight 0 must never be selected.
+      std::size_t max_index = std::max_element(w.begin(), w.end()) - w.begin();
+      for (auto i: large)
+      {
+        m_probability[i] = 1;
+        m_alias[i] = i;
+      }
+      for (auto i: small)
+      {
+        m_probability[i] = w[i] > 0 ? 1 : 0;
+        m_alias[i] = w[i] > 0 ? i : max_index;
+      }
+    }
+
+    std::size_t size() const
+    {
+      return m_alias.size();
+    }
+
+    /// \brief Returns the index i of a random sample, with probability w[i] / (w[0] + ... + w[K-1]).
+    template <typename URBG>
+    std::size_t sample(URBG& rng) const
+    {
+      double x = std::uniform_real_distribution<double>(0, 1)(rng) * m_alias.size();
+      std::size_t i = std::min(static_cast<std::size_t>(x), m_alias.size() - 1);
+      return (x - i) < m_probability[i] ? i : m_alias[i];
+    }
+};
+
+/// \brief An alias table that is constructed on first use.
+/// \details The function get may be called concurrently by multiple threads; if several threads construct the table
+/// at the same time, only one of them is kept. The function reset must not be called concurrently with get.
+/// A copy does not share the table of the original, it is constructed again on first use.
+class lazy_alias_table
+{
+  private:
+    mutable std::atomic<alias_table*> m_table{nullptr};
+
+  public:
+    lazy_alias_table() = default;
+
+    lazy_alias_table(const lazy_alias_table&)
+    {}
+
+    lazy_alias_table& operator=(const lazy_alias_table&)
+    {
+      reset();
+      return *this;
+    }
+
+    ~lazy_alias_table()
+    {
+      reset();
+    }
+
+    /// \brief Returns the alias table of the weights w. The table is constructed if it does not exist yet.
+    template <typename NumberSequence>
+    const alias_table& get(const NumberSequence& w) const
+    {
+      alias_table* table = m_table.load(std::memory_order_acquire);
+      if (!table)
+      {
+        auto* new_table = new alias_table(w);
+        if (m_table.compare_exchange_strong(table, new_table, std::memory_order_acq_rel))
+        {
+          table = new_table;
+        }
+        else
+        {
+          delete new_table;
+        }
+      }
+      return *table;
+    }
+
+    /// \brief Discards the table. This must be called when the weights change.
+    void reset()
+    {
+      delete m_table.exchange(nullptr);
+    }
+};
+
+} // namespace aitools
+
+#endif // AITOOLS_STATISTICS_ALIAS_TABLE_H
@@ -10,14 +10,17 @@
 #ifndef AITOOLS_STATISTICS_DISTRIBUTIONS_H
 #define AITOOLS_STATISTICS_DISTRIBUTIONS_H
 
+#include <algorithm>
 #include <limits>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <variant>
 #include <boost/math/distributions/uniform.hpp>
 #include <boost/math/distributions/normal.hpp>
 #include <boost/math/special_functions/erf.hpp>
 #include "aitools/numerics/math_utility.h"
+#include "aitools/statistics/alias_table.h"
 #include "aitools/utilities/logger.h"
 #include "aitools/utilities/print.h"
 
@@ -27,10 +30,10 @@ namespace detail {
 
 /// \param x A value in the interval [0, 1]
 /// \return The smallest positive value i such that x <= p[0] + ... + p[i]
+/// \note This takes linear time. For repeated queries use find_cumulative_section or an alias table.
 template <typename NumberSequence>
 std::size_t find_categorical_section(const NumberSequence& p, double x)
 {
-  // TODO: implement a more efficient solution?
   double sum = 0;
   for (std::size_t i = 0; i < p.size(); i++)
   {
@@ -43,6 +46,16 @@ std::size_t find_categorical_section(const NumberSequence& p, double x)
   return p.size() - 1;
 }
 
+/// \param cumulative The prefix sums c[i] = p[0] + ... + p[i] of a sequence p
+/// \param x A value in the interval [0, 1]
+/// \return The smallest positive value i such that x <= c[i], computed using binary search
+inline
+std::size_t find_cumulative_section(const std::vector<double>& cumulative, double x)
+{
+  auto i = std::lower_bound(cumulative.begin(), cumulative.end(), x);
+  return i == cumulative.end() ? cumulative.size() - 1 : i - cumulative.begin();
+}
+
 } // namespace detail
 
 class uniform_distribution
@@ -110,10 +123,14 @@ class normal_distribution
 {
   private:
     boost::math::normal_distribution<double> m_dist;
+    double m_inverse_sigma;   // 1 / sigma
+    double m_log_normalizer;  // -log(sigma) - log(sqrt(2 pi))
 
   public:
     explicit normal_distribution(double mu = 0, double sigma = 1)
-    : m_dist(mu, sigma)
+    : m_dist(mu, sigma),
+      m_inverse_sigma(1.0 / sigma),
+      m_log_normalizer(-std::log(sigma) + std::log(boost::math::double_constants::one_div_root_two_pi))
     {
     }
 
@@ -132,6 +149,14 @@ class normal_distribution
       return boost::math::pdf(m_dist, x);
     }
 
+    /// \brief The logarithm of the probability density function. Contrary to <tt>std::log(pdf(x))</tt> this
+    /// does not underflow for values far away from the mean.
+    double log_pdf(double x) const
+    {
+      double z = (x - m_dist.mean()) * m_inverse_sigma;
+      return m_log_normalizer - 0.5 * z * z;
+    }
+
     double cdf(double x) const
     {
       return boost::math::cdf(m_dist, x);
@@ -176,16 +201,33 @@ struct truncated_normal_distribution
   public:
     static constexpr double min = std::numeric_limits<double>::lowest();
     static constexpr double max = std::numeric_limits<double>::max();
-    const double Phi_a;
-    const double Phi_b;
-    const double Phi_inv_a;
+    double Phi_a;
+    double Phi_b;
+    double Phi_inv_a;
+    double log_normalizer; // log(Phi_b - Phi_a)
+    double inverse_normalizer; // 1 / (Phi_b - Phi_a)
+
+  private:
+    // Computes Phi_b - Phi_a. If the interval [a, b] lies above the mean, the complements of the CDF are used
+    // to avoid cancellation in the upper tail.
+    static double normalizer(const normal_distribution& normal, double a, double b)
+    {
+      boost::math::normal_distribution<double> N(normal.mean(), normal.standard_deviation());
+      if (a > normal.mean())
+      {
+        return boost::math::cdf(boost::math::complement(N, a)) - boost::math::cdf(boost::math::complement(N, b));
+      }
+      return boost::math::cdf(N, b) - boost::math::cdf(N, a);
+    }
 
   public:
     explicit truncated_normal_distribution(double mu = 0, double sigma = 1, double a = min, double b = max)
       : m_normal(mu, sigma), m_a(a), m_b(b),
         Phi_a(m_normal.cdf(a)),
         Phi_b(m_normal.cdf(b)),
-        Phi_inv_a(m_normal.inverse_cdf(Phi_a))
+        Phi_inv_a(m_normal.inverse_cdf(Phi_a)),
+        log_normalizer(std::log(normalizer(m_normal, a, b))),
+        inverse_normalizer(1.0 / normalizer(m_normal, a, b))
     {}
 
     const normal_distribution& normal() const
@@ -205,15 +247,21 @@ struct truncated_normal_distribution
 
     double pdf(double x) const
     {
-      if (x < m_a)
+      if (x < m_a || x > m_b)
       {
         return 0;
       }
-      if (x > m_b)
+      return m_normal.pdf(x) * inverse_normalizer;
+    }
+
+    /// \brief The logarithm of the probability density function.
+    double log_pdf(double x) const
+    {
+      if (x < m_a || x > m_b)
       {
-        return 1;
+        return -std::numeric_limits<double>::infinity();
       }
-      return m_normal.pdf(x) / (Phi_b - Phi_a);
+      return m_normal.log_pdf(x) - log_normalizer;
     }
 
     double cdf(double x) const
@@ -255,6 +303,9 @@ class categorical_distribution
 {
   private:
     std::vector<double> p;
+    std::vector<double> log_p; // log_p[i] = log(p[i])
+    std::vector<double> cumulative_p; // cumulative_p[i] = p[0] + ... + p[i]
+    lazy_alias_table m_alias_table;
 
     std::size_t val(double x) const
     {
@@ -276,6 +327,13 @@ class categorical_distribution
     explicit categorical_distribution(std::vector<double> p_)
       : p(std::move(p_))
     {
+      log_p.reserve(p.size());
+      for (double p_i: p)
+      {
+        log_p.push_back(std::log(p_i));
+      }
+      cumulative_p.resize(p.size());
+      std::partial_sum(p.begin(), p.end(), cumulative_p.begin());
     }
 
     const std::vector<double>& probabilities() const
@@ -289,15 +347,27 @@ class categorical_distribution
       return p[i];
     }
 
+    double log_pdf(double x) const
+    {
+      std::size_t i = val(x);
+      return log_p[i];
+    }
+
     double cdf(double x) const
     {
       std::size_t i = val(x);
-      return std::accumulate(p.begin(), p.begin() + i + 1, 0.0);
+      return cumulative_p[i];
     }
 
     std::size_t inverse_cdf(double x) const
     {
-      return detail::find_categorical_section(p, x);
+      return detail::find_cumulative_section(cumulative_p, x);
+    }
+
+    /// \brief Returns an alias table for drawing samples. It is constructed on first use.
+    const alias_table& sampling_table() const
+    {
+      return m_alias_table.get(p);
     }
 
     unsigned int category_count() const
@@ -85,8 +85,7 @@ double sample(const truncated_normal_distribution& d, std::mt19937& rng)
 inline
 std::size_t sample(const categorical_distribution& d, std::mt19937& rng)
 {
-  double p = std::uniform_real_distribution<double>(0, 1)(rng);
-  return d.inverse_cdf(p);
+  return d.sampling_table().sample(rng);
 }
 
 } // namespace aitools
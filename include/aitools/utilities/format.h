@@ -0,0 +1,97 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/utilities/format.h
+/// \brief Buffered formatting of the textual file formats with {fmt}.
+
+#ifndef AITOOLS_UTILITIES_FORMAT_H
+#define AITOOLS_UTILITIES_FORMAT_H
+
+#include <algorithm>
+#include <execution>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <string_view>
+#include <vector>
+#include <fmt/format.h>
+
+namespace aitools::utilities {
+
+/// \brief A buffer in which text is formatted before it is written to a stream.
+using text_buffer = fmt::memory_buffer;
+
+/// \brief Appends a number to a buffer. Floating point numbers are written in the shortest representation that
+/// parses back to the same value.
+template <typename Number>
+void format_number(text_buffer& out, Number x)
+{
+  fmt::format_to(std::back_inserter(out), "{}", x);
+}
+
+inline
+void format_text(text_buffer& out, std::string_view text)
+{
+  out.append(text.data(), text.data() + text.size());
+}
+
+/// \brief Appends the elements of a container to a buffer, in the same layout as \c print_container.
+template <typename Container>
+void format_container(text_buffer& out, const Container& v, std::string_view begin_marker = "", std::string_view end_marker = "", std::string_view separator = " ")
+{
+  format_text(out, begin_marker);
+  for (auto i = v.begin(); i != v.end(); ++i)
+  {
+    if (i != v.begin())
+    {
+      format_text(out, separator);
+    }
+    format_number(out, *i);
+  }
+  format_text(out, end_marker);
+}
+
+/// \brief Writes the contents of a buffer to a stream, and clears the buffer.
+inline
+void write_buffer(std::ostream& to, text_buffer& buffer)
+{
+  to.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  buffer.clear();
+}
+
+/// \brief Writes the items <tt>0, ..., n - 1</tt> to a stream. The items are formatted in parallel in chunks of
+/// \c chunk_size items, and the chunks are written in order. To bound the memory usage, at most \c max_chunks chunks
+/// are kept in memory. The function <tt>format_item(text_buffer& out, std::size_t i)</tt> appends item \c i to a
+/// buffer.
+template <typename FormatItem>
+void write_parallel(std::ostream& to, std::size_t n, FormatItem format_item, std::size_t chunk_size = 4096, std::size_t max_chunks = 64)
+{
+  chunk_size = std::max<std::size_t>(chunk_size, 1);
+  std::vector<text_buffer> buffers(std::min(max_chunks, (n + chunk_size - 1) / chunk_size));
+  std::vector<std::size_t> chunks(buffers.size());
+  for (std::size_t first = 0; first < n; first += chunk_size * buffers.size())
+  {
+    std::size_t chunk_count = std::min(buffers.size(), (n - first + chunk_size - 1) / chunk_size);
+    std::iota(chunks.begin(), chunks.begin() + chunk_count, 0);
+    std::for_each(std::execution::par, chunks.begin(), chunks.begin() + chunk_count, [&](std::size_t c)
+    {
+      std::size_t chunk_first = first + c * chunk_size;
+      std::size_t chunk_last = std::min(n, chunk_first + chunk_size);
+      for (std::size_t i = chunk_first; i < chunk_last; i++)
+      {
+        format_item(buffers[c], i);
+      }
+    });
+    for (std::size_t c = 0; c < chunk_count; c++)
+    {
+      write_buffer(to, buffers[c]);
+    }
+  }
+}
+
+} // namespace aitools::utilities
+
+#endif // AITOOLS_UTILITIES_FORMAT_H
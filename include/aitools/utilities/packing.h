@@ -0,0 +1,234 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/utilities/packing.h
+/// \brief Compact encodings of sequences of natural numbers.
+
+#ifndef AITOOLS_UTILITIES_PACKING_H
+#define AITOOLS_UTILITIES_PACKING_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace aitools::utilities {
+
+/// \brief Returns the number of bits that is needed to store the elements of <tt>[first, last)</tt>, with a
+/// minimum of 1.
+inline
+unsigned int packed_bit_count(const std::uint32_t* first, const std::uint32_t* last)
+{
+  std::uint32_t max_value = 0;
+  for (const std::uint32_t* i = first; i != last; ++i)
+  {
+    max_value |= *i;
+  }
+  unsigned int bits = 1;
+  while (bits < 32 && (max_value >> bits) != 0)
+  {
+    bits++;
+  }
+  return bits;
+}
+
+/// \brief Appends the elements of <tt>[first, last)</tt> to \c out using \c bits bits per element. The bits are
+/// stored least significant first.
+/// \pre All elements fit in \c bits bits, and <tt>1 <= bits <= 32</tt>.
+inline
+void pack_bits(const std::uint32_t* first, const std::uint32_t* last, unsigned int bits, std::vector<std::uint8_t>& out)
+{
+  std::uint64_t buffer = 0;
+  unsigned int size = 0; // the number of bits in buffer
+  for (const std::uint32_t* i = first; i != last; ++i)
+  {
+    buffer |= static_cast<std::uint64_t>(*i) << size;
+    size += bits;
+    while (size >= 8)
+    {
+      out.push_back(static_cast<std::uint8_t>(buffer));
+      buffer >>= 8;
+      size -= 8;
+    }
+  }
+  if (size > 0)
+  {
+    out.push_back(static_cast<std::uint8_t>(buffer));
+  }
+}
+
+/// \brief Decodes \c n numbers that were encoded with \c pack_bits.
+inline
+void unpack_bits(const std::uint8_t* first, const std::uint8_t* last, std::size_t n, unsigned int bits, std::uint32_t* out)
+{
+  if (bits < 1 || bits > 32 || static_cast<std::size_t>(last - first) < (n * bits + 7) / 8)
+  {
+    throw std::runtime_error("unpack_bits: invalid bit sequence");
+  }
+  const std::uint64_t mask = (std::uint64_t(1) << bits) - 1;
+
+  // An element spans at most 5 bytes. On little endian machines, as long as 8 bytes are available they are read
+  // with a single unaligned load.
+  std::size_t i = 0;
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  std::size_t size = last - first;
+  for (; i < n && (i * bits) / 8 + 8 <= size; i++)
+  {
+    std::size_t position = i * bits;
+    std::uint64_t word;
+    std::memcpy(&word, first + position / 8, 8);
+    out[i] = static_cast<std::uint32_t>((word >> (position % 8)) & mask);
+  }
+#endif
+  for (; i < n; i++)
+  {
+    std::size_t position = i * bits;
+    const std::uint8_t* p = first + position / 8;
+    std::uint64_t word = 0;
+    std::size_t byte_count = std::min<std::size_t>(5, last - p);
+    for (std::size_t k = 0; k < byte_count; k++)
+    {
+      word |= static_cast<std::uint64_t>(p[k]) << (8 * k);
+    }
+    out[i] = static_cast<std::uint32_t>((word >> (position % 8)) & mask);
+  }
+}
+
+/// \brief The number of elements in a block of \c pack_deltas.
+constexpr std::size_t packed_delta_block_size = 128;
+
+/// \brief Appends the differences of consecutive elements of <tt>[first, last)</tt> to \c out, starting with the
+/// difference from 0. The differences are taken modulo 2^32 and zigzag encoded, such that small negative differences
+/// stay small. They are stored in blocks of \c packed_delta_block_size elements: a byte with the number of bits
+/// of the largest difference in the block, followed by the differences packed with \c pack_bits using that number
+/// of bits. Since all elements of a block have the same width, a block can be decoded without branches.
+inline
+void pack_deltas(const std::uint32_t* first, const std::uint32_t* last, std::vector<std::uint8_t>& out)
+{
+  std::uint32_t block[packed_delta_block_size];
+  std::uint32_t previous = 0;
+  while (first != last)
+  {
+    std::size_t n = std::min<std::size_t>(packed_delta_block_size, last - first);
+    for (std::size_t i = 0; i < n; i++)
+    {
+      auto delta = static_cast<std::int32_t>(first[i] - previous);
+      previous = first[i];
+      block[i] = (static_cast<std::uint32_t>(delta) << 1) ^ static_cast<std::uint32_t>(delta >> 31);
+    }
+    unsigned int bits = packed_bit_count(block, block + n);
+    out.push_back(static_cast<std::uint8_t>(bits));
+    pack_bits(block, block + n, bits, out);
+    first += n;
+  }
+}
+
+/// \brief Decodes \c n numbers that were encoded with \c pack_deltas.
+/// \return The position after the last block that was read.
+inline
+const std::uint8_t* unpack_deltas(const std::uint8_t* first, const std::uint8_t* last, std::size_t n, std::uint32_t* out)
+{
+  std::uint32_t previous = 0;
+  for (std::size_t i = 0; i < n; i += packed_delta_block_size)
+  {
+    std::size_t block_size = std::min(packed_delta_block_size, n - i);
+    if (first == last)
+    {
+      throw std::runtime_error("unpack_deltas: invalid block sequence");
+    }
+    unsigned int bits = *first++;
+    unpack_bits(first, last, block_size, bits, out + i);
+    first += (block_size * bits + 7) / 8;
+    for (std::size_t k = i; k < i + block_size; k++)
+    {
+      std::uint32_t z = out[k];
+      previous += (z >> 1) ^ (0 - (z & 1));
+      out[k] = previous;
+    }
+  }
+  return first;
+}
+
+/// \brief Appends the base64 encoding of the bytes <tt>[first, last)</tt> to \c out.
+inline
+void append_base64(std::string& out, const std::uint8_t* first, const std::uint8_t* last)
+{
+  static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  out.reserve(out.size() + 4 * ((last - first + 2) / 3));
+  for (; last - first >= 3; first += 3)
+  {
+    std::uint32_t x = (first[0] << 16) | (first[1] << 8) | first[2];
+    out.push_back(alphabet[(x >> 18) & 63]);
+    out.push_back(alphabet[(x >> 12) & 63]);
+    out.push_back(alphabet[(x >> 6) & 63]);
+    out.push_back(alphabet[x & 63]);
+  }
+  if (last - first == 1)
+  {
+    std::uint32_t x = first[0] << 16;
+    out.push_back(alphabet[(x >> 18) & 63]);
+    out.push_back(alphabet[(x >> 12) & 63]);
+    out.append("==");
+  }
+  else if (last - first == 2)
+  {
+    std::uint32_t x = (first[0] << 16) | (first[1] << 8);
+    out.push_back(alphabet[(x >> 18) & 63]);
+    out.push_back(alphabet[(x >> 12) & 63]);
+    out.push_back(alphabet[(x >> 6) & 63]);
+    out.push_back('=');
+  }
+}
+
+/// \brief Decodes the base64 text <tt>[first, last)</tt>, and appends the bytes to \c out.
+/// \return The position after the encoded text, i.e. the first character that is not part of the base64 alphabet.
+inline
+const char* parse_base64(const char* first, const char* last, std::vector<std::uint8_t>& out)
+{
+  static const std::array<std::int8_t, 256> value = []()
+  {
+    std::array<std::int8_t, 256> result;
+    result.fill(-1);
+    const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; i++)
+    {
+      result[static_cast<unsigned char>(alphabet[i])] = static_cast<std::int8_t>(i);
+    }
+    return result;
+  }();
+
+  std::uint32_t buffer = 0;
+  unsigned int size = 0; // the number of bits in buffer
+  for (; first != last; ++first)
+  {
+    std::int8_t x = value[static_cast<unsigned char>(*first)];
+    if (x < 0)
+    {
+      break;
+    }
+    buffer = (buffer << 6) | static_cast<std::uint32_t>(x);
+    size += 6;
+    if (size >= 8)
+    {
+      size -= 8;
+      out.push_back(static_cast<std::uint8_t>(buffer >> size));
+    }
+  }
+  while (first != last && *first == '=')
+  {
+    ++first;
+  }
+  return first;
+}
+
+} // namespace aitools::utilities
+
+#endif // AITOOLS_UTILITIES_PACKING_H
@@ -0,0 +1,52 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file aitools/utilities/parallel.h
+/// \brief Running tasks in parallel.
+
+#ifndef AITOOLS_UTILITIES_PARALLEL_H
+#define AITOOLS_UTILITIES_PARALLEL_H
+
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+namespace aitools::utilities {
+
+/// \brief Runs <tt>f(t)</tt> for <tt>t = 0, ..., task_count - 1</tt> in parallel with \c std::execution::par.
+/// Exceptions must not escape from a parallel algorithm, so an exception that is thrown by a task is stored, and
+/// after all tasks have finished the exception of the task with the lowest index is rethrown.
+template <typename Function>
+void run_parallel(std::size_t task_count, Function f)
+{
+  std::vector<std::size_t> tasks(task_count);
+  std::iota(tasks.begin(), tasks.end(), 0);
+  std::vector<std::exception_ptr> errors(task_count);
+  std::for_each(std::execution::par, tasks.begin(), tasks.end(), [&](std::size_t t)
+  {
+    try
+    {
+      f(t);
+    }
+    catch (...)
+    {
+      errors[t] = std::current_exception();
+    }
+  });
+  for (const auto& error: errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+} // namespace aitools::utilities
+
+#endif // AITOOLS_UTILITIES_PARALLEL_H
@@ -11,7 +11,9 @@
 #define AITOOLS_PARSE_NUMBERS_H
 
 #include <cctype>
+#include <charconv>
 #include <cstddef>
+#include <cstdlib>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -147,6 +149,24 @@ std::vector<double> parse_double_sequence(const std::string& text)
   return result;
 }
 
+/// \brief Reads a double from the range <tt>[first, last)</tt> using \c std::from_chars. If that fails, e.g. because
+/// of a leading '+' or a value that is out of range, \c std::strtold is used instead, so the accepted input is the
+/// same as for \c parse_double_sequence.
+/// \pre The range is followed by a character that cannot be part of a number, e.g. a space or a terminating zero.
+/// \return The position after the number, or \c first if no number could be read.
+inline
+const char* parse_next_double(const char* first, const char* last, double& result)
+{
+  auto [p, ec] = std::from_chars(first, last, result);
+  if (ec == std::errc())
+  {
+    return p;
+  }
+  char* end;
+  result = std::strtold(first, &end);
+  return end;
+}
+
 inline
 uint32_t parse_binary_number(const std::string& text)
 {
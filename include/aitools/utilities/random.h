@@ -10,6 +10,7 @@
 #ifndef AITOOLS_RANDOM_H
 #define AITOOLS_RANDOM_H
 
+#include <cstdint>
 #include <random>
 
 namespace aitools {
@@ -61,6 +62,18 @@ bool random_bool()
   return random_bool(std::mt19937{std::random_device{}()});
 }
 
+/// \brief Returns a random number generator for the stream with index \c stream that is derived from \c seed.
+/// Different streams with the same seed are statistically independent, and the result does not depend on the
+/// order in which the streams are created. This makes it possible to divide random work over threads in a
+/// reproducible way.
+inline
+std::mt19937 make_random_stream(std::uint64_t seed, std::uint64_t stream)
+{
+  std::seed_seq seq{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                    static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)};
+  return std::mt19937{seq};
+}
+
 /// \brief Selects n elements from the sequence [first; last) (without replacement) such that each possible
 /// sample has equal probability of appearance, and writes those selected elements into the output iterator out.
 /// Random numbers are generated using the random number generator g.
@@ -24,9 +24,15 @@ ext_modules = [
         "aitools",
         [
             os.path.join(src_dir, "decision_trees.cpp"),
+            os.path.join(src_dir, "evaluation_plan.cpp"),
+            os.path.join(src_dir, "layered_circuit.cpp"),
             os.path.join(src_dir, "logger.cpp"),
+            os.path.join(src_dir, "parameter_learning.cpp"),
             os.path.join(src_dir, "probabilistic_circuits.cpp"),
             os.path.join(src_dir, "python-bindings.cpp"),
+            os.path.join(src_dir, "simd_functions.cpp"),
+            os.path.join(src_dir, "simd_functions_avx2.cpp"),
+            os.path.join(src_dir, "simd_functions_avx512.cpp"),
             os.path.join(src_dir, "utilities.cpp"),
         ],
         define_macros=define_macros,
@@ -17,6 +17,7 @@
 #include "aitools/utilities/container_utility.h"
 #include "aitools/utilities/iterator_range.h"
 #include "aitools/utilities/logger.h"
+#include "aitools/utilities/packing.h"
 #include "aitools/utilities/random.h"
 
 namespace aitools {
@@ -197,14 +198,61 @@ std::ostream& operator<<(std::ostream& out, const binary_decision_tree::vertex&
   return out << "left = " << print_index(u.left) << ", right = " << print_index(u.right) << ", I = " << u.I;
 }
 
-std::ostream& operator<<(std::ostream& to, const binary_decision_tree& tree)
+namespace detail {
+
+// Appends the packed_classes and packed_indices lines of a decision tree to a buffer. The indices of the leaves are
+// sorted first, which is allowed since the order of the indices within a leaf is irrelevant.
+inline
+void format_packed_indices(utilities::text_buffer& out, const binary_decision_tree& tree)
+{
+  const auto& classes = tree.classes();
+  std::vector<std::uint8_t> bytes;
+  unsigned int bits = utilities::packed_bit_count(classes.data(), classes.data() + classes.size());
+  utilities::pack_bits(classes.data(), classes.data() + classes.size(), bits, bytes);
+  std::string text;
+  utilities::append_base64(text, bytes.data(), bytes.data() + bytes.size());
+  fmt::format_to(std::back_inserter(out), "packed_classes: {} {} {}\n", classes.size(), bits, text);
+
+  std::vector<std::uint32_t> indices = tree.indices();
+  auto Ibegin = tree.root().I.begin();
+  for (const auto& u: tree.vertices())
+  {
+    if (u.is_leaf())
+    {
+      std::sort(indices.begin() + (u.I.begin() - Ibegin), indices.begin() + (u.I.end() - Ibegin));
+    }
+  }
+  bytes.clear();
+  utilities::pack_deltas(indices.data(), indices.data() + indices.size(), bytes);
+  text.clear();
+  utilities::append_base64(text, bytes.data(), bytes.data() + bytes.size());
+  fmt::format_to(std::back_inserter(out), "packed_indices: {} {}\n", indices.size(), text);
+}
+
+} // namespace detail
+
+void format_decision_tree(utilities::text_buffer& out, const binary_decision_tree& tree, bool packed)
 {
-  to << "binary_decision_tree: 1.0\n";
+  using utilities::format_container;
+  using utilities::format_text;
+
   std::size_t N = tree.vertices().size();
-  to << "tree_size: " << N << "\n";
-  to << "category_counts: " << print_container(tree.category_counts()) << "\n";
-  to << "classes: " << print_container(tree.classes()) << "\n";
-  to << "indices: " << print_container(tree.indices()) << "\n";
+  fmt::format_to(std::back_inserter(out), "binary_decision_tree: 1.0\ntree_size: {}\n", N);
+  format_text(out, "category_counts: ");
+  format_container(out, tree.category_counts());
+  format_text(out, "\n");
+  if (packed)
+  {
+    detail::format_packed_indices(out, tree);
+  }
+  else
+  {
+    format_text(out, "classes: ");
+    format_container(out, tree.classes());
+    format_text(out, "\nindices: ");
+    format_container(out, tree.indices());
+    format_text(out, "\n");
+  }
   auto Ibegin = tree.root().I.begin();
   for (std::size_t i = 0; i < N; i++)
   {
@@ -213,13 +261,22 @@ std::ostream& operator<<(std::ostream& to, const binary_decision_tree& tree)
     auto i1 = u.I.end() - Ibegin;
     if (u.is_leaf())
     {
-      to << "vertex: " << i << " [] " << u.split << ' ' << i0 << ' ' << i1 << "\n";
+      fmt::format_to(std::back_inserter(out), "vertex: {} [] ", i);
     }
     else
     {
-      to << "vertex: " << i << " [" << u.left << ' ' << u.right << "] " << u.split << ' ' << i0 << ' ' << i1 << "\n";
+      fmt::format_to(std::back_inserter(out), "vertex: {} [{} {}] ", i, u.left, u.right);
     }
+    format_split(out, u.split);
+    fmt::format_to(std::back_inserter(out), " {} {}\n", i0, i1);
   }
+}
+
+std::ostream& operator<<(std::ostream& to, const binary_decision_tree& tree)
+{
+  utilities::text_buffer out;
+  format_decision_tree(out, tree);
+  utilities::write_buffer(to, out);
   return to;
 }
 
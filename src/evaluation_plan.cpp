@@ -0,0 +1,1235 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file src/evaluation_plan.cpp
+/// \brief Batched forward and backward passes over a flattened probabilistic circuit.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "aitools/numerics/simd_functions.h"
+#include "aitools/probabilistic_circuits/algorithms.h"
+#include "aitools/probabilistic_circuits/evaluation_plan.h"
+#include "aitools/utilities/parallel.h"
+#include "aitools/utilities/random.h"
+
+namespace aitools {
+
+namespace {
+
+// Computes the log-values L_u of node i of the plan for the given rows. The log-values of a successor v are
+// returned by log_values(v). The buffers must have room for rows.size() values.
+template <typename LogValues>
+void forward_node(const evaluation_plan& plan,
+                  std::size_t i,
+                  const std::vector<const std::vector<double>*>& rows,
+                  LogValues log_values,
+                  double* L_u,
+                  double* max_value,
+                  double* term
+                 )
+{
+  using node_kind = evaluation_plan::node_kind;
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+
+  std::size_t R = rows.size();
+  std::size_t e_first = plan.first_edge(i);
+  std::size_t e_last = plan.last_edge(i);
+  switch (plan.kind(i))
+  {
+    case node_kind::terminal:
+    {
+      const pc_node& u = plan.node(i);
+      for (std::size_t r = 0; r < R; r++)
+      {
+        L_u[r] = u.log_evi(*rows[r]);
+      }
+      break;
+    }
+    case node_kind::product:
+    {
+      std::fill(L_u, L_u + R, 0.0);
+      for (std::size_t e = e_first; e < e_last; e++)
+      {
+        const double* L_v = log_values(plan.successor(e));
+        for (std::size_t r = 0; r < R; r++)
+        {
+          L_u[r] += L_v[r];
+        }
+      }
+      break;
+    }
+    case node_kind::sum:
+    {
+      // log-sum-exp per row: first compute the maximum, then sum the shifted exponentials
+      std::fill(max_value, max_value + R, -infinity);
+      for (std::size_t e = e_first; e < e_last; e++)
+      {
+        double w = plan.log_weight(e);
+        const double* L_v = log_values(plan.successor(e));
+        for (std::size_t r = 0; r < R; r++)
+        {
+          max_value[r] = std::max(max_value[r], w + L_v[r]);
+        }
+      }
+      for (std::size_t r = 0; r < R; r++)
+      {
+        if (std::isinf(max_value[r]))
+        {
+          max_value[r] = 0;
+        }
+      }
+      std::fill(L_u, L_u + R, 0.0);
+      for (std::size_t e = e_first; e < e_last; e++)
+      {
+        double w = plan.log_weight(e);
+        const double* L_v = log_values(plan.successor(e));
+        for (std::size_t r = 0; r < R; r++)
+        {
+          term[r] = w + L_v[r] - max_value[r];
+        }
+        simd::exp(term, term + R, term);
+        for (std::size_t r = 0; r < R; r++)
+        {
+          L_u[r] += term[r];
+        }
+      }
+      simd::log(L_u, L_u + R, L_u);
+      for (std::size_t r = 0; r < R; r++)
+      {
+        L_u[r] += max_value[r];
+      }
+      break;
+    }
+    case node_kind::sum_split:
+    {
+      const splitting_criterion& split = plan.splitter(i);
+      for (std::size_t r = 0; r < R; r++)
+      {
+        std::size_t e = e_first + select(split, *rows[r]);
+        L_u[r] = plan.log_weight(e) + log_values(plan.successor(e))[r];
+      }
+      break;
+    }
+  }
+}
+
+// Returns log(exp(a) + exp(b))
+double log_add(double a, double b)
+{
+  if (a < b)
+  {
+    std::swap(a, b);
+  }
+  if (b == -std::numeric_limits<double>::infinity())
+  {
+    return a;
+  }
+  return a + std::log1p(std::exp(b - a));
+}
+
+// Computes the logarithms G[i * capacity + r] of the derivatives dp/dS_i of the likelihood of row r of the last
+// forward pass with respect to the value of node i. Unlike the flows, they do not depend on S_i itself, and they are
+// also defined if S_i = 0 or p = 0: the derivative with respect to a successor v of a product node is the product of
+// the values of the other successors, which is computed without dividing by S_v.
+void log_derivatives(const evaluation_plan& plan, const forward_backward_pass& pass, std::size_t capacity, std::vector<double>& G)
+{
+  using node_kind = evaluation_plan::node_kind;
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+
+  std::size_t R = pass.row_count();
+  G.assign(plan.size() * capacity, -infinity);
+  std::fill_n(G.data() + plan.root() * capacity, R, 0.0);
+
+  for (std::size_t i = plan.size(); i-- > 0; )
+  {
+    const double* G_u = G.data() + i * capacity;
+    std::size_t e_first = plan.first_edge(i);
+    std::size_t e_last = plan.last_edge(i);
+    switch (plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        break;
+      }
+      case node_kind::product:
+      {
+        for (std::size_t r = 0; r < R; r++)
+        {
+          if (G_u[r] == -infinity)
+          {
+            continue;
+          }
+          // the sum of the finite log-values of the successors, and the number of successors with value 0
+          double finite_sum = 0;
+          std::size_t zero_count = 0;
+          for (std::size_t e = e_first; e < e_last; e++)
+          {
+            double L_v = pass.log_values(plan.successor(e))[r];
+            if (L_v == -infinity)
+            {
+              zero_count++;
+            }
+            else
+            {
+              finite_sum += L_v;
+            }
+          }
+          if (zero_count > 1)
+          {
+            continue;
+          }
+          for (std::size_t e = e_first; e < e_last; e++)
+          {
+            std::size_t v = plan.successor(e);
+            double L_v = pass.log_values(v)[r];
+            double others;
+            if (zero_count == 0)
+            {
+              others = finite_sum - L_v;
+            }
+            else
+            {
+              others = L_v == -infinity ? finite_sum : -infinity;
+            }
+            double& G_v = G[v * capacity + r];
+            G_v = log_add(G_v, G_u[r] + others);
+          }
+        }
+        break;
+      }
+      case node_kind::sum:
+      {
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = plan.log_weight(e);
+          double* G_v = G.data() + plan.successor(e) * capacity;
+          for (std::size_t r = 0; r < R; r++)
+          {
+            G_v[r] = log_add(G_v[r], G_u[r] + w);
+          }
+        }
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        const splitting_criterion& split = plan.splitter(i);
+        for (std::size_t r = 0; r < R; r++)
+        {
+          std::size_t e = e_first + select(split, pass.row(r));
+          double& G_v = G[plan.successor(e) * capacity + r];
+          G_v = log_add(G_v, G_u[r] + plan.log_weight(e));
+        }
+        break;
+      }
+    }
+  }
+}
+
+} // namespace
+
+evaluation_plan::evaluation_plan(const probabilistic_circuit& pc)
+  : m_nodes(topological_ordering(pc)), m_category_counts(pc.category_counts())
+{
+  std::size_t n = m_nodes.size();
+  std::unordered_map<const pc_node*, std::uint32_t> index;
+  index.reserve(n);
+  m_kinds.reserve(n);
+  m_offsets.reserve(n + 1);
+  m_splitters.resize(n, nullptr);
+  m_offsets.push_back(0);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    const pc_node& u = *m_nodes[i];
+    index[&u] = i;
+    const auto& successors = u.successors();
+    for (const auto& v: successors)
+    {
+      m_successors.push_back(index.at(v.get()));
+    }
+    m_offsets.push_back(m_successors.size());
+
+    if (auto u_ = dynamic_cast<const sum_split_node*>(&u); u_)
+    {
+      m_kinds.push_back(node_kind::sum_split);
+      m_splitters[i] = &u_->splitter();
+      m_log_weights.insert(m_log_weights.end(), u_->log_weights().begin(), u_->log_weights().end());
+    }
+    else if (auto u_ = dynamic_cast<const sum_node*>(&u); u_)
+    {
+      m_kinds.push_back(node_kind::sum);
+      m_log_weights.insert(m_log_weights.end(), u_->log_weights().begin(), u_->log_weights().end());
+    }
+    else if (dynamic_cast<const product_node*>(&u))
+    {
+      m_kinds.push_back(node_kind::product);
+      m_log_weights.insert(m_log_weights.end(), successors.size(), 0.0);
+    }
+    else if (u.is_leaf())
+    {
+      m_kinds.push_back(node_kind::terminal);
+    }
+    else
+    {
+      throw std::runtime_error("evaluation_plan: unsupported node type");
+    }
+  }
+}
+
+forward_backward_pass::forward_backward_pass(const evaluation_plan& plan, std::size_t capacity)
+  : m_plan(plan),
+    m_capacity(capacity),
+    m_log_values(plan.size() * capacity),
+    m_flows(plan.size() * capacity),
+    m_buffer1(capacity),
+    m_buffer2(capacity)
+{
+  m_rows.reserve(capacity);
+}
+
+void forward_backward_pass::forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last)
+{
+  if (last - first > m_capacity)
+  {
+    throw std::runtime_error("forward_backward_pass: the batch is larger than the capacity");
+  }
+  m_rows.clear();
+  for (std::size_t i = first; i < last; i++)
+  {
+    m_rows.push_back(&X[i]);
+  }
+  m_row_count = m_rows.size();
+
+  auto log_values = [this](std::size_t v) { return this->log_values(v); };
+  for (std::size_t i = 0; i < m_plan.size(); i++)
+  {
+    forward_node(m_plan, i, m_rows, log_values, m_log_values.data() + i * m_capacity, m_buffer1.data(), m_buffer2.data());
+  }
+}
+
+void forward_backward_pass::backward()
+{
+  using node_kind = evaluation_plan::node_kind;
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+
+  std::size_t R = m_row_count;
+  double* term = m_buffer2.data();
+
+  std::fill(m_flows.begin(), m_flows.end(), 0.0);
+  {
+    const double* L_root = log_values(m_plan.root());
+    double* F_root = m_flows.data() + m_plan.root() * m_capacity;
+    for (std::size_t r = 0; r < R; r++)
+    {
+      F_root[r] = L_root[r] > -infinity ? 1 : 0;
+    }
+  }
+
+  for (std::size_t i = m_plan.size(); i-- > 0; )
+  {
+    const double* F_u = flows(i);
+    const double* L_u = log_values(i);
+    std::size_t e_first = m_plan.first_edge(i);
+    std::size_t e_last = m_plan.last_edge(i);
+    switch (m_plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        break;
+      }
+      case node_kind::product:
+      {
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double* F_v = m_flows.data() + m_plan.successor(e) * m_capacity;
+          for (std::size_t r = 0; r < R; r++)
+          {
+            F_v[r] += F_u[r];
+          }
+        }
+        break;
+      }
+      case node_kind::sum:
+      {
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_plan.log_weight(e);
+          std::size_t v = m_plan.successor(e);
+          const double* L_v = log_values(v);
+          double* F_v = m_flows.data() + v * m_capacity;
+          for (std::size_t r = 0; r < R; r++)
+          {
+            term[r] = F_u[r] == 0 ? -infinity : w + L_v[r] - L_u[r];
+          }
+          simd::exp(term, term + R, term);
+          for (std::size_t r = 0; r < R; r++)
+          {
+            F_v[r] += F_u[r] * term[r];
+          }
+        }
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        const splitting_criterion& split = m_plan.splitter(i);
+        for (std::size_t r = 0; r < R; r++)
+        {
+          std::size_t e = e_first + select(split, *m_rows[r]);
+          m_flows[m_plan.successor(e) * m_capacity + r] += F_u[r];
+        }
+        break;
+      }
+    }
+  }
+}
+
+void forward_backward_pass::accumulate_edge_flows(std::vector<double>& result) const
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  std::size_t R = m_row_count;
+  for (std::size_t i = 0; i < m_plan.size(); i++)
+  {
+    const double* F_u = flows(i);
+    const double* L_u = log_values(i);
+    std::size_t e_first = m_plan.first_edge(i);
+    std::size_t e_last = m_plan.last_edge(i);
+    switch (m_plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        break;
+      }
+      case node_kind::product:
+      {
+        double total = 0;
+        for (std::size_t r = 0; r < R; r++)
+        {
+          total += F_u[r];
+        }
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          result[e] += total;
+        }
+        break;
+      }
+      case node_kind::sum:
+      {
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_plan.log_weight(e);
+          const double* L_v = log_values(m_plan.successor(e));
+          for (std::size_t r = 0; r < R; r++)
+          {
+            if (F_u[r] != 0)
+            {
+              result[e] += F_u[r] * std::exp(w + L_v[r] - L_u[r]);
+            }
+          }
+        }
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        const splitting_criterion& split = m_plan.splitter(i);
+        for (std::size_t r = 0; r < R; r++)
+        {
+          result[e_first + select(split, *m_rows[r])] += F_u[r];
+        }
+        break;
+      }
+    }
+  }
+}
+
+void forward_backward_pass::accumulate_weight_gradients(std::vector<double>& result) const
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  // d log p / d w_e = F_u * S_v / S_u
+  std::size_t R = m_row_count;
+  for (std::size_t i = 0; i < m_plan.size(); i++)
+  {
+    node_kind kind = m_plan.kind(i);
+    if (kind != node_kind::sum && kind != node_kind::sum_split)
+    {
+      continue;
+    }
+    const double* F_u = flows(i);
+    const double* L_u = log_values(i);
+    std::size_t e_first = m_plan.first_edge(i);
+    std::size_t e_last = m_plan.last_edge(i);
+    for (std::size_t r = 0; r < R; r++)
+    {
+      if (F_u[r] == 0)
+      {
+        continue;
+      }
+      if (kind == node_kind::sum)
+      {
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          result[e] += F_u[r] * std::exp(log_values(m_plan.successor(e))[r] - L_u[r]);
+        }
+      }
+      else
+      {
+        std::size_t e = e_first + select(m_plan.splitter(i), *m_rows[r]);
+        result[e] += F_u[r] * std::exp(-m_plan.log_weight(e));
+      }
+    }
+  }
+}
+
+max_product_pass::max_product_pass(const evaluation_plan& plan, std::size_t capacity)
+  : m_plan(plan),
+    m_capacity(capacity),
+    m_log_values(plan.size() * capacity),
+    m_modes(plan.size(), std::numeric_limits<double>::quiet_NaN()),
+    m_log_modes(plan.size(), 0.0),
+    m_variables(plan.size(), 0)
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  m_rows.reserve(capacity);
+  std::vector<double> x(plan.category_counts().size(), std::numeric_limits<double>::quiet_NaN());
+  for (std::size_t i = 0; i < plan.size(); i++)
+  {
+    if (plan.kind(i) == node_kind::terminal)
+    {
+      const auto& u = static_cast<const terminal_node&>(plan.node(i));
+      std::size_t j = u.scope();
+      m_variables[i] = j;
+      m_modes[i] = u.mode();
+      if (!is_missing(m_modes[i]))
+      {
+        x[j] = m_modes[i];
+        m_log_modes[i] = u.log_evi(x);
+        x[j] = std::numeric_limits<double>::quiet_NaN();
+      }
+    }
+    else if (plan.kind(i) == node_kind::sum_split)
+    {
+      m_variables[i] = split_variable(plan.splitter(i));
+    }
+  }
+}
+
+std::size_t max_product_pass::argmax(std::size_t i, std::size_t r) const
+{
+  std::size_t e_first = m_plan.first_edge(i);
+  std::size_t e_last = m_plan.last_edge(i);
+  std::size_t result = e_first;
+  double max_value = -std::numeric_limits<double>::infinity();
+  for (std::size_t e = e_first; e < e_last; e++)
+  {
+    double value = m_plan.log_weight(e) + log_values(m_plan.successor(e))[r];
+    if (value > max_value)
+    {
+      max_value = value;
+      result = e;
+    }
+  }
+  return m_plan.successor(result);
+}
+
+void max_product_pass::forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last)
+{
+  using node_kind = evaluation_plan::node_kind;
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+
+  if (last - first > m_capacity)
+  {
+    throw std::runtime_error("max_product_pass: the batch is larger than the capacity");
+  }
+  m_rows.clear();
+  for (std::size_t i = first; i < last; i++)
+  {
+    m_rows.push_back(&X[i]);
+  }
+  m_row_count = m_rows.size();
+
+  std::size_t R = m_row_count;
+  for (std::size_t i = 0; i < m_plan.size(); i++)
+  {
+    double* L_u = m_log_values.data() + i * m_capacity;
+    std::size_t e_first = m_plan.first_edge(i);
+    std::size_t e_last = m_plan.last_edge(i);
+    switch (m_plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        const pc_node& u = m_plan.node(i);
+        std::size_t j = m_variables[i];
+        bool has_mode = !is_missing(m_modes[i]);
+        for (std::size_t r = 0; r < R; r++)
+        {
+          const auto& x = *m_rows[r];
+          L_u[r] = has_mode && is_missing(x[j]) ? m_log_modes[i] : u.log_evi(x);
+        }
+        break;
+      }
+      case node_kind::product:
+      {
+        std::fill(L_u, L_u + R, 0.0);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          const double* L_v = log_values(m_plan.successor(e));
+          for (std::size_t r = 0; r < R; r++)
+          {
+            L_u[r] += L_v[r];
+          }
+        }
+        break;
+      }
+      case node_kind::sum:
+      {
+        std::fill(L_u, L_u + R, -infinity);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_plan.log_weight(e);
+          const double* L_v = log_values(m_plan.successor(e));
+          for (std::size_t r = 0; r < R; r++)
+          {
+            L_u[r] = std::max(L_u[r], w + L_v[r]);
+          }
+        }
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        const splitting_criterion& split = m_plan.splitter(i);
+        std::size_t j = m_variables[i];
+        for (std::size_t r = 0; r < R; r++)
+        {
+          const auto& x = *m_rows[r];
+          if (is_missing(x[j]))
+          {
+            L_u[r] = -infinity;
+            for (std::size_t e = e_first; e < e_last; e++)
+            {
+              L_u[r] = std::max(L_u[r], m_plan.log_weight(e) + log_values(m_plan.successor(e))[r]);
+            }
+          }
+          else
+          {
+            std::size_t e = e_first + select(split, x);
+            L_u[r] = m_plan.log_weight(e) + log_values(m_plan.successor(e))[r];
+          }
+        }
+        break;
+      }
+    }
+  }
+}
+
+void max_product_pass::complete(std::size_t r, std::vector<double>& x) const
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  const auto& row = *m_rows[r];
+  m_stack.clear();
+  m_stack.push_back(m_plan.root());
+  while (!m_stack.empty())
+  {
+    std::size_t i = m_stack.back();
+    m_stack.pop_back();
+    switch (m_plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        std::size_t j = m_variables[i];
+        if (is_missing(row[j]) && !is_missing(m_modes[i]))
+        {
+          x[j] = m_modes[i];
+        }
+        break;
+      }
+      case node_kind::product:
+      {
+        for (std::size_t e = m_plan.first_edge(i); e < m_plan.last_edge(i); e++)
+        {
+          m_stack.push_back(m_plan.successor(e));
+        }
+        break;
+      }
+      case node_kind::sum:
+      {
+        m_stack.push_back(argmax(i, r));
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        if (is_missing(row[m_variables[i]]))
+        {
+          m_stack.push_back(argmax(i, r));
+        }
+        else
+        {
+          m_stack.push_back(m_plan.successor(m_plan.first_edge(i) + select(m_plan.splitter(i), row)));
+        }
+        break;
+      }
+    }
+  }
+}
+
+class_posterior_pass::class_posterior_pass(const evaluation_plan& plan, std::size_t variable, std::size_t capacity)
+  : m_plan(plan),
+    m_variable(variable),
+    m_class_count(plan.category_counts().at(variable)),
+    m_capacity(capacity),
+    m_positions(plan.size(), undefined),
+    m_scalar_positions(plan.size(), undefined),
+    m_x(plan.category_counts().size(), std::numeric_limits<double>::quiet_NaN())
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  if (m_class_count == 0)
+  {
+    throw std::runtime_error("class_posterior_pass: variable " + std::to_string(variable) + " is not categorical");
+  }
+
+  std::size_t K = m_class_count;
+  for (std::size_t i = 0; i < plan.size(); i++)
+  {
+    bool depends = false;
+    switch (plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        depends = static_cast<const terminal_node&>(plan.node(i)).scope() == variable;
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        depends = split_variable(plan.splitter(i)) == variable;
+        break;
+      }
+      default: break;
+    }
+    for (std::size_t e = plan.first_edge(i); !depends && e < plan.last_edge(i); e++)
+    {
+      depends = m_positions[plan.successor(e)] != undefined;
+    }
+    if (depends)
+    {
+      m_positions[i] = m_nodes.size();
+      m_nodes.push_back(i);
+    }
+    else
+    {
+      m_scalar_positions[i] = m_scalar_nodes.size();
+      m_scalar_nodes.push_back(i);
+    }
+  }
+  if (m_positions[plan.root()] == undefined)
+  {
+    throw std::runtime_error("class_posterior_pass: the circuit does not depend on variable " + std::to_string(variable));
+  }
+
+  m_terminal_log_values.resize(m_nodes.size() * K);
+  for (std::size_t i: m_nodes)
+  {
+    if (plan.kind(i) == node_kind::terminal)
+    {
+      for (std::size_t k = 0; k < K; k++)
+      {
+        m_x[variable] = static_cast<double>(k);
+        m_terminal_log_values[m_positions[i] * K + k] = plan.node(i).log_evi(m_x);
+      }
+    }
+  }
+  m_log_values.resize(m_nodes.size() * capacity * K);
+  m_scalar_log_values.resize(m_scalar_nodes.size() * capacity);
+  m_rows.reserve(capacity);
+  m_buffer1.resize(capacity * K);
+  m_buffer2.resize(capacity * K);
+}
+
+void class_posterior_pass::forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last)
+{
+  using node_kind = evaluation_plan::node_kind;
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+
+  if (last - first > m_capacity)
+  {
+    throw std::runtime_error("class_posterior_pass: the batch is larger than the capacity");
+  }
+  m_rows.clear();
+  for (std::size_t i = first; i < last; i++)
+  {
+    m_rows.push_back(&X[i]);
+  }
+
+  std::size_t R = m_rows.size();
+  std::size_t K = m_class_count;
+  std::size_t RK = R * K;
+  double* max_value = m_buffer1.data();
+  double* term = m_buffer2.data();
+
+  // Returns the K log-values per row of a node that depends on the variable
+  auto vector_values = [&](std::size_t v) { return m_log_values.data() + m_positions[v] * m_capacity * K; };
+
+  // Returns the log-values of a node that does not depend on the variable
+  auto scalar_values = [&](std::size_t v) { return m_scalar_log_values.data() + m_scalar_positions[v] * m_capacity; };
+
+  // The nodes that do not depend on the variable are evaluated once per row
+  for (std::size_t i: m_scalar_nodes)
+  {
+    forward_node(m_plan, i, m_rows, scalar_values, m_scalar_log_values.data() + m_scalar_positions[i] * m_capacity, max_value, term);
+  }
+
+  for (std::size_t i: m_nodes)
+  {
+    double* L_u = vector_values(i);
+    std::size_t e_first = m_plan.first_edge(i);
+    std::size_t e_last = m_plan.last_edge(i);
+    switch (m_plan.kind(i))
+    {
+      case node_kind::terminal:
+      {
+        const double* values = m_terminal_log_values.data() + m_positions[i] * K;
+        for (std::size_t r = 0; r < R; r++)
+        {
+          std::copy(values, values + K, L_u + r * K);
+        }
+        break;
+      }
+      case node_kind::product:
+      {
+        std::fill(L_u, L_u + RK, 0.0);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          std::size_t v = m_plan.successor(e);
+          if (m_positions[v] != undefined)
+          {
+            const double* L_v = vector_values(v);
+            for (std::size_t rk = 0; rk < RK; rk++)
+            {
+              L_u[rk] += L_v[rk];
+            }
+          }
+          else
+          {
+            const double* L_v = scalar_values(v);
+            for (std::size_t r = 0; r < R; r++)
+            {
+              for (std::size_t k = 0; k < K; k++)
+              {
+                L_u[r * K + k] += L_v[r];
+              }
+            }
+          }
+        }
+        break;
+      }
+      case node_kind::sum:
+      {
+        // log-sum-exp per row and class: first compute the maximum, then sum the shifted exponentials
+        std::fill(max_value, max_value + RK, -infinity);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_plan.log_weight(e);
+          std::size_t v = m_plan.successor(e);
+          if (m_positions[v] != undefined)
+          {
+            const double* L_v = vector_values(v);
+            for (std::size_t rk = 0; rk < RK; rk++)
+            {
+              max_value[rk] = std::max(max_value[rk], w + L_v[rk]);
+            }
+          }
+          else
+          {
+            const double* L_v = scalar_values(v);
+            for (std::size_t r = 0; r < R; r++)
+            {
+              for (std::size_t k = 0; k < K; k++)
+              {
+                max_value[r * K + k] = std::max(max_value[r * K + k], w + L_v[r]);
+              }
+            }
+          }
+        }
+        for (std::size_t rk = 0; rk < RK; rk++)
+        {
+          if (std::isinf(max_value[rk]))
+          {
+            max_value[rk] = 0;
+          }
+        }
+        std::fill(L_u, L_u + RK, 0.0);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_plan.log_weight(e);
+          std::size_t v = m_plan.successor(e);
+          if (m_positions[v] != undefined)
+          {
+            const double* L_v = vector_values(v);
+            for (std::size_t rk = 0; rk < RK; rk++)
+            {
+              term[rk] = w + L_v[rk] - max_value[rk];
+            }
+          }
+          else
+          {
+            const double* L_v = scalar_values(v);
+            for (std::size_t r = 0; r < R; r++)
+            {
+              for (std::size_t k = 0; k < K; k++)
+              {
+                term[r * K + k] = w + L_v[r] - max_value[r * K + k];
+              }
+            }
+          }
+          simd::exp(term, term + RK, term);
+          for (std::size_t rk = 0; rk < RK; rk++)
+          {
+            L_u[rk] += term[rk];
+          }
+        }
+        simd::log(L_u, L_u + RK, L_u);
+        for (std::size_t rk = 0; rk < RK; rk++)
+        {
+          L_u[rk] += max_value[rk];
+        }
+        break;
+      }
+      case node_kind::sum_split:
+      {
+        const splitting_criterion& split = m_plan.splitter(i);
+        bool splits_on_variable = split_variable(split) == m_variable;
+        for (std::size_t r = 0; r < R; r++)
+        {
+          if (splits_on_variable)
+          {
+            m_x = *m_rows[r];
+          }
+          for (std::size_t k = 0; k < K; k++)
+          {
+            std::size_t e;
+            if (splits_on_variable)
+            {
+              m_x[m_variable] = static_cast<double>(k);
+              e = e_first + select(split, m_x);
+            }
+            else
+            {
+              e = e_first + select(split, *m_rows[r]);
+            }
+            std::size_t v = m_plan.successor(e);
+            double L_v = m_positions[v] != undefined ? vector_values(v)[r * K + k] : scalar_values(v)[r];
+            L_u[r * K + k] = m_plan.log_weight(e) + L_v;
+          }
+        }
+        break;
+      }
+    }
+  }
+}
+
+void class_posterior_pass::posterior(std::size_t r, double* result) const
+{
+  std::size_t K = m_class_count;
+  const double* L = log_values(r);
+  double max_value = *std::max_element(L, L + K);
+  if (std::isinf(max_value))
+  {
+    std::fill(result, result + K, 0.0);
+    return;
+  }
+  double total = 0;
+  for (std::size_t k = 0; k < K; k++)
+  {
+    result[k] = std::exp(L[k] - max_value);
+    total += result[k];
+  }
+  for (std::size_t k = 0; k < K; k++)
+  {
+    result[k] /= total;
+  }
+}
+
+std::vector<double> log_evi_batch(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size)
+{
+  evaluation_plan plan(pc);
+  forward_backward_pass pass(plan, batch_size);
+  const auto& X = D.X();
+  std::size_t n = X.row_count();
+  std::vector<double> result;
+  result.reserve(n);
+  for (std::size_t first = 0; first < n; first += batch_size)
+  {
+    std::size_t last = std::min(first + batch_size, n);
+    pass.forward(X, first, last);
+    const double* L_root = pass.log_values(plan.root());
+    result.insert(result.end(), L_root, L_root + pass.row_count());
+  }
+  return result;
+}
+
+std::vector<numerics::matrix<double>> conditional_marginals(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size)
+{
+  evaluation_plan plan(pc);
+  forward_backward_pass pass(plan, batch_size);
+  const auto& X = D.X();
+  const auto& category_counts = pc.category_counts();
+  std::size_t n = X.row_count();
+  std::size_t m = category_counts.size();
+
+  std::vector<numerics::matrix<double>> result(m);
+  for (std::size_t j = 0; j < m; j++)
+  {
+    if (category_counts[j] > 0)
+    {
+      result[j] = numerics::matrix<double>(n, category_counts[j]);
+    }
+  }
+
+  // the terminal nodes of categorical variables
+  std::vector<std::size_t> terminals;
+  for (std::size_t i = 0; i < plan.size(); i++)
+  {
+    if (auto u = dynamic_cast<const terminal_node*>(&plan.node(i)); u && category_counts[u->scope()] > 0)
+    {
+      terminals.push_back(i);
+    }
+  }
+
+  // Since p is multilinear in the values S_u of the terminal nodes of variable j, and dp/dS_u does not depend on
+  // these values, it holds that p(x_j = k, x_{-j}) = sum_u dp/dS_u * S_u(k). The derivatives of the terminal nodes
+  // of a variable are scaled by their maximum per row, which cancels out in the normalization.
+  std::vector<double> G;
+  std::vector<double> max_derivative(m * batch_size);
+  std::vector<std::vector<double>> rows(batch_size); // copies of the rows of the batch, used to substitute x_j = k
+  for (std::size_t first = 0; first < n; first += batch_size)
+  {
+    std::size_t last = std::min(first + batch_size, n);
+    pass.forward(X, first, last);
+    log_derivatives(plan, pass, batch_size, G);
+    std::size_t R = pass.row_count();
+    for (std::size_t r = 0; r < R; r++)
+    {
+      rows[r] = pass.row(r);
+    }
+    std::fill(max_derivative.begin(), max_derivative.end(), -std::numeric_limits<double>::infinity());
+    for (std::size_t i: terminals)
+    {
+      std::size_t j = static_cast<const terminal_node&>(plan.node(i)).scope();
+      const double* G_u = G.data() + i * batch_size;
+      for (std::size_t r = 0; r < R; r++)
+      {
+        max_derivative[j * batch_size + r] = std::max(max_derivative[j * batch_size + r], G_u[r]);
+      }
+    }
+    for (std::size_t i: terminals)
+    {
+      const auto& u = static_cast<const terminal_node&>(plan.node(i));
+      std::size_t j = u.scope();
+      std::size_t K = category_counts[j];
+      const double* G_u = G.data() + i * batch_size;
+      for (std::size_t r = 0; r < R; r++)
+      {
+        if (G_u[r] == -std::numeric_limits<double>::infinity())
+        {
+          continue;
+        }
+        double c = std::exp(G_u[r] - max_derivative[j * batch_size + r]);
+        auto& x = rows[r];
+        double x_j = x[j];
+        auto& P = result[j][first + r];
+        for (std::size_t k = 0; k < K; k++)
+        {
+          x[j] = static_cast<double>(k);
+          P[k] += c * u.evi(x);
+        }
+        x[j] = x_j;
+      }
+    }
+  }
+
+  for (std::size_t j = 0; j < m; j++)
+  {
+    if (category_counts[j] == 0)
+    {
+      continue;
+    }
+    for (std::size_t i = 0; i < n; i++)
+    {
+      auto& P = result[j][i];
+      double total = std::accumulate(P.begin(), P.end(), 0.0);
+      if (total > 0)
+      {
+        for (auto& p: P)
+        {
+          p /= total;
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+numerics::matrix<double> mpe_batch(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size)
+{
+  evaluation_plan plan(pc);
+  max_product_pass pass(plan, batch_size);
+  const auto& X = D.X();
+  std::size_t n = X.row_count();
+  numerics::matrix<double> result = X;
+  for (std::size_t first = 0; first < n; first += batch_size)
+  {
+    std::size_t last = std::min(first + batch_size, n);
+    pass.forward(X, first, last);
+    for (std::size_t r = 0; r < pass.row_count(); r++)
+    {
+      const auto& x = pass.row(r);
+      if (std::any_of(x.begin(), x.end(), [](double x_j) { return is_missing(x_j); }))
+      {
+        pass.complete(r, result[first + r]);
+      }
+    }
+  }
+  return result;
+}
+
+numerics::matrix<double> predict_proba(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size)
+{
+  evaluation_plan plan(pc);
+  class_posterior_pass pass(plan, plan.category_counts().size() - 1, batch_size);
+  const auto& X = D.X();
+  std::size_t n = X.row_count();
+  numerics::matrix<double> result(n, pass.class_count());
+  for (std::size_t first = 0; first < n; first += batch_size)
+  {
+    std::size_t last = std::min(first + batch_size, n);
+    pass.forward(X, first, last);
+    for (std::size_t r = 0; r < pass.row_count(); r++)
+    {
+      pass.posterior(r, result[first + r].data());
+    }
+  }
+  return result;
+}
+
+dataset sample_pc_conditional(const probabilistic_circuit& pc, const dataset& D, std::uint64_t seed, std::size_t thread_count, std::size_t block_size)
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  evaluation_plan plan(pc);
+  const auto& X = D.X();
+  std::size_t n = X.row_count();
+  numerics::matrix<double> result = X;
+  block_size = std::max<std::size_t>(block_size, 1);
+
+  // the terminal nodes that draw a value for their variable
+  std::vector<char> is_distribution(plan.size(), 0);
+  for (std::size_t i = 0; i < plan.size(); i++)
+  {
+    const pc_node& u = plan.node(i);
+    is_distribution[i] = dynamic_cast<const categorical_node*>(&u) || dynamic_cast<const normal_node*>(&u) || dynamic_cast<const truncated_normal_node*>(&u);
+  }
+
+  std::size_t block_count = (n + block_size - 1) / block_size;
+  if (thread_count == 0)
+  {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  thread_count = std::max<std::size_t>(1, std::min(thread_count, block_count));
+
+  // The tasks take the blocks from a shared counter, and write the samples directly into the rows of the result.
+  std::atomic<std::size_t> next_block{0};
+  utilities::run_parallel(thread_count, [&](std::size_t)
+  {
+    forward_backward_pass pass(plan, block_size);
+    std::vector<std::uint32_t> stack;
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (std::size_t b = next_block++; b < block_count; b = next_block++)
+    {
+      std::mt19937 rng = make_random_stream(seed, b);
+      std::size_t first = b * block_size;
+      std::size_t last = std::min(n, first + block_size);
+      pass.forward(X, first, last);
+      for (std::size_t r = 0; r < pass.row_count(); r++)
+      {
+        const auto& x = pass.row(r);
+        auto& y = result[first + r];
+        if (std::none_of(x.begin(), x.end(), [](double x_j) { return is_missing(x_j); }) || std::isinf(pass.log_likelihood(r)))
+        {
+          continue;
+        }
+        stack.clear();
+        stack.push_back(plan.root());
+        while (!stack.empty())
+        {
+          std::size_t i = stack.back();
+          stack.pop_back();
+          std::size_t e_first = plan.first_edge(i);
+          std::size_t e_last = plan.last_edge(i);
+          switch (plan.kind(i))
+          {
+            case node_kind::terminal:
+            {
+              const auto& u = static_cast<const terminal_node&>(plan.node(i));
+              if (is_distribution[i] && is_missing(x[u.scope()]))
+              {
+                u.sample(y, rng);
+              }
+              break;
+            }
+            case node_kind::product:
+            {
+              for (std::size_t e = e_first; e < e_last; e++)
+              {
+                stack.push_back(plan.successor(e));
+              }
+              break;
+            }
+            case node_kind::sum:
+            {
+              // select edge e with probability w_e * S_v / S_u
+              double L_u = pass.log_values(i)[r];
+              double p = uniform(rng);
+              std::size_t selected = e_last;
+              for (std::size_t e = e_first; e < e_last; e++)
+              {
+                double p_e = std::exp(plan.log_weight(e) + pass.log_values(plan.successor(e))[r] - L_u);
+                if (p_e > 0)
+                {
+                  selected = e;
+                  p -= p_e;
+                  if (p < 0)
+                  {
+                    break;
+                  }
+                }
+              }
+              stack.push_back(plan.successor(selected));
+              break;
+            }
+            case node_kind::sum_split:
+            {
+              stack.push_back(plan.successor(e_first + select(plan.splitter(i), x)));
+              break;
+            }
+          }
+        }
+      }
+    }
+  });
+
+  return {std::move(result), D.category_counts()};
+}
+
+} // namespace aitools
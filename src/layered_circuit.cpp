@@ -0,0 +1,320 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file src/layered_circuit.cpp
+/// \brief A representation of probabilistic circuits as a sequence of dense layers.
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <boost/math/constants/constants.hpp>
+#include "aitools/numerics/simd_functions.h"
+#include "aitools/probabilistic_circuits/algorithms.h"
+#include "aitools/probabilistic_circuits/layered_circuit.h"
+
+namespace aitools {
+
+layered_circuit::layered_circuit(const probabilistic_circuit& pc)
+  : m_category_counts(pc.category_counts())
+{
+  std::vector<pc_node_ptr> order = topological_ordering(pc);
+  std::size_t n = order.size();
+
+  // compute the depths and kinds of the nodes
+  std::unordered_map<const pc_node*, std::uint32_t> index;
+  index.reserve(n);
+  std::vector<std::uint32_t> depth(n, 0);
+  std::vector<layer_kind> kind(n);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    const pc_node& u = *order[i];
+    index[&u] = i;
+    for (const auto& v: u.successors())
+    {
+      depth[i] = std::max(depth[i], depth[index.at(v.get())] + 1);
+    }
+    if (dynamic_cast<const sum_split_node*>(&u))
+    {
+      throw std::runtime_error("layered_circuit: sum-split nodes are not supported, use expand_sum_split_nodes first");
+    }
+    else if (dynamic_cast<const sum_node*>(&u))
+    {
+      kind[i] = layer_kind::sum;
+    }
+    else if (dynamic_cast<const product_node*>(&u))
+    {
+      kind[i] = layer_kind::product;
+    }
+    else if (u.is_leaf())
+    {
+      kind[i] = layer_kind::input;
+    }
+    else
+    {
+      throw std::runtime_error("layered_circuit: unsupported node type");
+    }
+  }
+
+  // sort the nodes by depth and kind; the root is the only node with maximal depth
+  std::vector<std::uint32_t> permutation(n);
+  std::iota(permutation.begin(), permutation.end(), 0);
+  std::stable_sort(permutation.begin(), permutation.end(), [&](std::uint32_t i, std::uint32_t j)
+  {
+    return std::tie(depth[i], kind[i]) < std::tie(depth[j], kind[j]);
+  });
+  std::vector<std::uint32_t> position(n);
+  for (std::size_t p = 0; p < n; p++)
+  {
+    position[permutation[p]] = p;
+  }
+
+  m_nodes.reserve(n);
+  m_offsets.reserve(n + 1);
+  m_offsets.push_back(0);
+  for (std::size_t p = 0; p < n; p++)
+  {
+    std::uint32_t i = permutation[p];
+    const pc_node& u = *order[i];
+    m_nodes.push_back(order[i]);
+    if (m_layers.empty() || depth[permutation[m_layers.back().first]] != depth[i] || m_layers.back().kind != kind[i])
+    {
+      m_layers.push_back({kind[i], static_cast<std::uint32_t>(p), static_cast<std::uint32_t>(p)});
+    }
+    m_layers.back().last++;
+    for (const auto& v: u.successors())
+    {
+      m_inputs.push_back(position[index.at(v.get())]);
+    }
+    if (kind[i] == layer_kind::sum)
+    {
+      const auto& log_weights = static_cast<const sum_node&>(u).log_weights();
+      m_log_weights.insert(m_log_weights.end(), log_weights.begin(), log_weights.end());
+    }
+    else
+    {
+      m_log_weights.insert(m_log_weights.end(), u.successors().size(), 0.0);
+    }
+    m_offsets.push_back(m_inputs.size());
+  }
+}
+
+layered_evaluator::layered_evaluator(const layered_circuit& circuit, std::size_t capacity, std::size_t grain_size)
+  : m_circuit(circuit),
+    m_capacity(capacity),
+    m_log_values(circuit.size() * capacity),
+    m_columns(circuit.category_counts().size() * capacity),
+    m_grain_size(std::max<std::size_t>(grain_size, 1))
+{
+  std::size_t chunk_count = 1;
+  for (const auto& l: circuit.layers())
+  {
+    chunk_count = std::max(chunk_count, (l.width() + m_grain_size - 1) / m_grain_size);
+  }
+  m_buffers.resize(2 * chunk_count * capacity);
+  m_chunks.resize(chunk_count);
+  std::iota(m_chunks.begin(), m_chunks.end(), 0);
+}
+
+void layered_evaluator::evaluate_layer(const layered_circuit::layer& l, std::size_t first, std::size_t last, const numerics::matrix<double>& X, std::size_t row_offset, double* max_value, double* term)
+{
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+  static const double log_one_div_root_two_pi = std::log(boost::math::double_constants::one_div_root_two_pi);
+
+  std::size_t R = m_row_count;
+  for (std::size_t i = first; i < last; i++)
+  {
+    double* L_u = m_log_values.data() + i * m_capacity;
+    std::size_t e_first = m_circuit.first_input(i);
+    std::size_t e_last = m_circuit.last_input(i);
+    switch (l.kind)
+    {
+      case layered_circuit::layer_kind::input:
+      {
+        const pc_node& u = m_circuit.node(i);
+        if (auto u_ = dynamic_cast<const normal_node*>(&u); u_)
+        {
+          const double* x = m_columns.data() + u_->scope() * m_capacity;
+          double sigma = u_->standard_deviation();
+          simd::normal_log_pdf(x, x + R, L_u, u_->mean(), 1.0 / sigma, -std::log(sigma) + log_one_div_root_two_pi);
+          for (std::size_t r = 0; r < R; r++)
+          {
+            if (is_missing(x[r]))
+            {
+              L_u[r] = 0;
+            }
+          }
+        }
+        else if (auto u_ = dynamic_cast<const truncated_normal_node*>(&u); u_)
+        {
+          const double* x = m_columns.data() + u_->scope() * m_capacity;
+          const auto& dist = u_->distribution();
+          double sigma = dist.normal().standard_deviation();
+          double a = dist.a();
+          double b = dist.b();
+          simd::normal_log_pdf(x, x + R, L_u, dist.normal().mean(), 1.0 / sigma, -std::log(sigma) + log_one_div_root_two_pi - dist.log_normalizer);
+          for (std::size_t r = 0; r < R; r++)
+          {
+            if (is_missing(x[r]))
+            {
+              L_u[r] = 0;
+            }
+            else if (x[r] < a || x[r] > b)
+            {
+              L_u[r] = -infinity;
+            }
+          }
+        }
+        else
+        {
+          for (std::size_t r = 0; r < R; r++)
+          {
+            L_u[r] = u.log_evi(X[row_offset + r]);
+          }
+        }
+        break;
+      }
+      case layered_circuit::layer_kind::product:
+      {
+        std::fill(L_u, L_u + R, 0.0);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          const double* L_v = log_values(m_circuit.input(e));
+          for (std::size_t r = 0; r < R; r++)
+          {
+            L_u[r] += L_v[r];
+          }
+        }
+        break;
+      }
+      case layered_circuit::layer_kind::sum:
+      {
+        // log-sum-exp per row: first compute the maximum, then sum the shifted exponentials
+        std::fill(max_value, max_value + R, -infinity);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_circuit.log_weight(e);
+          const double* L_v = log_values(m_circuit.input(e));
+          for (std::size_t r = 0; r < R; r++)
+          {
+            max_value[r] = std::max(max_value[r], w + L_v[r]);
+          }
+        }
+        for (std::size_t r = 0; r < R; r++)
+        {
+          if (std::isinf(max_value[r]))
+          {
+            max_value[r] = 0;
+          }
+        }
+        std::fill(L_u, L_u + R, 0.0);
+        for (std::size_t e = e_first; e < e_last; e++)
+        {
+          double w = m_circuit.log_weight(e);
+          const double* L_v = log_values(m_circuit.input(e));
+          for (std::size_t r = 0; r < R; r++)
+          {
+            term[r] = w + L_v[r] - max_value[r];
+          }
+          simd::exp(term, term + R, term);
+          for (std::size_t r = 0; r < R; r++)
+          {
+            L_u[r] += term[r];
+          }
+        }
+        simd::log(L_u, L_u + R, L_u);
+        for (std::size_t r = 0; r < R; r++)
+        {
+          L_u[r] += max_value[r];
+        }
+        break;
+      }
+    }
+  }
+}
+
+void layered_evaluator::start_batch(const numerics::matrix<double>& X, std::size_t first, std::size_t last)
+{
+  if (last - first > m_capacity)
+  {
+    throw std::runtime_error("layered_evaluator: the batch is larger than the capacity");
+  }
+  m_row_count = last - first;
+
+  // transpose the batch, such that the leaves can be evaluated on contiguous columns
+  std::size_t m = m_circuit.category_counts().size();
+  for (std::size_t r = 0; r < m_row_count; r++)
+  {
+    const auto& x = X[first + r];
+    for (std::size_t j = 0; j < m; j++)
+    {
+      m_columns[j * m_capacity + r] = x[j];
+    }
+  }
+}
+
+void layered_evaluator::forward(const numerics::matrix<double>& X, std::size_t first, std::size_t last)
+{
+  start_batch(X, first, last);
+  for (const auto& l: m_circuit.layers())
+  {
+    evaluate_layer(l, l.first, l.last, X, first, m_buffers.data(), m_buffers.data() + m_capacity);
+  }
+}
+
+void layered_evaluator::forward_parallel(const numerics::matrix<double>& X, std::size_t first, std::size_t last)
+{
+  start_batch(X, first, last);
+  for (const auto& l: m_circuit.layers())
+  {
+    std::size_t chunk_count = (l.width() + m_grain_size - 1) / m_grain_size;
+    if (chunk_count <= 1)
+    {
+      evaluate_layer(l, l.first, l.last, X, first, m_buffers.data(), m_buffers.data() + m_capacity);
+      continue;
+    }
+
+    // The chunks write to disjoint ranges of m_log_values, and each chunk has its own scratch buffers
+    std::for_each(std::execution::par, m_chunks.begin(), m_chunks.begin() + chunk_count, [&](std::size_t c)
+    {
+      std::size_t chunk_first = l.first + c * m_grain_size;
+      std::size_t chunk_last = std::min<std::size_t>(l.last, chunk_first + m_grain_size);
+      double* buffer = m_buffers.data() + 2 * c * m_capacity;
+      evaluate_layer(l, chunk_first, chunk_last, X, first, buffer, buffer + m_capacity);
+    });
+  }
+}
+
+std::vector<double> log_evi_layered(const probabilistic_circuit& pc, const dataset& D, std::size_t batch_size, bool parallel)
+{
+  layered_circuit circuit(pc);
+  layered_evaluator evaluator(circuit, batch_size);
+  const auto& X = D.X();
+  std::size_t n = X.row_count();
+  std::vector<double> result;
+  result.reserve(n);
+  for (std::size_t first = 0; first < n; first += batch_size)
+  {
+    std::size_t last = std::min(first + batch_size, n);
+    if (parallel)
+    {
+      evaluator.forward_parallel(X, first, last);
+    }
+    else
+    {
+      evaluator.forward(X, first, last);
+    }
+    const double* L_root = evaluator.log_values(circuit.root());
+    result.insert(result.end(), L_root, L_root + evaluator.row_count());
+  }
+  return result;
+}
+
+} // namespace aitools
@@ -0,0 +1,251 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file src/parameter_learning.cpp
+/// \brief Learning the parameters of a probabilistic circuit with the EM algorithm.
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "aitools/probabilistic_circuits/evaluation_plan.h"
+#include "aitools/probabilistic_circuits/parameter_learning.h"
+#include "aitools/utilities/parallel.h"
+
+namespace aitools {
+
+namespace {
+
+// The expected counts that are collected by one thread
+struct expected_counts
+{
+  std::vector<double> edges;   // the flows through the edges
+  std::vector<double> leaves;  // the sufficient statistics of the leaves
+  double log_likelihood = 0;
+};
+
+enum class leaf_kind { none, categorical, normal, truncated_normal };
+
+// Describes where the statistics of a terminal node are stored. For categorical leaves the expected count of
+// category k is stored at position offset + k. For (truncated) normal leaves the sums of w, w * (x - shift) and
+// w * (x - shift)^2 are stored at positions offset, offset + 1 and offset + 2, where the shift is the current mean
+// of the leaf. This avoids cancellation in the variance computation.
+struct leaf_statistics
+{
+  std::size_t node;
+  leaf_kind kind;
+  std::size_t offset;
+  unsigned int variable;
+  double shift = 0;
+};
+
+std::vector<leaf_statistics> make_leaf_statistics(const evaluation_plan& plan, std::size_t& size)
+{
+  std::vector<leaf_statistics> result;
+  size = 0;
+  for (std::size_t i = 0; i < plan.size(); i++)
+  {
+    const pc_node& u = plan.node(i);
+    if (auto u_ = dynamic_cast<const categorical_node*>(&u); u_)
+    {
+      result.push_back({i, leaf_kind::categorical, size, u_->scope()});
+      size += u_->probabilities().size();
+    }
+    else if (auto u_ = dynamic_cast<const normal_node*>(&u); u_)
+    {
+      result.push_back({i, leaf_kind::normal, size, u_->scope(), u_->mean()});
+      size += 3;
+    }
+    else if (auto u_ = dynamic_cast<const truncated_normal_node*>(&u); u_)
+    {
+      result.push_back({i, leaf_kind::truncated_normal, size, u_->scope(), u_->mean()});
+      size += 3;
+    }
+  }
+  return result;
+}
+
+// Adds the vectors parts[1], parts[2], ... to parts[0]. The elements are divided into contiguous chunks that are
+// summed in parallel. Each element is summed in the order of the parts, so the result does not depend on timing.
+void parallel_sum(const std::vector<std::vector<double>*>& parts, std::size_t thread_count)
+{
+  std::vector<double>& result = *parts.front();
+  std::size_t n = result.size();
+  std::size_t chunk_size = (n + thread_count - 1) / thread_count;
+  utilities::run_parallel(thread_count, [&](std::size_t t)
+  {
+    std::size_t first = std::min(n, t * chunk_size);
+    std::size_t last = std::min(n, first + chunk_size);
+    for (std::size_t p = 1; p < parts.size(); p++)
+    {
+      const std::vector<double>& part = *parts[p];
+      for (std::size_t i = first; i < last; i++)
+      {
+        result[i] += part[i];
+      }
+    }
+  });
+}
+
+} // namespace
+
+std::vector<double> learn_parameters_em(probabilistic_circuit& pc, const dataset& D, const em_options& options)
+{
+  using node_kind = evaluation_plan::node_kind;
+
+  const auto& X = D.X();
+  std::size_t n = X.row_count();
+  std::size_t batch_size = std::max<std::size_t>(options.batch_size, 1);
+  std::size_t batch_count = (n + batch_size - 1) / batch_size;
+  std::size_t thread_count = options.thread_count;
+  if (thread_count == 0)
+  {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  thread_count = std::max<std::size_t>(1, std::min(thread_count, batch_count));
+  double alpha = options.weight_smoothing;
+
+  std::vector<double> result;
+  for (std::size_t iteration = 0; iteration < options.iterations; iteration++)
+  {
+    // The plan caches the log weights, so it is created again after each M-step
+    evaluation_plan plan(pc);
+    std::size_t leaf_statistics_size;
+    std::vector<leaf_statistics> leaves = make_leaf_statistics(plan, leaf_statistics_size);
+
+    // E-step: thread t processes the minibatches t, t + thread_count, t + 2 * thread_count, ...
+    std::vector<expected_counts> counts(thread_count);
+    utilities::run_parallel(thread_count, [&](std::size_t t)
+    {
+      expected_counts& c = counts[t];
+      c.edges.assign(plan.edge_count(), 0.0);
+      c.leaves.assign(leaf_statistics_size, 0.0);
+      forward_backward_pass pass(plan, batch_size);
+      for (std::size_t b = t; b < batch_count; b += thread_count)
+      {
+        std::size_t first = b * batch_size;
+        std::size_t last = std::min(n, first + batch_size);
+        pass.forward(X, first, last);
+        pass.backward();
+        pass.accumulate_edge_flows(c.edges);
+        for (std::size_t r = 0; r < pass.row_count(); r++)
+        {
+          c.log_likelihood += pass.log_likelihood(r);
+        }
+        for (const leaf_statistics& leaf: leaves)
+        {
+          const double* F = pass.flows(leaf.node);
+          double* s = c.leaves.data() + leaf.offset;
+          for (std::size_t r = 0; r < pass.row_count(); r++)
+          {
+            double x = pass.row(r)[leaf.variable];
+            if (F[r] == 0 || is_missing(x))
+            {
+              continue;
+            }
+            if (leaf.kind == leaf_kind::categorical)
+            {
+              s[static_cast<std::size_t>(x)] += F[r];
+            }
+            else
+            {
+              double d = x - leaf.shift;
+              s[0] += F[r];
+              s[1] += F[r] * d;
+              s[2] += F[r] * d * d;
+            }
+          }
+        }
+      }
+    });
+
+    // Merge the expected counts of the threads
+    std::vector<std::vector<double>*> edge_parts;
+    std::vector<std::vector<double>*> leaf_parts;
+    double log_likelihood = 0;
+    for (auto& c: counts)
+    {
+      edge_parts.push_back(&c.edges);
+      leaf_parts.push_back(&c.leaves);
+      log_likelihood += c.log_likelihood;
+    }
+    parallel_sum(edge_parts, thread_count);
+    parallel_sum(leaf_parts, thread_count);
+    const std::vector<double>& edge_counts = counts.front().edges;
+    const std::vector<double>& leaf_counts = counts.front().leaves;
+    result.push_back(log_likelihood / n);
+
+    // M-step
+    for (std::size_t i = 0; i < plan.size(); i++)
+    {
+      node_kind kind = plan.kind(i);
+      if (kind != node_kind::sum && kind != node_kind::sum_split)
+      {
+        continue;
+      }
+      std::size_t e_first = plan.first_edge(i);
+      std::size_t e_last = plan.last_edge(i);
+      std::vector<double> weights(edge_counts.begin() + e_first, edge_counts.begin() + e_last);
+      double total = 0;
+      for (double& w: weights)
+      {
+        w += alpha;
+        total += w;
+      }
+      if (total > 0)
+      {
+        for (double& w: weights)
+        {
+          w /= total;
+        }
+        static_cast<sum_node&>(*plan.node_ptr(i)).set_weights(std::move(weights));
+      }
+    }
+
+    for (const leaf_statistics& leaf: leaves)
+    {
+      pc_node& u = *plan.node_ptr(leaf.node);
+      const double* s = leaf_counts.data() + leaf.offset;
+      if (leaf.kind == leaf_kind::categorical)
+      {
+        auto& u_ = static_cast<categorical_node&>(u);
+        std::size_t K = u_.probabilities().size();
+        std::vector<double> probabilities(s, s + K);
+        double total = 0;
+        for (double& p: probabilities)
+        {
+          p += alpha;
+          total += p;
+        }
+        if (total > 0)
+        {
+          for (double& p: probabilities)
+          {
+            p /= total;
+          }
+          u_.set_probabilities(std::move(probabilities));
+        }
+      }
+      else if (s[0] > 0)
+      {
+        double d = s[1] / s[0];
+        double mean = leaf.shift + d;
+        double variance = std::max(0.0, s[2] / s[0] - d * d);
+        double standard_deviation = std::max(std::sqrt(variance), options.min_standard_deviation);
+        if (leaf.kind == leaf_kind::normal)
+        {
+          static_cast<normal_node&>(u).set_parameters(mean, standard_deviation);
+        }
+        else
+        {
+          static_cast<truncated_normal_node&>(u).set_parameters(mean, standard_deviation);
+        }
+      }
+    }
+  }
+  return result;
+}
+
+} // namespace aitools
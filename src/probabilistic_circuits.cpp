@@ -7,35 +7,50 @@
 /// \file src/probabilistic_circuits.cpp
 /// \brief add your file description here.
 
+#include <algorithm>
+#include <atomic>
+#include <execution>
+#include <functional>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <thread>
+#include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
 #include "aitools/probabilistic_circuits/algorithms.h"
 #include "aitools/probabilistic_circuits/generative_forest.h"
+#include "aitools/probabilistic_circuits/incremental_evaluation.h"
 #include "aitools/utilities/container_utility.h"
+#include "aitools/utilities/interval.h"
 #include "aitools/utilities/iterator_range.h"
+#include "aitools/utilities/parallel.h"
+#include "aitools/utilities/random.h"
 
 namespace aitools {
 
 namespace detail {
 
-std::shared_ptr<pc_node> make_indicator_node(const splitting_criterion& split, std::size_t j)
+std::shared_ptr<pc_node> make_indicator_node(const splitting_criterion& split, std::size_t j, pc_node_factory& factory)
 {
   struct make_indicator_visitor
     {
     std::size_t j;
+    pc_node_factory& factory;
 
-    explicit make_indicator_visitor(std::size_t j_)
-    : j(j_)
+    make_indicator_visitor(std::size_t j_, pc_node_factory& factory_)
+    : j(j_), factory(factory_)
     {}
 
     std::shared_ptr<pc_node> operator()(const single_split& split) const
     {
       if (j == 0)
       {
-        return std::make_shared<equal_node>(split.variable, split.value);
+        return factory.make_equal(split.variable, split.value);
       }
       else
       {
-        return std::make_shared<not_equal_node>(split.variable, split.value);
+        return factory.make_not_equal(split.variable, split.value);
       }
     }
 
@@ -43,11 +58,11 @@ std::shared_ptr<pc_node> make_indicator_node(const splitting_criterion& split, s
     {
       if (j == 0)
       {
-        return std::make_shared<subset_node>(split.variable, split.mask);
+        return factory.make_subset(split.variable, split.mask);
       }
       else
       {
-        return std::make_shared<subset_node>(split.variable, ~split.mask);
+        return factory.make_subset(split.variable, ~split.mask);
       }
     }
 
@@ -55,11 +70,11 @@ std::shared_ptr<pc_node> make_indicator_node(const splitting_criterion& split, s
     {
       if (j == 0)
       {
-        return std::make_shared<less_node>(split.variable, split.value);
+        return factory.make_less(split.variable, split.value);
       }
       else
       {
-        return std::make_shared<greater_equal_node>(split.variable, split.value);
+        return factory.make_greater_equal(split.variable, split.value);
       }
     }
 
@@ -69,7 +84,7 @@ std::shared_ptr<pc_node> make_indicator_node(const splitting_criterion& split, s
     }
     };
 
-  return std::visit(make_indicator_visitor(j), split);
+  return std::visit(make_indicator_visitor(j, factory), split);
 }
 
 } // namespace detail
@@ -91,7 +106,6 @@ std::vector<pc_node_ptr> topological_ordering(const probabilistic_circuit& pc)
   using stack_element = std::pair<pc_node_ptr, vertex_range>;
   enum class colors { white, gray, black };
 
-  std::size_t n = probabilistic_circuit_size(pc);
   std::unordered_map<pc_node_ptr, colors> color_map;
 
   auto succ = [](const pc_node_ptr& u)
@@ -116,8 +130,6 @@ std::vector<pc_node_ptr> topological_ordering(const probabilistic_circuit& pc)
   };
 
   std::vector<pc_node_ptr> result;
-  result.reserve(n);
-
   std::stack<stack_element> dfs_stack;
 
   auto u0 = pc.root(); // the root of the PC
@@ -165,130 +177,368 @@ bool is_normalized(const probabilistic_circuit& pc, double tolerance)
   return result;
 }
 
-struct smoothness_checker
+scope_analysis::scope_analysis(const probabilistic_circuit& pc)
+  : m_nodes(topological_ordering(pc))
 {
-  bool result = true;
-
-  // Returns the scope of u; sets result to false if a sum node was found that is not smooth
-  std::set<unsigned int> scope(const pc_node_ptr& u)
+  std::size_t m = pc.feature_count();
+  std::size_t n = m_nodes.size();
+  m_index.reserve(n);
+  m_scopes.reserve(n);
+  for (std::size_t i = 0; i < n; i++)
   {
-    using utilities::set_union;
-
-    if (!result)
+    const pc_node_ptr& u = m_nodes[i];
+    m_index[u.get()] = i;
+    scope_type scope_u(m);
+    if (auto u_ = std::dynamic_pointer_cast<terminal_node>(u); u_)
     {
-      return {};
+      scope_u.set(u_->scope());
     }
-
-    if (auto u_ = std::dynamic_pointer_cast<terminal_node>(u); u_)
+    else
     {
-      return {u_->scope()};
+      for (const pc_node_ptr& v: u->successors())
+      {
+        scope_u |= m_scopes[index(v)];
+      }
     }
+    m_scopes.push_back(std::move(scope_u));
+  }
+}
 
+bool is_smooth(const scope_analysis& scopes)
+{
+  for (const pc_node_ptr& u: scopes.nodes())
+  {
     if (auto u_ = std::dynamic_pointer_cast<sum_node>(u); u_)
     {
-      std::set<unsigned int> scope_u;
+      const auto& scope_u = scopes.scope(u);
       for (const pc_node_ptr& v: u->successors())
       {
-        std::set<unsigned int> scope_v = scope(v);
-        if (scope_u.empty())
+        if (scopes.scope(v) != scope_u)
         {
-          std::swap(scope_u, scope_v);
-        }
-        else
-        {
-          if (scope_v != scope_u)
-          {
-            result = false;
-          }
+          return false;
         }
       }
-      return scope_u;
     }
+  }
+  return true;
+}
+
+bool is_smooth(const probabilistic_circuit& pc)
+{
+  return is_smooth(scope_analysis(pc));
+}
 
+bool is_decomposable(const scope_analysis& scopes)
+{
+  for (const pc_node_ptr& u: scopes.nodes())
+  {
     if (auto u_ = std::dynamic_pointer_cast<product_node>(u); u_)
     {
-      std::set<unsigned int> scope_u;
+      scope_analysis::scope_type scope_u(scopes.scope(u).size());
       for (const pc_node_ptr& v: u->successors())
       {
-        scope_u = set_union(scope_u, scope(v));
+        const auto& scope_v = scopes.scope(v);
+        if (scope_u.intersects(scope_v))
+        {
+          return false;
+        }
+        scope_u |= scope_v;
       }
-      return scope_u;
     }
-
-    throw std::runtime_error("smoothness_checker: unexpected node");
-  };
-
-  bool check(const probabilistic_circuit& pc)
-  {
-    scope(pc.root());
-    return result;
   }
-};
+  return true;
+}
 
-bool is_smooth(const probabilistic_circuit& pc)
+bool is_decomposable(const probabilistic_circuit& pc)
 {
-  return smoothness_checker().check(pc);
+  return is_decomposable(scope_analysis(pc));
 }
 
-struct decomposability_checker
+namespace detail {
+
+// An over-approximation of the values of a variable for which a node can be non-zero. For categorical variables
+// the set of categories is stored, for numerical variables an interval.
+struct variable_support
 {
-  bool result = true;
+  interval range;
+  boost::dynamic_bitset<> categories;
+
+  bool is_disjoint(const variable_support& other) const
+  {
+    if (!categories.empty())
+    {
+      return !categories.intersects(other.categories);
+    }
+    return range.b < other.range.a || other.range.b < range.a;
+  }
+
+  // Computes the union with other (over-approximated by the convex hull for intervals)
+  void join(const variable_support& other)
+  {
+    categories |= other.categories;
+    range.a = std::min(range.a, other.range.a);
+    range.b = std::max(range.b, other.range.b);
+  }
 
-  // Returns the scope of u; sets result to false if a product node was found that is not decomposable
-  std::set<unsigned int> scope(const pc_node_ptr& u)
+  void meet(const variable_support& other)
   {
-    using utilities::set_union;
+    categories &= other.categories;
+    range.a = std::max(range.a, other.range.a);
+    range.b = std::min(range.b, other.range.b);
+  }
+};
 
-    if (!result)
+// Maps variables to their support. Variables that are not in the map are unconstrained.
+using support_map = std::map<unsigned int, variable_support>;
+
+// Returns the support of a terminal node. For categorical variables each category is tested using evi.
+inline
+support_map terminal_support(const terminal_node& u, const std::vector<unsigned int>& category_counts)
+{
+  unsigned int j = u.scope();
+  std::size_t K = category_counts[j];
+  variable_support result;
+  if (K > 0)
+  {
+    std::vector<double> x(category_counts.size(), 0);
+    result.categories.resize(K);
+    for (std::size_t k = 0; k < K; k++)
+    {
+      x[j] = static_cast<double>(k);
+      result.categories[k] = u.evi(x) > 0;
+    }
+    if (result.categories.all())
     {
       return {};
     }
+    return {{j, result}};
+  }
+
+  constexpr double lowest = std::numeric_limits<double>::lowest();
+  if (auto u_ = dynamic_cast<const truncated_normal_node*>(&u); u_)
+  {
+    result.range = {u_->a(), u_->b()};
+  }
+  else if (auto u_ = dynamic_cast<const less_node*>(&u); u_)
+  {
+    result.range.b = std::nextafter(u_->value(), lowest);
+  }
+  else if (auto u_ = dynamic_cast<const greater_equal_node*>(&u); u_)
+  {
+    result.range.a = u_->value();
+  }
+  else if (auto u_ = dynamic_cast<const equal_node*>(&u); u_)
+  {
+    result.range = {u_->value(), u_->value()};
+  }
+  if (result.range.is_maximal())
+  {
+    return {};
+  }
+  return {{j, result}};
+}
+
+} // namespace detail
+
+bool is_deterministic(const probabilistic_circuit& pc, const scope_analysis& scopes)
+{
+  using detail::support_map;
 
+  const auto& nodes = scopes.nodes();
+  std::vector<support_map> supports;
+  supports.reserve(nodes.size());
+
+  for (const pc_node_ptr& u: nodes)
+  {
+    support_map support_u;
     if (auto u_ = std::dynamic_pointer_cast<terminal_node>(u); u_)
     {
-      return {u_->scope()};
+      support_u = detail::terminal_support(*u_, pc.category_counts());
     }
-
-    if (auto u_ = std::dynamic_pointer_cast<sum_node>(u); u_)
+    else if (auto u_ = std::dynamic_pointer_cast<product_node>(u); u_)
     {
-      std::set<unsigned int> scope_u;
       for (const pc_node_ptr& v: u->successors())
       {
-        scope_u = set_union(scope_u, scope(v));
+        for (const auto& [j, support_j]: supports[scopes.index(v)])
+        {
+          auto [iter, inserted] = support_u.insert({j, support_j});
+          if (!inserted)
+          {
+            iter->second.meet(support_j);
+          }
+        }
       }
-      return scope_u;
     }
-
-    if (auto u_ = std::dynamic_pointer_cast<product_node>(u); u_)
+    else if (auto u_ = std::dynamic_pointer_cast<sum_node>(u); u_)
     {
-      std::set<unsigned int> scope_u;
-      for (const pc_node_ptr& v: u->successors())
+      const auto& successors = u->successors();
+      support_u = supports[scopes.index(successors.front())];
+      for (auto i = successors.begin() + 1; i != successors.end(); ++i)
       {
-        for (auto x: scope(v))
+        const auto& support_v = supports[scopes.index(*i)];
+        for (auto k = support_u.begin(); k != support_u.end(); )
         {
-          auto [iter, inserted] = scope_u.insert(x);
-          if (!inserted)
+          auto l = support_v.find(k->first);
+          if (l == support_v.end())
           {
-            result = false;
+            k = support_u.erase(k);
+          }
+          else
+          {
+            k->second.join(l->second);
+            ++k;
           }
         }
       }
-      return scope_u;
+
+      // The successors of a sum-split node are selected by the split, so it is deterministic by construction.
+      // For other sum nodes, all pairs of successors must have disjoint supports for some variable.
+      if (!std::dynamic_pointer_cast<sum_split_node>(u))
+      {
+        for (std::size_t p = 0; p < successors.size(); p++)
+        {
+          const auto& support_p = supports[scopes.index(successors[p])];
+          for (std::size_t q = p + 1; q < successors.size(); q++)
+          {
+            const auto& support_q = supports[scopes.index(successors[q])];
+            bool disjoint = std::any_of(support_p.begin(), support_p.end(), [&](const auto& s)
+            {
+              auto l = support_q.find(s.first);
+              return l != support_q.end() && s.second.is_disjoint(l->second);
+            });
+            if (!disjoint)
+            {
+              return false;
+            }
+          }
+        }
+      }
+    }
+    else
+    {
+      throw std::runtime_error("is_deterministic: unexpected node");
     }
+    supports.push_back(std::move(support_u));
+  }
+  return true;
+}
 
-    throw std::runtime_error("decomposability_checker: unexpected node");
+bool is_deterministic(const probabilistic_circuit& pc)
+{
+  return is_deterministic(pc, scope_analysis(pc));
+}
+
+incremental_evaluator::incremental_evaluator(const probabilistic_circuit& pc)
+  : incremental_evaluator(pc, scope_analysis(pc))
+{}
+
+incremental_evaluator::incremental_evaluator(const probabilistic_circuit& pc, const scope_analysis& scopes)
+  : m_nodes(scopes.nodes()),
+    m_parents(m_nodes.size()),
+    m_readers(pc.feature_count()),
+    m_scheduled(m_nodes.size(), 0)
+{
+  for (std::size_t i = 0; i < m_nodes.size(); i++)
+  {
+    const pc_node_ptr& u = m_nodes[i];
+    for (const pc_node_ptr& v: u->successors())
+    {
+      m_parents[scopes.index(v)].push_back(i);
+    }
+    if (auto u_ = std::dynamic_pointer_cast<terminal_node>(u); u_)
+    {
+      m_readers[u_->scope()].push_back(i);
+    }
+    else if (auto u_ = std::dynamic_pointer_cast<sum_split_node>(u); u_)
+    {
+      m_readers[split_variable(u_->splitter())].push_back(i);
+    }
+  }
+}
+
+template <bool LogSpace>
+void incremental_evaluator::update(const std::vector<double>& x)
+{
+  auto compute = [&x](const pc_node& u)
+  {
+    if constexpr (LogSpace)
+    {
+      u.log_evi_iterative(x);
+    }
+    else
+    {
+      u.evi_iterative(x);
+    }
   };
 
-  bool check(const probabilistic_circuit& pc)
+  if (!m_valid || m_log_space != LogSpace || m_x.size() != x.size())
   {
-    scope(pc.root());
-    return result;
+    for (const auto& u: m_nodes)
+    {
+      compute(*u);
+    }
+    m_update_count = m_nodes.size();
+    m_x = x;
+    m_log_space = LogSpace;
+    m_valid = true;
+    return;
   }
-};
 
-bool is_decomposable(const probabilistic_circuit& pc)
+  auto schedule = [this](std::uint32_t i)
+  {
+    if (!m_scheduled[i])
+    {
+      m_scheduled[i] = 1;
+      m_heap.push_back(i);
+      std::push_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+    }
+  };
+
+  for (std::size_t j = 0; j < x.size(); j++)
+  {
+    bool unchanged = x[j] == m_x[j] || (is_missing(x[j]) && is_missing(m_x[j]));
+    if (!unchanged)
+    {
+      m_x[j] = x[j];
+      for (std::uint32_t i: m_readers[j])
+      {
+        schedule(i);
+      }
+    }
+  }
+
+  // The successors of a node have a smaller position, so a node is recomputed after all its successors
+  m_update_count = 0;
+  while (!m_heap.empty())
+  {
+    std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+    std::uint32_t i = m_heap.back();
+    m_heap.pop_back();
+    m_scheduled[i] = 0;
+    compute(*m_nodes[i]);
+    m_update_count++;
+    for (std::uint32_t k: m_parents[i])
+    {
+      schedule(k);
+    }
+  }
+}
+
+template <bool LogSpace>
+double incremental_evaluator::evaluate(const std::vector<double>& x)
+{
+  update<LogSpace>(x);
+  return m_nodes.back()->value;
+}
+
+double incremental_evaluator::evi(const std::vector<double>& x)
+{
+  return evaluate<false>(x);
+}
+
+double incremental_evaluator::log_evi(const std::vector<double>& x)
 {
-  return decomposability_checker().check(pc);
+  return evaluate<true>(x);
 }
 
 std::vector<double> sample_pc(const probabilistic_circuit& pc, std::mt19937& rng)
@@ -315,7 +565,38 @@ dataset sample_pc(const probabilistic_circuit& pc, std::size_t n, std::mt19937&
     X.push_back(x);
   }
 
-  return {numerics::matrix<double>(X), pc.category_counts()};
+  return {numerics::matrix<double>(std::move(X)), pc.category_counts()};
+}
+
+dataset sample_pc_parallel(const probabilistic_circuit& pc, std::size_t n, std::uint64_t seed, std::size_t thread_count, std::size_t block_size)
+{
+  std::size_t m = pc.feature_count();
+  numerics::matrix<double> X(n, m);
+
+  block_size = std::max<std::size_t>(block_size, 1);
+  std::size_t block_count = (n + block_size - 1) / block_size;
+  if (thread_count == 0)
+  {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  thread_count = std::min(thread_count, block_count);
+
+  // The tasks take the blocks from a shared counter, and write the samples directly into the rows of X.
+  std::atomic<std::size_t> next_block{0};
+  utilities::run_parallel(thread_count, [&](std::size_t)
+  {
+    for (std::size_t b = next_block++; b < block_count; b = next_block++)
+    {
+      std::mt19937 rng = make_random_stream(seed, b);
+      std::size_t last = std::min(n, (b + 1) * block_size);
+      for (std::size_t i = b * block_size; i < last; i++)
+      {
+        pc.root()->sample(X[i], rng);
+      }
+    }
+  });
+
+  return {std::move(X), pc.category_counts()};
 }
 
 bool is_valid(const probabilistic_circuit& pc)
@@ -352,20 +633,238 @@ bool is_valid(const probabilistic_circuit& pc)
   return valid;
 }
 
-std::shared_ptr<pc_node> fit_normal(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i, const interval& ab)
+namespace detail {
+
+// Returns true if u is a sum node, but not a sum-split node
+inline
+bool is_plain_sum_node(const pc_node& u)
+{
+  return typeid(u) == typeid(sum_node);
+}
+
+inline
+bool is_plain_product_node(const pc_node& u)
+{
+  return typeid(u) == typeid(product_node);
+}
+
+// Returns true if u is an indicator node that evaluates to 1 for all inputs, including infinite and missing values.
+inline
+bool is_trivially_one(const pc_node& u, const std::vector<unsigned int>& category_counts)
+{
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+  bool is_indicator = dynamic_cast<const less_node*>(&u) || dynamic_cast<const greater_equal_node*>(&u) ||
+                      dynamic_cast<const equal_node*>(&u) || dynamic_cast<const not_equal_node*>(&u) ||
+                      dynamic_cast<const subset_node*>(&u);
+  if (!is_indicator)
+  {
+    return false;
+  }
+
+  const auto& u_ = static_cast<const terminal_node&>(u);
+  unsigned int j = u_.scope();
+  std::size_t K = category_counts[j];
+  if (K > 0)
+  {
+    std::vector<double> x(category_counts.size(), 0);
+    x[j] = std::numeric_limits<double>::quiet_NaN();
+    if (u.evi(x) != 1)
+    {
+      return false;
+    }
+    for (std::size_t k = 0; k < K; k++)
+    {
+      x[j] = static_cast<double>(k);
+      if (u.evi(x) != 1)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // N.B. a less node with value infinity is not trivially one, since it evaluates to 0 for x = infinity
+  if (auto v = dynamic_cast<const greater_equal_node*>(&u); v)
+  {
+    return v->value() == -infinity;
+  }
+  return false;
+}
+
+} // namespace detail
+
+void simplify(probabilistic_circuit& pc)
+{
+  const auto& category_counts = pc.category_counts();
+
+  // Remove the edges of sum nodes that have weight 0 or that lead to a node that is identically 0. A sum node that
+  // loses all its edges, and a product node with such a successor, are identically 0 themselves. A sum node that is
+  // identically 0 is left unchanged, to avoid sum nodes without successors.
+  std::unordered_set<const pc_node*> zero;
+  for (const auto& u: topological_ordering(pc))
+  {
+    auto& successors = u->successors();
+    if (detail::is_plain_sum_node(*u))
+    {
+      auto& u_ = static_cast<sum_node&>(*u);
+      const auto& weights = u_.weights();
+      std::vector<pc_node_ptr> new_successors;
+      std::vector<double> new_weights;
+      for (std::size_t i = 0; i < successors.size(); i++)
+      {
+        if (weights[i] != 0 && zero.count(successors[i].get()) == 0)
+        {
+          new_successors.push_back(successors[i]);
+          new_weights.push_back(weights[i]);
+        }
+      }
+      if (new_successors.empty())
+      {
+        zero.insert(u.get());
+      }
+      else if (new_successors.size() < successors.size())
+      {
+        successors = std::move(new_successors);
+        u_.set_weights(std::move(new_weights));
+      }
+    }
+    else if (detail::is_plain_product_node(*u))
+    {
+      if (std::any_of(successors.begin(), successors.end(), [&](const pc_node_ptr& v) { return zero.count(v.get()) > 0; }))
+      {
+        zero.insert(u.get());
+      }
+    }
+  }
+
+  // The in-degrees are computed after the pruning, so that they only count edges of nodes that are still reachable.
+  std::vector<pc_node_ptr> order = topological_ordering(pc);
+
+  std::unordered_map<const pc_node*, std::size_t> in_degree;
+  for (const auto& u: order)
+  {
+    for (const auto& v: u->successors())
+    {
+      in_degree[v.get()]++;
+    }
+  }
+
+  // Successors are simplified before their predecessors. If a node u is replaced by a node v, the parents of u
+  // become parents of v.
+  std::unordered_map<const pc_node*, pc_node_ptr> replacement;
+  auto replace = [&](const pc_node_ptr& u, const pc_node_ptr& v)
+  {
+    replacement[u.get()] = v;
+    in_degree[v.get()] += in_degree[u.get()];
+    in_degree[v.get()]--;
+  };
+
+  for (const auto& u: order)
+  {
+    auto& successors = u->successors();
+    for (auto& v: successors)
+    {
+      auto i = replacement.find(v.get());
+      if (i != replacement.end())
+      {
+        v = i->second;
+      }
+    }
+
+    if (detail::is_plain_sum_node(*u))
+    {
+      auto& u_ = static_cast<sum_node&>(*u);
+      const auto& weights = u_.weights();
+      if (zero.count(u.get()) > 0)
+      {
+        continue;
+      }
+
+      // Merge sum nodes that have u as their only parent.
+      std::vector<pc_node_ptr> new_successors;
+      std::vector<double> new_weights;
+      for (std::size_t i = 0; i < successors.size(); i++)
+      {
+        const auto& v = successors[i];
+        if (detail::is_plain_sum_node(*v) && in_degree[v.get()] == 1)
+        {
+          const auto& v_ = static_cast<const sum_node&>(*v);
+          for (std::size_t k = 0; k < v->successors().size(); k++)
+          {
+            new_successors.push_back(v->successors()[k]);
+            new_weights.push_back(weights[i] * v_.weights()[k]);
+          }
+        }
+        else
+        {
+          new_successors.push_back(v);
+          new_weights.push_back(weights[i]);
+        }
+      }
+      successors = std::move(new_successors);
+      u_.set_weights(std::move(new_weights));
+
+      if (successors.size() == 1 && u_.weights().front() == 1)
+      {
+        replace(u, successors.front());
+      }
+    }
+    else if (detail::is_plain_product_node(*u))
+    {
+      // Remove indicators that are trivially one, and flatten product nodes that have u as their only parent.
+      std::vector<pc_node_ptr> new_successors;
+      pc_node_ptr one;
+      for (const auto& v: successors)
+      {
+        if (detail::is_trivially_one(*v, category_counts))
+        {
+          in_degree[v.get()]--;
+          one = v;
+        }
+        else if (detail::is_plain_product_node(*v) && in_degree[v.get()] == 1)
+        {
+          new_successors.insert(new_successors.end(), v->successors().begin(), v->successors().end());
+        }
+        else
+        {
+          new_successors.push_back(v);
+        }
+      }
+      if (new_successors.empty())
+      {
+        in_degree[one.get()]++;
+        new_successors.push_back(one);
+      }
+      successors = std::move(new_successors);
+
+      if (successors.size() == 1)
+      {
+        replace(u, successors.front());
+      }
+    }
+  }
+
+  auto i = replacement.find(pc.root().get());
+  if (i != replacement.end())
+  {
+    pc.root() = i->second;
+  }
+}
+
+std::shared_ptr<pc_node> fit_normal(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i, const interval& ab, pc_node_factory& factory)
 {
   auto [mu, sigma] = u.I.empty() ? std::make_pair(0.0, 1.0) : mean_standard_deviation(D, u.I, i);
   if (ab.is_maximal())
   {
-    return std::make_shared<normal_node>(i, mu, sigma);
+    return factory.make_normal(i, mu, sigma);
   }
   else
   {
-    return std::make_shared<truncated_normal_node>(i, mu, sigma, ab.a, ab.b);
+    return factory.make_truncated_normal(i, mu, sigma, ab.a, ab.b);
   }
 }
 
-std::shared_ptr<pc_node> fit_categorical(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i)
+std::shared_ptr<pc_node> fit_categorical(const binary_decision_tree::vertex& u, const dataset& D, std::size_t i, pc_node_factory& factory)
 {
   std::size_t K = D.category_counts()[i];
   AITOOLS_DECLARE_STACK_ARRAY(counts, std::size_t, K);
@@ -378,51 +877,112 @@ std::shared_ptr<pc_node> fit_categorical(const binary_decision_tree::vertex& u,
   {
     probabilities.push_back(static_cast<double>(k) / total);
   }
-  return std::make_shared<categorical_node>(i, probabilities);
+  return factory.make_categorical(i, std::move(probabilities));
+}
+
+std::shared_ptr<pc_node> fit_normal(const variable_statistics& stats, std::size_t i, const interval& ab, pc_node_factory& factory)
+{
+  auto [mu, sigma] = stats.row_count == 0 ? std::make_pair(0.0, 1.0) : stats.mean_standard_deviation(i);
+  if (ab.is_maximal())
+  {
+    return factory.make_normal(i, mu, sigma);
+  }
+  else
+  {
+    return factory.make_truncated_normal(i, mu, sigma, ab.a, ab.b);
+  }
+}
+
+std::shared_ptr<pc_node> fit_categorical(const variable_statistics& stats, std::size_t i, pc_node_factory& factory)
+{
+  std::size_t first = stats.category_offsets[i];
+  std::size_t last = stats.category_offsets[i + 1];
+  std::size_t total = std::accumulate(stats.category_counts.begin() + first, stats.category_counts.begin() + last, std::size_t(0));
+  std::vector<double> probabilities;
+  probabilities.reserve(last - first);
+  for (std::size_t k = first; k < last; k++)
+  {
+    probabilities.push_back(static_cast<double>(stats.category_counts[k]) / total);
+  }
+  return factory.make_categorical(i, std::move(probabilities));
 }
 
-void fit_leave_nodes(const binary_decision_tree& tree, std::vector<std::shared_ptr<pc_node>>& pc_nodes, const dataset& D)
+void fit_leave_nodes(const binary_decision_tree& tree, std::vector<std::shared_ptr<pc_node>>& pc_nodes, const dataset& D, pc_node_factory& factory, bool sequential)
 {
   using vertex = binary_decision_tree::vertex;
 
   const auto& ncat = tree.category_counts();
   std::size_t m = tree.feature_count();
 
-  enumerate_intervals(tree, m, [&](const vertex& u, std::uint32_t ui, const std::vector<interval>& intervals)
+  auto fit_leaf = [&](const vertex& u, std::uint32_t ui, const std::vector<interval>& intervals)
   {
-    if (u.is_leaf())
+    // compute the statistics of all variables in a single pass over the samples of the leaf
+    variable_statistics stats;
+    compute_variable_statistics(D, u.I, stats);
+
+    // construct a product node with an outgoing edge for each variable
+    auto u_ = std::make_shared<product_node>();
+    for (std::size_t i = 0; i < m; i++)
     {
-      // construct a product node with an outgoing edge for each variable
-      auto u_ = std::make_shared<product_node>();
-      for (std::size_t i = 0; i < m; i++)
+      if (ncat[i] < 2) // continuous variable
       {
-        if (ncat[i] < 2) // continuous variable
-        {
-          auto v_i = fit_normal(u, D, i, intervals[i]);
-          u_->successors().push_back(v_i);
-        }
-        else
-        {
-          auto v_i = fit_categorical(u, D, i);
-          u_->successors().push_back(v_i);
-        }
+        auto v_i = fit_normal(stats, i, intervals[i], factory);
+        u_->successors().push_back(v_i);
       }
-      // add an outgoing edge for the class variable
-      auto v = fit_categorical(u, D, m);
-      u_->successors().push_back(v);
-      pc_nodes[ui] = u_;
+      else
+      {
+        auto v_i = fit_categorical(stats, i, factory);
+        u_->successors().push_back(v_i);
+      }
+    }
+    // add an outgoing edge for the class variable
+    auto v = fit_categorical(stats, m, factory);
+    u_->successors().push_back(v);
+    pc_nodes[ui] = u_;
+  };
+
+  if (sequential)
+  {
+    enumerate_intervals(tree, m, [&](const vertex& u, std::uint32_t ui, const std::vector<interval>& intervals)
+    {
+      if (u.is_leaf())
+      {
+        fit_leaf(u, ui, intervals);
+      }
+    });
+    return;
+  }
+
+  // First collect the leaves with their intervals, and then fit them in parallel. Each leaf writes to its own
+  // position in pc_nodes.
+  struct leaf
+  {
+    const vertex* u;
+    std::uint32_t ui;
+    std::vector<interval> intervals;
+  };
+  std::vector<leaf> leaves;
+  enumerate_intervals(tree, m, [&](const vertex& u, std::uint32_t ui, const std::vector<interval>& intervals)
+  {
+    if (u.is_leaf())
+    {
+      leaves.push_back({&u, ui, intervals});
     }
   });
+  std::for_each(std::execution::par, leaves.begin(), leaves.end(), [&](const leaf& l)
+  {
+    fit_leaf(*l.u, l.ui, l.intervals);
+  });
 }
 
-std::shared_ptr<pc_node> build_generative_tree(const binary_decision_tree& tree, const dataset& D)
+std::shared_ptr<pc_node> build_generative_tree(const binary_decision_tree& tree, const dataset& D, pc_node_factory& factory, bool sequential)
 {
   std::size_t n = tree.vertices().size();
   std::vector<std::shared_ptr<pc_node>> pc_nodes{n};
 
   // First construct the leaf nodes. This has to be done in a separate step, since the Gaussian leaf nodes need
   // to be truncated to an interval [a,b].
-  fit_leave_nodes(tree, pc_nodes, D);
+  fit_leave_nodes(tree, pc_nodes, D, factory, sequential);
 
   std::vector<std::uint32_t> order = topological_ordering(tree);
   std::reverse(order.begin(), order.end());
@@ -444,53 +1004,76 @@ std::shared_ptr<pc_node> build_generative_tree(const binary_decision_tree& tree,
   return pc_nodes.front();
 }
 
-probabilistic_circuit build_generative_forest(const random_forest& forest, const dataset& D)
+probabilistic_circuit build_generative_forest(const random_forest& forest, const dataset& D, bool hash_consing, bool sequential)
 {
-  std::size_t N = forest.trees().size();
+  const auto& trees = forest.trees();
+  std::size_t N = trees.size();
   double weight = 1.0 / N;
   std::vector<double> weights(N, weight);
   auto root = std::make_shared<sum_node>(weights);
-  for (const auto& tree: forest.trees())
+  pc_node_factory factory(hash_consing);
+  auto& successors = root->successors();
+  successors.resize(N);
+  if (sequential)
+  {
+    for (std::size_t i = 0; i < N; i++)
+    {
+      successors[i] = build_generative_tree(trees[i], D, factory, true);
+    }
+  }
+  else
   {
-    root->successors().push_back(build_generative_tree(tree, D));
+    std::vector<std::size_t> indices(N);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](std::size_t i)
+    {
+      successors[i] = build_generative_tree(trees[i], D, factory, false);
+    });
   }
   return probabilistic_circuit(root, D.category_counts());
 }
 
-void expand_sum_split_nodes(probabilistic_circuit& pc)
+void expand_sum_split_nodes(probabilistic_circuit& pc, bool hash_consing)
 {
-  std::deque<std::shared_ptr<pc_node>> todo = { pc.root() };
+  pc_node_factory factory(hash_consing);
 
-  auto expand_sum_split_node = [](std::shared_ptr<sum_split_node>& u) -> std::shared_ptr<pc_node>
+  auto expand_sum_split_node = [&factory](const sum_split_node& u) -> std::shared_ptr<pc_node>
   {
-    auto& u_successors = u->successors();
+    auto result = std::make_shared<sum_node>(u.weights());
+    const auto& u_successors = u.successors();
     for (std::size_t j = 0; j < u_successors.size(); j++)
     {
-      auto v_j = u_successors[j];
       auto y_j = std::make_shared<product_node>();
-      auto z_j = detail::make_indicator_node(u->splitter(), j);
-      u_successors[j] = y_j;
-      y_j->successors() = {v_j, z_j};
+      auto z_j = detail::make_indicator_node(u.splitter(), j, factory);
+      y_j->successors() = {u_successors[j], z_j};
+      result->successors().push_back(y_j);
     }
-    auto result = std::make_shared<sum_node>(std::move(u->weights()));
-    result->successors() = std::move(u->successors());
     return result;
   };
 
-  while (!todo.empty())
+  // Successors are handled before their predecessors, so a shared sum-split node is replaced only once.
+  std::unordered_map<const pc_node*, pc_node_ptr> replacement;
+  for (const auto& u: topological_ordering(pc))
   {
-    auto u = todo.front();
-    todo.pop_front();
     for (auto& v: u->successors())
     {
-      auto v_ = std::dynamic_pointer_cast<sum_split_node>(v);
-      if (v_)
+      auto i = replacement.find(v.get());
+      if (i != replacement.end())
       {
-        v = expand_sum_split_node(v_);
+        v = i->second;
       }
-      todo.push_back(v);
     }
+    if (auto u_ = std::dynamic_pointer_cast<sum_split_node>(u))
+    {
+      replacement[u.get()] = expand_sum_split_node(*u_);
+    }
+  }
+
+  auto i = replacement.find(pc.root().get());
+  if (i != replacement.end())
+  {
+    pc.root() = i->second;
   }
 }
 
-} // namespace aitools
\ No newline at end of file
+} // namespace aitools
@@ -221,7 +221,7 @@ PYBIND11_MODULE(aitools, m)
   m.def("learn_random_forest", &learn_rf);
   m.def("parse_impurity_measure", &parse_impurity_measure);
   m.def("parse_sample_technique", &parse_sample_technique);
-  m.def("build_generative_forest", &build_generative_forest);
+  m.def("build_generative_forest", &build_generative_forest, py::arg("forest"), py::arg("D"), py::arg("hash_consing") = true, py::arg("sequential") = false);
 
   py::class_<std::mt19937>(m, "RandomNumberGenerator")
     .def(py::init<std::uint32_t>(), py::return_value_policy::copy)
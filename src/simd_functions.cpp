@@ -0,0 +1,174 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file src/simd_functions.cpp
+/// \brief Scalar kernels and runtime dispatch for aitools/numerics/simd_functions.h.
+
+#include <cmath>
+#include <limits>
+#include "aitools/numerics/simd_functions.h"
+#include "aitools/numerics/detail/simd_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AITOOLS_SIMD_X86 1
+#endif
+
+namespace aitools::simd {
+
+namespace {
+
+void exp_scalar(const double* first, const double* last, double* result)
+{
+  for (; first != last; ++first, ++result)
+  {
+    *result = std::exp(*first);
+  }
+}
+
+void log_scalar(const double* first, const double* last, double* result)
+{
+  for (; first != last; ++first, ++result)
+  {
+    *result = std::log(*first);
+  }
+}
+
+double log_sum_exp_scalar(const double* first, const double* last)
+{
+  if (first == last)
+  {
+    return 0.0;
+  }
+
+  double shift = -std::numeric_limits<double>::infinity();
+  for (auto i = first; i != last; ++i)
+  {
+    if (*i > shift)
+    {
+      shift = *i;
+    }
+  }
+  if (!std::isfinite(shift))
+  {
+    shift = 0.0; // all values are -inf, or some value is +inf
+  }
+
+  double sum = 0.0;
+  for (auto i = first; i != last; ++i)
+  {
+    sum += std::exp(*i - shift);
+  }
+  return std::log(sum) + shift;
+}
+
+void normal_log_pdf_scalar(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer)
+{
+  for (; first != last; ++first, ++result)
+  {
+    double z = (*first - mean) * inverse_sigma;
+    *result = log_normalizer - 0.5 * z * z;
+  }
+}
+
+struct kernel_table
+{
+  instruction_set set;
+  void (*exp)(const double*, const double*, double*);
+  void (*log)(const double*, const double*, double*);
+  double (*log_sum_exp)(const double*, const double*);
+  void (*normal_log_pdf)(const double*, const double*, double*, double, double, double);
+};
+
+const kernel_table scalar_kernels = { instruction_set::scalar, exp_scalar, log_scalar, log_sum_exp_scalar, normal_log_pdf_scalar };
+#ifdef AITOOLS_SIMD_X86
+const kernel_table avx2_kernels = { instruction_set::avx2, detail::exp_avx2, detail::log_avx2, detail::log_sum_exp_avx2, detail::normal_log_pdf_avx2 };
+const kernel_table avx512_kernels = { instruction_set::avx512, detail::exp_avx512, detail::log_avx512, detail::log_sum_exp_avx512, detail::normal_log_pdf_avx512 };
+#endif
+
+const kernel_table& kernels_of(instruction_set s)
+{
+#ifdef AITOOLS_SIMD_X86
+  switch (s)
+  {
+    case instruction_set::avx512: return avx512_kernels;
+    case instruction_set::avx2: return avx2_kernels;
+    default: break;
+  }
+#endif
+  return scalar_kernels;
+}
+
+// The kernels that are currently in use. It is initialized with the best kernels supported by the CPU.
+const kernel_table*& current_kernels()
+{
+  static const kernel_table* kernels = &kernels_of(detected_instruction_set());
+  return kernels;
+}
+
+} // namespace
+
+std::string instruction_set_name(instruction_set s)
+{
+  switch (s)
+  {
+    case instruction_set::avx512: return "avx512";
+    case instruction_set::avx2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+instruction_set detected_instruction_set()
+{
+#ifdef AITOOLS_SIMD_X86
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    return instruction_set::avx512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    return instruction_set::avx2;
+  }
+#endif
+  return instruction_set::scalar;
+}
+
+instruction_set selected_instruction_set()
+{
+  return current_kernels()->set;
+}
+
+instruction_set select_instruction_set(instruction_set s)
+{
+  instruction_set detected = detected_instruction_set();
+  if (static_cast<int>(s) > static_cast<int>(detected))
+  {
+    s = detected;
+  }
+  current_kernels() = &kernels_of(s);
+  return s;
+}
+
+void exp(const double* first, const double* last, double* result)
+{
+  current_kernels()->exp(first, last, result);
+}
+
+void log(const double* first, const double* last, double* result)
+{
+  current_kernels()->log(first, last, result);
+}
+
+double log_sum_exp(const double* first, const double* last)
+{
+  return current_kernels()->log_sum_exp(first, last);
+}
+
+void normal_log_pdf(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer)
+{
+  current_kernels()->normal_log_pdf(first, last, result, mean, inverse_sigma, log_normalizer);
+}
+
+} // namespace aitools::simd
@@ -0,0 +1,119 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file src/simd_functions_avx2.cpp
+/// \brief AVX2 versions of the kernels in aitools/numerics/simd_functions.h.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "aitools/numerics/detail/simd_kernels.h"
+
+namespace aitools::simd::detail {
+
+namespace {
+
+struct avx2
+{
+  using reg = __m256d;
+  using mask = __m256d;
+  static constexpr std::size_t width = 4;
+
+  static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, reg a) { _mm256_storeu_pd(p, a); }
+  static reg set1(double x) { return _mm256_set1_pd(x); }
+  static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+  static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+  static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+  static reg fnmadd(reg a, reg b, reg c) { return _mm256_fnmadd_pd(a, b, c); }
+  static reg round(reg a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+  static mask gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+  static mask eq(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+  static mask is_nan(reg a) { return _mm256_cmp_pd(a, a, _CMP_UNORD_Q); }
+  static reg blend(mask m, reg a, reg b) { return _mm256_blendv_pd(a, b, m); }
+
+  // Adding 2^52 + 1023 moves the biased exponent n + 1023 into the lowest bits of the mantissa.
+  static reg pow2(reg n)
+  {
+    __m256i bits = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(4503599627370496.0 + 1023.0)));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+  }
+
+  static reg exponent(reg x)
+  {
+    __m256i e = _mm256_srli_epi64(_mm256_castpd_si256(x), 52);
+    reg result = _mm256_castsi256_pd(_mm256_or_si256(e, _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0))));
+    return _mm256_sub_pd(result, _mm256_set1_pd(4503599627370496.0 + 1023.0));
+  }
+
+  static reg mantissa(reg x)
+  {
+    __m256i bits = _mm256_and_si256(_mm256_castpd_si256(x), _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL));
+    return _mm256_castsi256_pd(_mm256_or_si256(bits, _mm256_set1_epi64x(0x3FF0000000000000LL)));
+  }
+
+  static double reduce_add(reg a)
+  {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  }
+
+  static double reduce_max(reg a)
+  {
+    __m128d s = _mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(s, _mm_unpackhi_pd(s, s)));
+  }
+};
+
+} // namespace
+
+void exp_avx2(const double* first, const double* last, double* result)
+{
+  transform<avx2>(first, last, result, exp_function<avx2>());
+}
+
+void log_avx2(const double* first, const double* last, double* result)
+{
+  transform<avx2>(first, last, result, log_function<avx2>());
+}
+
+double log_sum_exp_avx2(const double* first, const double* last)
+{
+  return log_sum_exp<avx2>(first, last);
+}
+
+void normal_log_pdf_avx2(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer)
+{
+  normal_log_pdf<avx2>(first, last, result, mean, inverse_sigma, log_normalizer);
+}
+
+} // namespace aitools::simd::detail
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
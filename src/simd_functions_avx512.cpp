@@ -0,0 +1,110 @@
+// Copyright: Wieger Wesselink 2021
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file src/simd_functions_avx512.cpp
+/// \brief AVX-512 versions of the kernels in aitools/numerics/simd_functions.h.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+// The AVX-512 intrinsics of GCC start from _mm512_undefined_pd(), which triggers -Wmaybe-uninitialized when they
+// are inlined
+#if !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+#if !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+#include "aitools/numerics/detail/simd_kernels.h"
+
+namespace aitools::simd::detail {
+
+namespace {
+
+struct avx512
+{
+  using reg = __m512d;
+  using mask = __mmask8;
+  static constexpr std::size_t width = 8;
+
+  static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  static void store(double* p, reg a) { _mm512_storeu_pd(p, a); }
+  static reg set1(double x) { return _mm512_set1_pd(x); }
+  static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+  static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+  static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+  static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+  static reg fnmadd(reg a, reg b, reg c) { return _mm512_fnmadd_pd(a, b, c); }
+  static reg round(reg a) { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+  static mask gt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+  static mask eq(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+  static mask is_nan(reg a) { return _mm512_cmp_pd_mask(a, a, _CMP_UNORD_Q); }
+  static reg blend(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, a, b); }
+
+  // Adding 2^52 + 1023 moves the biased exponent n + 1023 into the lowest bits of the mantissa.
+  static reg pow2(reg n)
+  {
+    __m512i bits = _mm512_castpd_si512(_mm512_add_pd(n, _mm512_set1_pd(4503599627370496.0 + 1023.0)));
+    return _mm512_castsi512_pd(_mm512_slli_epi64(bits, 52));
+  }
+
+  static reg exponent(reg x) { return _mm512_getexp_pd(x); }
+  static reg mantissa(reg x) { return _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero); }
+  static double reduce_add(reg a) { return _mm512_reduce_add_pd(a); }
+  static double reduce_max(reg a) { return _mm512_reduce_max_pd(a); }
+};
+
+} // namespace
+
+void exp_avx512(const double* first, const double* last, double* result)
+{
+  transform<avx512>(first, last, result, exp_function<avx512>());
+}
+
+void log_avx512(const double* first, const double* last, double* result)
+{
+  transform<avx512>(first, last, result, log_function<avx512>());
+}
+
+double log_sum_exp_avx512(const double* first, const double* last)
+{
+  return log_sum_exp<avx512>(first, last);
+}
+
+void normal_log_pdf_avx512(const double* first, const double* last, double* result, double mean, double inverse_sigma, double log_normalizer)
+{
+  normal_log_pdf<avx512>(first, last, result, mean, inverse_sigma, log_normalizer);
+}
+
+} // namespace aitools::simd::detail
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
@@ -12,6 +12,8 @@
 #include <cmath>
 #include <random>
 #include "aitools/datasets/algorithms.h"
+#include "aitools/datasets/csv_import.h"
+#include "aitools/datasets/io.h"
 #include "aitools/datasets/random.h"
 #include "aitools/decision_trees/learning.h"
 #include "aitools/statistics/distributions.h"
@@ -121,3 +123,181 @@ TEST_CASE("test_random_dataset")
   REQUIRE_LT(std::abs(p1 - 0.3), 0.05);
   REQUIRE_LT(std::abs(p2 - 0.5), 0.05);
 }
+
+TEST_CASE("test_variable_statistics")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::vector<distribution> distributions = { normal_distribution(1, 2), normal_distribution(3, 1), categorical_distribution({0.2, 0.3, 0.5})};
+  std::size_t n = 1000;
+  std::mt19937 rng{12345};
+  dataset D = make_random_dataset(distributions, n, rng);
+
+  // add some missing values
+  auto& X = D.X();
+  for (std::size_t i = 0; i < n; i += 7)
+  {
+    X[i][i % 3] = std::nan("");
+  }
+
+  // use the odd rows
+  std::vector<std::uint32_t> I;
+  for (std::uint32_t i = 1; i < n; i += 2)
+  {
+    I.push_back(i);
+  }
+
+  variable_statistics stats;
+  compute_variable_statistics(D, I, stats);
+  CHECK_EQ(stats.row_count, I.size());
+  for (std::size_t v = 0; v < 2; v++)
+  {
+    auto [mu, sigma] = stats.mean_standard_deviation(v);
+    auto [mu_expected, sigma_expected] = mean_standard_deviation(D, I, v);
+    CHECK_LT(std::abs(mu - mu_expected), 1e-10);
+    CHECK_LT(std::abs(sigma - sigma_expected), 1e-10);
+  }
+  std::vector<std::size_t> counts(3);
+  D.compute_categorical_counts(I, 2, counts);
+  CHECK_EQ(stats.categorical_counts(2), counts);
+}
+
+TEST_CASE("test_parse_dataset")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text =
+    "dataset: 1.0\n"
+    "category_counts: 0 3 0\n"
+    "features: x y z\n"
+    "\n"
+    "1.5 2 -3e-2\n"
+    "  nan 0 +4\r\n"
+    "\n"
+    "-inf 1 0.125\n"
+    "2 2 1e-400";
+
+  std::vector<std::vector<double>> expected = {{1.5, 2, -3e-2}, {std::nan(""), 0, 4}, {-std::numeric_limits<double>::infinity(), 1, 0.125}, {2, 2, 0}};
+  for (std::size_t chunk_size: {1, 7, 1 << 20})
+  {
+    dataset_parser parser;
+    parser.chunk_size = chunk_size;
+    parser.parse_text(text);
+    dataset D = parser.get_result();
+    CHECK_EQ(D.category_counts(), (std::vector<unsigned int>{0, 3, 0}));
+    CHECK_EQ(D.features(), (std::vector<std::string>{"x", "y", "z"}));
+    const auto& X = D.X();
+    CHECK_EQ(X.row_count(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++)
+    {
+      for (std::size_t j = 0; j < 3; j++)
+      {
+        CHECK((X[i][j] == expected[i][j] || (std::isnan(X[i][j]) && std::isnan(expected[i][j]))));
+      }
+    }
+  }
+
+  // a round trip
+  std::ostringstream out;
+  out << parse_dataset(text);
+  std::ostringstream out1;
+  out1 << parse_dataset(out.str());
+  CHECK_EQ(out.str(), out1.str());
+
+  CHECK_THROWS(parse_dataset("category_counts: 0 0\n1 2\n1 x\n"));
+}
+
+TEST_CASE("test_save_dataset")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  // the values are written such that they parse back exactly
+  std::mt19937 rng{12345};
+  std::normal_distribution<double> dist(0.0, 1.0);
+  numerics::matrix<double> X(10000, 2);
+  for (std::size_t i = 0; i < X.row_count(); i++)
+  {
+    X[i][0] = dist(rng);
+    X[i][1] = static_cast<double>(i % 3);
+  }
+  X[0][0] = 0.1 + 0.2;
+  X[1][0] = std::numeric_limits<double>::lowest();
+  dataset D(X, {0, 3});
+
+  std::ostringstream out;
+  out << D;
+  dataset D1 = parse_dataset(out.str());
+  CHECK_EQ(D1.category_counts(), D.category_counts());
+  CHECK(D1.X() == D.X());
+}
+
+TEST_CASE("test_parse_csv_dataset")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text =
+    "\"age\",\"colour\",\"size\",\"weight\",\"label\"\n"
+    "24, red,1,2.5,0\n"
+    "45,\"dark, \"\"blue\"\"\",3,-1,1\r\n"
+    "\n"
+    "31,red,,7,0\n"
+    "31,?,2,1e3,2\n"
+    "50,green,2,4,0\n"
+    "60,red,1,4,1\n"
+    "65,blue,3,5,1\n"
+    "70,red,1,6,1\n"
+    "72,green,2,8,1\n";
+
+  for (std::size_t chunk_size: {1, 20, 1 << 20})
+  {
+    csv_dataset_parser parser;
+    parser.max_categories = 3;
+    parser.chunk_size = chunk_size;
+    parser.parse_text(text);
+    dataset D = parser.get_result();
+    CHECK_EQ(D.features(), (std::vector<std::string>{"age", "colour", "size", "weight", "label"}));
+    CHECK_EQ(D.category_counts(), (std::vector<unsigned int>{0, 4, 0, 0, 3}));
+    CHECK_EQ(parser.categories()[1], (std::vector<std::string>{"red", "dark, \"blue\"", "green", "blue"}));
+    const auto& X = D.X();
+    CHECK_EQ(X.row_count(), 9);
+    CHECK_EQ(X[1], (std::vector<double>{45, 1, 3, -1, 1}));
+    CHECK(is_missing(X[2][2]));
+    CHECK(is_missing(X[3][1]));
+    CHECK_EQ(X[3][3], 1000);
+  }
+
+  // a column with numbers and strings is dictionary-encoded
+  dataset D = parse_csv_dataset("1 a\n2 2\n3 b\n", ' ', false);
+  CHECK(D.features().empty());
+  CHECK_EQ(D.category_counts(), (std::vector<unsigned int>{0, 3}));
+  CHECK_EQ(D.X()[1][1], 1);
+
+  // the class column is categorical, also if it has many distinct values, and infinite values are continuous
+  D = parse_csv_dataset("x,y,z\n0,0,0\n1,inf,7\n2,1,3\n3,2,1\n");
+  CHECK_EQ(D.category_counts(), (std::vector<unsigned int>{0, 0, 8}));
+
+  // the class column is moved to the end
+  csv_dataset_parser parser;
+  parser.class_column = 0;
+  parser.parse_text("x,y,z\n0,0,a\n5,1.5,b\n2,2,a\n3,3,b\n");
+  D = parser.get_result();
+  CHECK_EQ(D.features(), (std::vector<std::string>{"y", "z", "x"}));
+  CHECK_EQ(D.category_counts(), (std::vector<unsigned int>{0, 2, 6}));
+  CHECK_EQ(parser.categories()[1], (std::vector<std::string>{"a", "b"}));
+  CHECK_EQ(D.X()[1], (std::vector<double>{1.5, 1, 5}));
+
+  // whole numbers with a large maximum are continuous
+  D = parse_csv_dataset("year,big,label\n2019,0,0\n2020,1e12,1\n2021,0,0\n2019,1e12,1\n2020,0,0\n2021,0,1\n");
+  CHECK_EQ(D.category_counts(), (std::vector<unsigned int>{0, 0, 2}));
+
+  CHECK_THROWS(parse_csv_dataset("a,b\n1,2\n1,2,3\n"));
+  CHECK_THROWS(parse_csv_dataset("a,b\n1,\"2\n"));
+  CHECK_THROWS(parse_csv_dataset("a,b\n1,0.5\n2,1\n"));
+  CHECK_THROWS(parse_csv_dataset("a,b\n1,0\n2,2019\n"));
+  parser.class_column = 2;
+  CHECK_THROWS(parser.parse_text("x,y\n0,0\n"));
+}
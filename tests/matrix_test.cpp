@@ -62,6 +62,10 @@ TEST_CASE("test1")
   CHECK(M(2, 3) == 1.0);
   CHECK(M[2][4] == 2.0);
 
+  numerics::matrix<> E(std::vector<std::vector<double>>{});
+  CHECK_EQ(E.row_count(), 0);
+  CHECK_EQ(E.column_count(), 0);
+
   numerics::matrix<int> A = random_int_matrix(2, 3, 0, 10);
   std::cout << "A =\n" << A << std::endl;
 
@@ -15,6 +15,8 @@
 #include <iostream>
 #include <iomanip>
 #include <random>
+#include <vector>
+#include "aitools/numerics/simd_functions.h"
 #include "aitools/utilities/print.h"
 #include "aitools/utilities/random.h"
 
@@ -100,3 +102,106 @@ TEST_CASE("test_strtod")
   CHECK(errno == ERANGE);  // This should pass if underflow occurs
   CHECK(result == 0.0);    // For an underflow, the result should be 0.0
 }
+
+// Returns the distance between x and y in units in the last place of y.
+inline
+double ulp_distance(double x, double y)
+{
+  if (x == y || (std::isnan(x) && std::isnan(y)))
+  {
+    return 0;
+  }
+  return std::abs(x - y) / (std::nextafter(std::abs(y), std::numeric_limits<double>::infinity()) - std::abs(y));
+}
+
+TEST_CASE("test_simd_functions")
+{
+  using namespace aitools;
+  constexpr double inf = std::numeric_limits<double>::infinity();
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+  std::mt19937 rng{12345};
+  std::vector<double> x;
+  std::uniform_real_distribution<double> uniform(-745, 709);
+  for (std::size_t i = 0; i < 10000; i++)
+  {
+    x.push_back(uniform(rng));
+  }
+  std::vector<double> special = { 0.0, -0.0, 1.0, -1.0, 709.78, 709.79, -745.1, -745.2, -708.5, 1e-310, 5e-324, inf, -inf, nan };
+  x.insert(x.end(), special.begin(), special.end());
+  std::vector<double> y(x.size());
+
+  for (auto s: { simd::instruction_set::scalar, simd::instruction_set::avx2, simd::instruction_set::avx512 })
+  {
+    if (simd::select_instruction_set(s) != s)
+    {
+      continue;
+    }
+    std::cout << "instruction set " << simd::instruction_set_name(s) << std::endl;
+
+    simd::exp(x.data(), x.data() + x.size(), y.data());
+    double max_error = 0;
+    for (std::size_t i = 0; i < x.size(); i++)
+    {
+      double expected = std::exp(x[i]);
+      if (expected >= std::numeric_limits<double>::min() || expected == 0 || std::isinf(expected) || std::isnan(expected))
+      {
+        max_error = std::max(max_error, ulp_distance(y[i], expected));
+      }
+      else
+      {
+        CHECK_LE(std::abs(y[i] - expected), std::numeric_limits<double>::denorm_min());
+      }
+    }
+    CHECK_LE(max_error, 2);
+
+    std::vector<double> z(x.size());
+    for (std::size_t i = 0; i < x.size(); i++)
+    {
+      z[i] = std::abs(x[i]) * (i % 3 == 0 ? 1e-300 : 1);
+    }
+    z.push_back(-1);
+    y.resize(z.size());
+    simd::log(z.data(), z.data() + z.size(), y.data());
+    max_error = 0;
+    for (std::size_t i = 0; i < z.size(); i++)
+    {
+      max_error = std::max(max_error, ulp_distance(y[i], std::log(z[i])));
+    }
+    CHECK_LE(max_error, 1);
+    y.resize(x.size());
+
+    // log_sum_exp for all lengths up to 20, so that the remainder loops are covered
+    for (std::size_t n = 1; n <= 20; n++)
+    {
+      long double sum = 0;
+      for (std::size_t i = 0; i < n; i++)
+      {
+        sum += std::exp(static_cast<long double>(x[i] / 100));
+        y[i] = x[i] / 100;
+      }
+      double expected = static_cast<double>(std::log(sum));
+      double result = simd::log_sum_exp(y.data(), y.data() + n);
+      CHECK_LE(std::abs(result - expected), 4 * std::numeric_limits<double>::epsilon() * std::max(1.0, std::abs(expected)));
+    }
+    std::vector<double> a = { -inf, -inf, -inf };
+    CHECK_EQ(simd::log_sum_exp(a.data(), a.data() + a.size()), -inf);
+    a = { 1000, 1000, -inf };
+    CHECK_LT(std::abs(simd::log_sum_exp(a.data(), a.data() + a.size()) - (1000 + std::log(2.0))), 1e-12);
+    a = { 1, nan, 2 };
+    CHECK(std::isnan(simd::log_sum_exp(a.data(), a.data() + a.size())));
+    CHECK_EQ(simd::log_sum_exp(a.data(), a.data()), 0);
+
+    double mean = 2;
+    double sigma = 0.5;
+    double log_normalizer = -std::log(sigma * std::sqrt(2 * M_PI));
+    simd::normal_log_pdf(x.data(), x.data() + 11, y.data(), mean, 1 / sigma, log_normalizer);
+    for (std::size_t i = 0; i < 11; i++)
+    {
+      double z_i = (x[i] - mean) / sigma;
+      double expected = log_normalizer - 0.5 * z_i * z_i;
+      CHECK_LE(std::abs(y[i] - expected), 1e-15 * std::abs(expected));
+    }
+  }
+  simd::select_instruction_set(simd::detected_instruction_set());
+}
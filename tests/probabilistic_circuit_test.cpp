@@ -10,6 +10,9 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 
+#include <functional>
+#include <iomanip>
+#include <limits>
 #include <random>
 #include "aitools/datasets/algorithms.h"
 #include "aitools/datasets/random.h"
@@ -20,7 +23,12 @@
 #include "aitools/probabilistic_circuits/probabilistic_circuit.h"
 #include "aitools/probabilistic_circuits/algorithms.h"
 #include "aitools/probabilistic_circuits/io.h"
+#include "aitools/probabilistic_circuits/evaluation_plan.h"
 #include "aitools/probabilistic_circuits/generative_forest.h"
+#include "aitools/probabilistic_circuits/incremental_evaluation.h"
+#include "aitools/probabilistic_circuits/layered_circuit.h"
+#include "aitools/probabilistic_circuits/node_factory.h"
+#include "aitools/probabilistic_circuits/parameter_learning.h"
 #include "aitools/random_forests/learning.h"
 #include "aitools/utilities/print.h"
 #include "aitools/utilities/string_utility.h"
@@ -55,7 +63,8 @@ TEST_CASE("test_decision_tree_to_pc")
   std::cout << tree;
   random_forest forest;
   forest.trees().push_back(tree);
-  probabilistic_circuit pc = build_generative_forest(forest, D);
+  bool hash_consing = false;
+  probabilistic_circuit pc = build_generative_forest(forest, D, hash_consing);
   save_probabilistic_circuit(std::cout, pc);
   std::size_t pc_size = probabilistic_circuit_size(pc);
   std::size_t expected = expected_pc_size(forest, m);
@@ -301,6 +310,63 @@ sum: 0 [21 22] [0.2 0.8]
   std::cout << "example 11 " << e1 << " " << e2 << std::endl;
 }
 
+TEST_CASE("test_log_evi")
+{
+  using namespace aitools;
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 6
+category_counts: 0 0 3
+normal: 1 [] 0 -1 2
+truncated_normal: 2 [] 1 0.5 1.5 -1 3
+categorical: 3 [] 2 [0.2 0 0.8]
+product: 4 [1 2 3]
+normal: 5 [] 0 4 0.5
+sum: 0 [4 5] [0.3 0.7]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+  std::vector<pc_node_ptr> order = topological_ordering(pc);
+
+  std::vector<std::vector<double>> X = {
+    {0.1, 0.2, 0},
+    {-1.5, 2.9, 2},
+    {3.8, -0.5, 0},
+    {-1, 1, 1},      // categorical probability 0
+    {0.5, 3.5, 2},   // outside of the truncation interval
+    {NAN, 0.5, NAN}
+  };
+  for (const auto& x: X)
+  {
+    double expected = std::log(evi_query_recursive(pc, x));
+    double e1 = pc.root()->log_evi(x);
+    double e2 = log_evi_query_iterative(pc, x, order);
+    if (std::isinf(expected))
+    {
+      CHECK(std::isinf(e1));
+      CHECK(std::isinf(e2));
+    }
+    else
+    {
+      CHECK_LT(std::abs(e1 - expected), 1e-10);
+      CHECK_LT(std::abs(e2 - expected), 1e-10);
+    }
+  }
+
+  // far away from the mean the density underflows, but the log density does not
+  normal_node u(0, 0, 1);
+  std::vector<double> x = {100};
+  CHECK_EQ(u.evi(x), 0);
+  CHECK_LT(std::abs(u.log_evi(x) - (-0.5 * std::log(2 * pi) - 5000)), 1e-8);
+
+  // an interval in the upper tail
+  truncated_normal_node v(0, 0, 1, 8, 10);
+  std::vector<double> y = {8.5};
+  CHECK(std::isfinite(v.log_evi(y)));
+  CHECK_LT(std::abs(v.log_evi(y) - std::log(v.evi(y))), 1e-8);
+  CHECK(std::isinf(v.log_evi(x)));
+}
+
 inline
 void test_sampling(const aitools::probabilistic_circuit& pc, std::size_t j, double mu_expected, double sigma_expected, std::size_t n = 100000)
 {
@@ -373,6 +439,55 @@ sum: 0 [1 2] [0.25 0.75]
   test_sampling(pc, 0, mu, sigma, 500000);
 }
 
+TEST_CASE("test_sample_parallel")
+{
+  using namespace aitools;
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 5
+category_counts: 0 3
+normal: 1 [] 0 0 1
+categorical: 2 [] 1 [0.2 0.3 0.5]
+product: 3 [1 2]
+normal: 4 [] 0 1 2
+sum: 0 [3 4] [0.25 0.75]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+  std::size_t n = 10000;
+  std::size_t block_size = 128;
+  dataset D1 = sample_pc_parallel(pc, n, 42, 1, block_size);
+  dataset D2 = sample_pc_parallel(pc, n, 42, 4, block_size);
+  dataset D3 = sample_pc_parallel(pc, n, 43, 4, block_size);
+  CHECK_EQ(D1.X().row_count(), n);
+  CHECK(D1.X() == D2.X());
+  CHECK(D1.X() != D3.X());
+
+  auto [mu, sigma] = mean_standard_deviation_mixture(0.25, 0, 1, 0.75, 1, 2);
+  dataset D = sample_pc_parallel(pc, 500000, 42);
+  auto [mu1, sigma1] = mean_standard_deviation(D, xrange(500000), 0);
+  CHECK_LT(std::abs(mu - mu1), 0.01);
+  CHECK_LT(std::abs(sigma - sigma1), 0.01);
+
+  // an error in one of the tasks is reported to the caller
+  std::string less_text = R"(
+probabilistic_circuit: 1.0
+pc_size: 3
+category_counts: 0
+less: 1 [] 0 0.5
+normal: 2 [] 0 0 1
+product: 0 [1 2]
+  )";
+  probabilistic_circuit pc1 = parse_probabilistic_circuit(less_text);
+  CHECK_THROWS(sample_pc_parallel(pc1, 1000, 42, 4, 16));
+
+  // a block size of 0 is treated as 1, and no samples give an empty dataset
+  CHECK(sample_pc_parallel(pc, 10, 42, 4, 0).X() == sample_pc_parallel(pc, 10, 42, 1, 1).X());
+  CHECK_EQ(sample_pc_parallel(pc, 0, 42, 4, 0).X().row_count(), 0);
+  std::mt19937 rng{42};
+  CHECK_EQ(sample_pc(pc, 0, rng).X().row_count(), 0);
+}
+
 TEST_CASE("test_pc_properties")
 {
   using namespace aitools;
@@ -445,6 +560,992 @@ sum: 0 [21 22] [0.2 0.8]
   CHECK(!is_normalized(pc));
 }
 
+TEST_CASE("test_scope_analysis")
+{
+  using namespace aitools;
+
+  // A circuit with 2^60 paths from the root to the leaf
+  auto leaf = std::make_shared<normal_node>(0, 0, 1);
+  pc_node_ptr u = leaf;
+  for (std::size_t k = 0; k < 60; k++)
+  {
+    auto v = std::make_shared<sum_node>(std::vector<double>{0.5, 0.5});
+    v->successors() = {u, u};
+    u = v;
+  }
+  probabilistic_circuit pc(u, {0});
+  scope_analysis scopes(pc);
+  CHECK_EQ(scopes.nodes().size(), 61);
+  CHECK_EQ(scopes.scope(pc.root()).count(), 1);
+  CHECK(is_smooth(scopes));
+  CHECK(is_decomposable(scopes));
+  CHECK(!is_deterministic(pc, scopes));
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 8
+category_counts: 3 0
+categorical: 1 [] 0 [0.5 0.5 0]
+categorical: 2 [] 0 [0 0 1]
+truncated_normal: 3 [] 1 0 1 -1 1
+truncated_normal: 4 [] 1 0 1 -1 1
+product: 5 [1 3]
+product: 6 [2 4]
+sum: 7 [5 6] [0.3 0.7]
+sum: 0 [7] [1]
+  )";
+  pc = parse_probabilistic_circuit(text);
+  CHECK(is_smooth(pc));
+  CHECK(is_decomposable(pc));
+  CHECK(is_deterministic(pc));
+
+  text = R"(
+probabilistic_circuit: 1.0
+pc_size: 3
+category_counts: 0
+truncated_normal: 1 [] 0 0 1 -1 0.5
+truncated_normal: 2 [] 0 0 1 0.4 1
+sum: 0 [1 2] [0.3 0.7]
+  )";
+  pc = parse_probabilistic_circuit(text);
+  CHECK(!is_deterministic(pc));
+
+  // A generative forest with a single tree is deterministic, also after expanding the sum-split nodes
+  std::size_t n = 50;
+  std::size_t m = 3;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.max_features = m;
+  binary_decision_tree tree = learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished);
+  random_forest forest;
+  forest.trees().push_back(tree);
+  pc = build_generative_forest(forest, D);
+  CHECK(is_deterministic(pc));
+  expand_sum_split_nodes(pc);
+  CHECK(is_smooth(pc));
+  CHECK(is_deterministic(pc));
+}
+
+TEST_CASE("test_hash_consing")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  pc_node_factory factory;
+  auto u1 = factory.make_categorical(2, {0.25, 0.75});
+  auto u2 = factory.make_categorical(2, {0.25, 0.75});
+  auto u3 = factory.make_categorical(1, {0.25, 0.75});
+  auto u4 = factory.make_less(1, 2.5);
+  auto u5 = factory.make_greater_equal(1, 2.5);
+  auto u6 = factory.make_less(1, 2.5);
+  CHECK_EQ(u1, u2);
+  CHECK_NE(u1, u3);
+  CHECK_NE(u4, u5);
+  CHECK_EQ(u4, u6);
+  CHECK_EQ(factory.size(), 4);
+  CHECK_EQ(factory.request_count(), 6);
+
+  // The threshold value of an indicator node must not be truncated
+  CHECK_EQ(u4->evi({0, 2.25, 0}), 1);
+  CHECK_EQ(u5->evi({0, 2.25, 0}), 0);
+
+  // A forest that contains the same tree twice shares all leaves of the second tree with the first one
+  std::size_t n = 40;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5; // avoid normal leaves with standard deviation 0
+  options.max_features = m;
+  binary_decision_tree tree = learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished);
+  random_forest forest;
+  forest.trees().push_back(tree);
+  forest.trees().push_back(tree);
+
+  probabilistic_circuit pc1 = build_generative_forest(forest, D, false);
+  probabilistic_circuit pc2 = build_generative_forest(forest, D, true);
+  CHECK_EQ(probabilistic_circuit_size(pc1), expected_pc_size(forest, m));
+  CHECK_LE(probabilistic_circuit_size(pc2) + (m + 1) * leaf_count(tree), probabilistic_circuit_size(pc1));
+
+  expand_sum_split_nodes(pc1, false);
+  expand_sum_split_nodes(pc2, true);
+  CHECK_LT(probabilistic_circuit_size(pc2), probabilistic_circuit_size(pc1));
+  CHECK(is_valid(pc2));
+  CHECK(is_smooth(pc2));
+
+  // The shared circuit survives a save/load round trip
+  std::ostringstream out;
+  save_probabilistic_circuit(out, pc2);
+  probabilistic_circuit pc3 = parse_probabilistic_circuit(out.str());
+  CHECK_EQ(probabilistic_circuit_size(pc3), probabilistic_circuit_size(pc2));
+
+  const auto& X = D.X();
+  for (std::size_t i = 0; i < n; i++)
+  {
+    double p1 = evi_query_recursive(pc1, X[i]);
+    CHECK_LE(std::abs(evi_query_recursive(pc2, X[i]) - p1), 1e-12 * p1);
+    CHECK_LE(std::abs(evi_query_iterative(pc2, X[i]) - p1), 1e-12 * p1);
+    CHECK_LE(std::abs(evi_query_iterative(pc3, X[i]) - p1), 1e-12 * p1); // the weights are saved in shortest round-trip form
+  }
+
+  // The parallel construction gives the same result as the sequential one
+  for (std::size_t t = 0; t < 6; t++)
+  {
+    forest.trees().push_back(learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished));
+  }
+  for (bool hash_consing: {false, true})
+  {
+    std::ostringstream out1;
+    std::ostringstream out2;
+    save_probabilistic_circuit(out1, build_generative_forest(forest, D, hash_consing, true));
+    save_probabilistic_circuit(out2, build_generative_forest(forest, D, hash_consing, false));
+    CHECK_EQ(out1.str(), out2.str());
+  }
+}
+
+TEST_CASE("test_build_and_save_generative_forest")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::size_t n = 40;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  random_forest forest;
+  for (std::size_t t = 0; t < 4; t++)
+  {
+    forest.trees().push_back(learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished));
+  }
+  forest.trees().push_back(forest.trees().front());
+
+  for (bool hash_consing: {false, true})
+  {
+    probabilistic_circuit pc1 = build_generative_forest(forest, D, hash_consing);
+    std::ostringstream out1;
+    save_probabilistic_circuit(out1, pc1);
+
+    std::stringstream out2;
+    std::size_t size = build_and_save_generative_forest(out2, forest, D, hash_consing);
+    CHECK_EQ(size, probabilistic_circuit_size(pc1));
+
+    // The nodes are numbered differently, so the files are compared after a round trip
+    std::ostringstream out3;
+    std::ostringstream out4;
+    save_probabilistic_circuit(out3, parse_probabilistic_circuit(out1.str()));
+    save_probabilistic_circuit(out4, parse_probabilistic_circuit(out2.str()));
+    CHECK_EQ(out3.str(), out4.str());
+  }
+}
+
+TEST_CASE("test_parse_probabilistic_circuit")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  // all node types, with trailing spaces and a padded pc_size as written by build_and_save_generative_forest
+  std::string text =
+    "probabilistic_circuit: 1.0\n"
+    "pc_size: 14              \n"
+    "category_counts: 3 0\n"
+    "categorical: 1 [] 0 [0.2 0.3 0.5]\n"
+    "normal: 2 [] 1 2 1  \n"
+    "truncated_normal: 3 [] 1 1 2 -1.79769e+308 4\n"
+    "less: 4 [] 1 2.5\n"
+    "greater_equal: 5 [] 1 -inf\n"
+    "equal: 6 [] 0 1\n"
+    "not_equal: 7 [] 0 1\n"
+    "subset: 8 [] 0 011\n"
+    "product: 9 [1 3 4 5 8]\n"
+    "product: 11 [2 6]\n"
+    "product: 12 [2 7]\n"
+    "sum_split: 10 [9 11] [0.25 0.75] ThresholdSplit(1, 2.5)\n"
+    "sum: 13 [11 12] [0.5 0.5]\n"
+    "sum: 0 [10 13] [0.5 0.5]\n";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+  CHECK_EQ(probabilistic_circuit_size(pc), 14);
+  CHECK_EQ(pc.category_counts(), (std::vector<unsigned int>{3, 0}));
+  std::vector<double> x = {1, 1.5};
+  double p9 = 0.3 * truncated_normal_distribution(1, 2, truncated_normal_distribution::min, 4).pdf(1.5);
+  double p11 = normal_distribution(2, 1).pdf(1.5);
+  double p = 0.5 * 0.25 * p9 + 0.5 * 0.5 * p11;
+  CHECK_LE(std::abs(evi_query_recursive(pc, x) - p), 1e-12);
+
+  // a save/load round trip gives the same file
+  std::ostringstream out1;
+  std::ostringstream out2;
+  save_probabilistic_circuit(out1, pc);
+  save_probabilistic_circuit(out2, parse_probabilistic_circuit(out1.str()));
+  CHECK_EQ(out1.str(), out2.str());
+
+  // malformed lines
+  CHECK_THROWS(parse_probabilistic_circuit("pc_size: 2\nnormal: 1 [] 0 0 1\nsum: 0 [1] [1] x\n"));
+  CHECK_THROWS(parse_probabilistic_circuit("pc_size: 2\nnormal: 1 [] 0 zero 1\nsum: 0 [1] [1]\n"));
+  CHECK_THROWS(parse_probabilistic_circuit("pc_size: 2\nnormal: 1 [] 0 0 1\nproduct: 0 [1 2\n"));
+  CHECK_THROWS(parse_probabilistic_circuit("pc_size: 3\nnormal: 2 [] 0 0 1\nsum: 0 [1 2] [0.5 0.5]\n"));
+}
+
+TEST_CASE("test_simplify")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 0
+categorical: 7 [] 0 [0.2 0.3 0.5]
+normal: 8 [] 1 2 1
+subset: 9 [] 0 00000000000000000000000000000111
+normal: 10 [] 1 5 2
+greater_equal: 11 [] 1 -inf
+product: 5 [7 9]
+product: 4 [5 8]
+product: 6 [10 11]
+sum: 3 [4 6] [1 0]
+sum: 2 [3] [1]
+sum: 1 [2 4] [0.5 0.5]
+sum: 0 [1] [1]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+  probabilistic_circuit pc1 = parse_probabilistic_circuit(text);
+  CHECK_EQ(probabilistic_circuit_size(pc), 12);
+  simplify(pc);
+  // Only nodes 1, 4, 7 and 8 remain. The shared product node 4 is kept, and node 5 collapses to node 7, since its
+  // subset indicator is trivially one.
+  CHECK_EQ(probabilistic_circuit_size(pc), 4);
+  CHECK(is_valid(pc));
+  for (double x0: {0.0, 1.0, 2.0})
+  {
+    for (double x1: {-1.0, 2.5, 4.0})
+    {
+      std::vector<double> x = {x0, x1};
+      CHECK_LE(std::abs(evi_query_recursive(pc, x) - evi_query_recursive(pc1, x)), 1e-12);
+    }
+  }
+
+  auto check_simplify = [](const std::string& text, std::size_t expected_size, const std::vector<std::vector<double>>& X)
+  {
+    probabilistic_circuit pc = parse_probabilistic_circuit(text);
+    probabilistic_circuit pc1 = parse_probabilistic_circuit(text);
+    simplify(pc);
+    CHECK_EQ(probabilistic_circuit_size(pc), expected_size);
+    CHECK(is_valid(pc));
+    for (const auto& x: X)
+    {
+      CHECK_LE(std::abs(evi_query_recursive(pc, x) - evi_query_recursive(pc1, x)), 1e-12);
+    }
+    return pc;
+  };
+
+  // Pruning the edge to node 4 leaves the root as the only parent of node 3, so node 3 is merged into the root.
+  std::string text_pruned = R"(
+probabilistic_circuit: 1.0
+pc_size: 6
+category_counts: 0
+normal: 1 [] 0 0 1
+normal: 2 [] 0 1 1
+normal: 7 [] 0 2 1
+sum: 3 [1 2] [0.4 0.6]
+sum: 4 [3 1] [0.5 0.5]
+sum: 0 [3 4 7] [0.5 0 0.5]
+  )";
+  check_simplify(text_pruned, 4, {{-1.0}, {0.5}, {3.0}});
+
+  // Node 3 is identically 0, so it is pruned instead of being merged into the root.
+  std::string text_zero = R"(
+probabilistic_circuit: 1.0
+pc_size: 5
+category_counts: 0
+normal: 1 [] 0 0 1
+normal: 2 [] 0 1 1
+normal: 7 [] 0 2 1
+sum: 3 [1 2] [0 0]
+sum: 0 [3 7] [0.5 0.5]
+  )";
+  probabilistic_circuit pc_zero = check_simplify(text_zero, 2, {{-1.0}, {0.5}, {3.0}});
+  const auto& root_weights = static_cast<const sum_node&>(*pc_zero.root()).weights();
+  CHECK(std::all_of(root_weights.begin(), root_weights.end(), [](double w) { return w != 0; }));
+
+  // An indicator x < inf is 0 for x = inf, so it is not removed.
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+  std::string text_less = R"(
+probabilistic_circuit: 1.0
+pc_size: 3
+category_counts: 0 0
+normal: 1 [] 0 0 1
+less: 2 [] 1 inf
+product: 0 [1 2]
+  )";
+  check_simplify(text_less, 3, {{0.5, 1.0}, {0.5, infinity}, {0.5, -infinity}});
+
+  // Simplification of an expanded generative forest
+  std::size_t n = 40;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  binary_decision_tree tree = learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished);
+  random_forest forest;
+  forest.trees().push_back(tree);
+  probabilistic_circuit gef = build_generative_forest(forest, D);
+  expand_sum_split_nodes(gef);
+  probabilistic_circuit gef1 = build_generative_forest(forest, D);
+  expand_sum_split_nodes(gef1);
+  simplify(gef1);
+  if (leaf_count(tree) > 1)
+  {
+    CHECK_LT(probabilistic_circuit_size(gef1), probabilistic_circuit_size(gef));
+  }
+  CHECK(is_smooth(gef1));
+  CHECK(is_decomposable(gef1) == is_decomposable(gef));
+  const auto& X = D.X();
+  for (std::size_t i = 0; i < n; i++)
+  {
+    double p = evi_query_recursive(gef, X[i]);
+    CHECK_LE(std::abs(evi_query_recursive(gef1, X[i]) - p), 1e-12 * p);
+    CHECK_LE(std::abs(evi_query_iterative(gef1, X[i]) - p), 1e-12 * p);
+  }
+}
+
+TEST_CASE("test_incremental_evaluation")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::size_t n = 40;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  random_forest forest;
+  for (std::size_t k = 0; k < 3; k++)
+  {
+    forest.trees().push_back(learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished));
+  }
+
+  auto check_incremental_evaluation = [&](const probabilistic_circuit& pc)
+  {
+    std::size_t N = probabilistic_circuit_size(pc);
+    incremental_evaluator evaluator(pc);
+    const auto& X = D.X();
+    std::vector<double> x = X[0];
+    std::mt19937 rng{12345};
+    for (std::size_t k = 0; k < 50; k++)
+    {
+      // change a single variable, sometimes into a missing value
+      std::size_t i = random_integer<std::size_t>(0, n - 1, rng);
+      std::size_t j = random_integer<std::size_t>(0, m, rng);
+      x[j] = (k % 10 == 9) ? std::numeric_limits<double>::quiet_NaN() : X[i][j];
+      double p = evi_query_recursive(pc, x);
+      CHECK_LE(std::abs(evaluator.evi(x) - p), 1e-12 * p);
+      if (k > 0 && (k - 1) % 7 != 0) // the previous query was an EVI query, so only the affected nodes are updated
+      {
+        CHECK_LT(evaluator.update_count(), N);
+      }
+      if (k % 7 == 0)
+      {
+        // switching to log space recomputes all nodes
+        double log_p = pc.root()->log_evi(x);
+        double log_q = evaluator.log_evi(x);
+        CHECK_EQ(evaluator.update_count(), N);
+        CHECK((log_q == log_p || std::abs(log_q - log_p) <= 1e-10 * std::abs(log_p)));
+      }
+    }
+
+    // an unchanged query recomputes nothing
+    double p = evaluator.evi(x);
+    CHECK_EQ(evaluator.evi(x), p);
+    CHECK_EQ(evaluator.update_count(), 0);
+  };
+
+  probabilistic_circuit gef = build_generative_forest(forest, D);
+  check_incremental_evaluation(gef);
+  expand_sum_split_nodes(gef);
+  check_incremental_evaluation(gef);
+}
+
+TEST_CASE("test_forward_backward")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  // A smooth and decomposable circuit with categorical variables 0 and 1, and a continuous variable 2
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 2 0
+categorical: 11 [] 1 [0.9 0.1]
+categorical: 10 [] 1 [0.2 0.8]
+normal: 9 [] 2 1 2
+categorical: 8 [] 0 [0.1 0.1 0.8]
+normal: 7 [] 2 -1 1
+categorical: 6 [] 1 [0.5 0.5]
+categorical: 5 [] 0 [0.6 0.3 0.1]
+sum: 4 [10 11] [0.4 0.6]
+product: 3 [8 4 9]
+product: 2 [5 6 7]
+sum: 1 [2 3] [0.3 0.7]
+product: 0 [1]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+  CHECK(is_smooth(pc));
+  CHECK(is_decomposable(pc));
+
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<std::vector<double>> rows = {
+    {0, 1, 0.5}, {2, 0, -1.5}, {1, 1, 3}, {nan, 0, 0}, {2, nan, 1}, {0, 1, nan}, {nan, nan, 2}
+  };
+  dataset D(numerics::matrix<double>(rows), pc.category_counts());
+  std::size_t n = rows.size();
+
+  // Batched log-likelihoods, with a batch size that does not divide n
+  std::vector<double> log_p = log_evi_batch(pc, D, 3);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    CHECK_LE(std::abs(log_p[i] - pc.root()->log_evi(rows[i])), 1e-12);
+  }
+
+  // Conditional marginals of the categorical variables
+  std::vector<numerics::matrix<double>> marginals = conditional_marginals(pc, D, 4);
+  CHECK_EQ(marginals[2].row_count(), 0);
+  for (std::size_t j: {0, 1})
+  {
+    std::size_t K = pc.category_counts()[j];
+    for (std::size_t i = 0; i < n; i++)
+    {
+      std::vector<double> x = rows[i];
+      std::vector<double> expected;
+      for (std::size_t k = 0; k < K; k++)
+      {
+        x[j] = static_cast<double>(k);
+        expected.push_back(pc.root()->evi(x));
+      }
+      double total = std::accumulate(expected.begin(), expected.end(), 0.0);
+      for (std::size_t k = 0; k < K; k++)
+      {
+        CHECK_LE(std::abs(marginals[j][i][k] - expected[k] / total), 1e-12);
+      }
+    }
+  }
+
+  // Weight gradients and edge flows of the sum node 1
+  evaluation_plan plan(pc);
+  forward_backward_pass pass(plan, n);
+  pass.forward(D.X(), 0, n);
+  pass.backward();
+  std::vector<double> gradients(plan.edge_count(), 0.0);
+  std::vector<double> edge_flows(plan.edge_count(), 0.0);
+  pass.accumulate_weight_gradients(gradients);
+  pass.accumulate_edge_flows(edge_flows);
+  std::size_t u = plan.successor(plan.first_edge(plan.root()));
+  CHECK(plan.kind(u) == evaluation_plan::node_kind::sum);
+  const auto& sum_u = static_cast<const sum_node&>(plan.node(u));
+  double total_flow = 0;
+  for (std::size_t e = plan.first_edge(u); e < plan.last_edge(u); e++)
+  {
+    std::size_t k = e - plan.first_edge(u);
+    const auto& v = plan.node(plan.successor(e));
+    double expected = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      expected += v.evi(rows[i]) / pc.root()->evi(rows[i]);
+    }
+    CHECK_LE(std::abs(gradients[e] - expected), 1e-10);
+    CHECK_LE(std::abs(edge_flows[e] - sum_u.weights()[k] * expected), 1e-10);
+    total_flow += edge_flows[e];
+  }
+  CHECK_LE(std::abs(total_flow - n), 1e-10);
+
+  // Generative forests, with and without sum-split nodes
+  std::size_t n1 = 40;
+  std::size_t m = 4;
+  dataset D1 = make_random_dataset(n1, m);
+  std::vector<std::uint32_t> I(n1);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  random_forest forest;
+  forest.trees().push_back(learn_decision_tree(D1, I, options, threshold_plus_single_split_family(D1, options), gain(options.imp_measure), node_is_finished));
+  probabilistic_circuit gef = build_generative_forest(forest, D1);
+  for (std::size_t k = 0; k < 2; k++)
+  {
+    std::vector<double> log_p1 = log_evi_batch(gef, D1, 16);
+    for (std::size_t i = 0; i < n1; i++)
+    {
+      double expected = gef.root()->log_evi(D1.X()[i]);
+      CHECK_LE(std::abs(log_p1[i] - expected), 1e-10 * std::abs(expected));
+    }
+    expand_sum_split_nodes(gef);
+  }
+}
+
+TEST_CASE("test_learn_parameters_em")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 2 0
+categorical: 11 [] 1 [0.9 0.1]
+categorical: 10 [] 1 [0.2 0.8]
+normal: 9 [] 2 1 2
+categorical: 8 [] 0 [0.1 0.1 0.8]
+normal: 7 [] 2 -1 1
+categorical: 6 [] 1 [0.5 0.5]
+categorical: 5 [] 0 [0.6 0.3 0.1]
+sum: 4 [10 11] [0.4 0.6]
+product: 3 [8 4 9]
+product: 2 [5 6 7]
+sum: 1 [2 3] [0.3 0.7]
+product: 0 [1]
+  )";
+
+  // The same structure with different parameters
+  std::string initial_text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 2 0
+categorical: 11 [] 1 [0.5 0.5]
+categorical: 10 [] 1 [0.6 0.4]
+normal: 9 [] 2 0 1
+categorical: 8 [] 0 [0.3 0.3 0.4]
+normal: 7 [] 2 0.5 3
+categorical: 6 [] 1 [0.4 0.6]
+categorical: 5 [] 0 [0.3 0.4 0.3]
+sum: 4 [10 11] [0.5 0.5]
+product: 3 [8 4 9]
+product: 2 [5 6 7]
+sum: 1 [2 3] [0.5 0.5]
+product: 0 [1]
+  )";
+
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+  dataset D = sample_pc_parallel(pc, 500, 12345, 1);
+  D.X()[3][0] = std::numeric_limits<double>::quiet_NaN();
+  D.X()[7][2] = std::numeric_limits<double>::quiet_NaN();
+
+  auto learn = [&](std::size_t thread_count)
+  {
+    probabilistic_circuit pc1 = parse_probabilistic_circuit(initial_text);
+    em_options options;
+    options.iterations = 20;
+    options.batch_size = 16;
+    options.thread_count = thread_count;
+    std::vector<double> log_likelihoods = learn_parameters_em(pc1, D, options);
+    CHECK_EQ(log_likelihoods.size(), options.iterations);
+    for (std::size_t i = 1; i < log_likelihoods.size(); i++)
+    {
+      CHECK_LE(log_likelihoods[i - 1], log_likelihoods[i] + 1e-10);
+    }
+    CHECK(is_normalized(pc1));
+    return std::make_pair(pc1, log_likelihoods);
+  };
+
+  auto [pc1, log_likelihoods1] = learn(3);
+  auto [pc2, log_likelihoods2] = learn(3);
+  auto [pc3, log_likelihoods3] = learn(1);
+  CHECK_EQ(log_likelihoods1, log_likelihoods2);
+  for (std::size_t i = 0; i < log_likelihoods1.size(); i++)
+  {
+    CHECK_LE(std::abs(log_likelihoods1[i] - log_likelihoods3[i]), 1e-10);
+  }
+  CHECK(log_likelihoods1.back() > log_likelihoods1.front());
+}
+
+TEST_CASE("test_mpe")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 2 0
+categorical: 11 [] 1 [0.9 0.1]
+categorical: 10 [] 1 [0.2 0.8]
+normal: 9 [] 2 1 2
+categorical: 8 [] 0 [0.1 0.1 0.8]
+normal: 7 [] 2 -1 1
+categorical: 6 [] 1 [0.5 0.5]
+categorical: 5 [] 0 [0.6 0.3 0.1]
+sum: 4 [10 11] [0.4 0.6]
+product: 3 [8 4 9]
+product: 2 [5 6 7]
+sum: 1 [2 3] [0.3 0.7]
+product: 0 [1]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<std::vector<double>> rows = {
+    {0, 1, 0.5}, {nan, 0, -1.5}, {1, nan, 3}, {nan, nan, 0}, {2, 1, nan}, {nan, nan, nan}
+  };
+  dataset D(numerics::matrix<double>(rows), pc.category_counts());
+  std::size_t n = rows.size();
+
+  // A recursive max-product evaluation, used as a reference
+  std::function<double(const pc_node&, const std::vector<double>&)> max_product = [&](const pc_node& u, const std::vector<double>& x)
+  {
+    if (auto u_ = dynamic_cast<const sum_node*>(&u); u_)
+    {
+      double result = -std::numeric_limits<double>::infinity();
+      for (std::size_t k = 0; k < u_->successors().size(); k++)
+      {
+        result = std::max(result, std::log(u_->weights()[k]) + max_product(*u_->successors()[k], x));
+      }
+      return result;
+    }
+    else if (auto u_ = dynamic_cast<const product_node*>(&u); u_)
+    {
+      double result = 0;
+      for (const auto& v: u_->successors())
+      {
+        result += max_product(*v, x);
+      }
+      return result;
+    }
+    const auto& u_ = dynamic_cast<const terminal_node&>(u);
+    std::vector<double> y = x;
+    if (is_missing(y[u_.scope()]))
+    {
+      y[u_.scope()] = u_.mode();
+    }
+    return u_.log_evi(y);
+  };
+
+  evaluation_plan plan(pc);
+  max_product_pass pass(plan, 4);
+  numerics::matrix<double> X = mpe_batch(pc, D, 4);
+  for (std::size_t first = 0; first < n; first += 4)
+  {
+    std::size_t last = std::min(first + 4, n);
+    pass.forward(D.X(), first, last);
+    for (std::size_t r = 0; r < pass.row_count(); r++)
+    {
+      const auto& x = rows[first + r];
+      double expected = max_product(*pc.root(), x);
+      CHECK_LE(std::abs(pass.log_value(r) - expected), 1e-12);
+
+      // The completion contains no missing values, keeps the observed values, and its likelihood is at least
+      // the max-product value
+      const auto& y = X[first + r];
+      for (std::size_t j = 0; j < x.size(); j++)
+      {
+        CHECK(!is_missing(y[j]));
+        if (!is_missing(x[j]))
+        {
+          CHECK_EQ(y[j], x[j]);
+        }
+      }
+      CHECK_LE(expected, pc.root()->log_evi(y) + 1e-12);
+    }
+  }
+
+  // With all values missing the completion consists of the modes of the best branch
+  CHECK_EQ(X[5], std::vector<double>({2, 0, 1}));
+
+  // A generative forest with missing values
+  std::size_t n1 = 40;
+  std::size_t m = 4;
+  dataset D1 = make_random_dataset(n1, m);
+  std::vector<std::uint32_t> I(n1);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  random_forest forest;
+  forest.trees().push_back(learn_decision_tree(D1, I, options, threshold_plus_single_split_family(D1, options), gain(options.imp_measure), node_is_finished));
+  probabilistic_circuit gef = build_generative_forest(forest, D1);
+  dataset D2 = D1;
+  for (std::size_t i = 0; i < n1; i++)
+  {
+    D2.X()[i][i % m] = nan;
+  }
+  numerics::matrix<double> X2 = mpe_batch(gef, D2, 16);
+  for (std::size_t i = 0; i < n1; i++)
+  {
+    for (std::size_t j = 0; j < m; j++)
+    {
+      CHECK(!is_missing(X2[i][j]));
+      if (j != i % m)
+      {
+        CHECK_EQ(X2[i][j], D1.X()[i][j]);
+      }
+    }
+  }
+}
+
+TEST_CASE("test_predict_proba")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::size_t n = 60;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  random_forest forest;
+  for (std::size_t t = 0; t < 3; t++)
+  {
+    forest.trees().push_back(learn_decision_tree(D, I, options, threshold_plus_single_split_family(D, options), gain(options.imp_measure), node_is_finished));
+  }
+  std::size_t K = D.class_count();
+
+  // The class value in the dataset is ignored
+  dataset D1 = D;
+  for (std::size_t i = 0; i < n; i += 2)
+  {
+    D1.X()[i][m] = std::numeric_limits<double>::quiet_NaN();
+  }
+
+  probabilistic_circuit gef = build_generative_forest(forest, D);
+  for (std::size_t k = 0; k < 2; k++)
+  {
+    numerics::matrix<double> P = predict_proba(gef, D1, 7);
+    CHECK_EQ(P.row_count(), n);
+    CHECK_EQ(P.column_count(), K);
+    for (std::size_t i = 0; i < n; i++)
+    {
+      std::vector<double> x = D.X()[i];
+      std::vector<double> log_p;
+      for (std::size_t c = 0; c < K; c++)
+      {
+        x[m] = static_cast<double>(c);
+        log_p.push_back(gef.root()->log_evi(x));
+      }
+      double max_value = *std::max_element(log_p.begin(), log_p.end());
+      double total = 0;
+      for (double l: log_p)
+      {
+        total += std::exp(l - max_value);
+      }
+      for (std::size_t c = 0; c < K; c++)
+      {
+        CHECK_LE(std::abs(P[i][c] - std::exp(log_p[c] - max_value) / total), 1e-10);
+      }
+    }
+    expand_sum_split_nodes(gef);
+  }
+}
+
+TEST_CASE("test_conditional_marginals_zero_probabilities")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  // the leaves of x0 give probability 0 to one of the categories
+  probabilistic_circuit pc1 = parse_probabilistic_circuit(R"(
+probabilistic_circuit: 1.0
+pc_size: 7
+category_counts: 2 2
+categorical: 6 [] 1 [0.5 0.5]
+categorical: 5 [] 0 [0 1]
+categorical: 4 [] 1 [0.5 0.5]
+categorical: 3 [] 0 [1 0]
+product: 2 [5 6]
+product: 1 [3 4]
+sum: 0 [1 2] [0.5 0.5]
+  )");
+  std::vector<std::vector<double>> rows1 = {{0, 0}, {1, 0}, {std::numeric_limits<double>::quiet_NaN(), 1}};
+  dataset D1(numerics::matrix<double>(rows1), pc1.category_counts());
+  std::vector<numerics::matrix<double>> marginals1 = conditional_marginals(pc1, D1, 2);
+  for (std::size_t i = 0; i < rows1.size(); i++)
+  {
+    CHECK_LE(std::abs(marginals1[0][i][0] - 0.5), 1e-12);
+    CHECK_LE(std::abs(marginals1[0][i][1] - 0.5), 1e-12);
+    CHECK_LE(std::abs(marginals1[1][i][0] - 0.5), 1e-12);
+  }
+
+  // p(x) = 0 for both rows, and p(x_{-1}) = 0 for the second row
+  probabilistic_circuit pc2 = parse_probabilistic_circuit(R"(
+probabilistic_circuit: 1.0
+pc_size: 3
+category_counts: 2 2
+categorical: 2 [] 1 [0.5 0.5]
+categorical: 1 [] 0 [1 0]
+product: 0 [1 2]
+  )");
+  std::vector<std::vector<double>> rows2 = {{1, 0}, {1, 1}};
+  dataset D2(numerics::matrix<double>(rows2), pc2.category_counts());
+  std::vector<numerics::matrix<double>> marginals2 = conditional_marginals(pc2, D2);
+  CHECK_EQ(marginals2[0][0], (std::vector<double>{1, 0}));
+  CHECK_EQ(marginals2[0][1], (std::vector<double>{1, 0}));
+  CHECK_EQ(marginals2[1][0], (std::vector<double>{0, 0}));
+  CHECK_EQ(marginals2[1][1], (std::vector<double>{0, 0}));
+}
+
+TEST_CASE("test_sample_conditional")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 2 0
+categorical: 11 [] 1 [0.9 0.1]
+categorical: 10 [] 1 [0.2 0.8]
+normal: 9 [] 2 1 2
+categorical: 8 [] 0 [0.1 0.1 0.8]
+normal: 7 [] 2 -1 1
+categorical: 6 [] 1 [0.5 0.5]
+categorical: 5 [] 0 [0.6 0.3 0.1]
+sum: 4 [10 11] [0.4 0.6]
+product: 3 [8 4 9]
+product: 2 [5 6 7]
+sum: 1 [2 3] [0.3 0.7]
+product: 0 [1]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> x = {nan, 1, 0.5};
+  std::size_t n = 20000;
+  dataset D(numerics::matrix<double>(std::vector<std::vector<double>>(n, x)), pc.category_counts());
+
+  dataset D1 = sample_pc_conditional(pc, D, 123, 3, 100);
+  dataset D2 = sample_pc_conditional(pc, D, 123, 1, 100);
+  CHECK_EQ(D1.X(), D2.X());
+
+  // The observed values are unchanged, and the frequencies of x_0 match p(x_0 | x_1, x_2)
+  std::vector<double> frequencies(3, 0.0);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    const auto& y = D1.X()[i];
+    CHECK_EQ(y[1], x[1]);
+    CHECK_EQ(y[2], x[2]);
+    frequencies[static_cast<std::size_t>(y[0])] += 1.0 / n;
+  }
+  std::vector<numerics::matrix<double>> marginals = conditional_marginals(pc, D, 64);
+  for (std::size_t k = 0; k < 3; k++)
+  {
+    CHECK_LE(std::abs(frequencies[k] - marginals[0][0][k]), 0.02);
+  }
+}
+
+TEST_CASE("test_layered_circuit")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::string text = R"(
+probabilistic_circuit: 1.0
+pc_size: 12
+category_counts: 3 2 0
+categorical: 11 [] 1 [0.9 0.1]
+categorical: 10 [] 1 [0.2 0.8]
+normal: 9 [] 2 1 2
+categorical: 8 [] 0 [0.1 0.1 0.8]
+normal: 7 [] 2 -1 1
+categorical: 6 [] 1 [0.5 0.5]
+categorical: 5 [] 0 [0.6 0.3 0.1]
+sum: 4 [10 11] [0.4 0.6]
+product: 3 [8 4 9]
+product: 2 [5 6 7]
+sum: 1 [2 3] [0.3 0.7]
+product: 0 [1]
+  )";
+  probabilistic_circuit pc = parse_probabilistic_circuit(text);
+
+  // The layers are: the 7 leaves, sum node 4, product 2, product 3, sum node 1 and the root
+  layered_circuit circuit(pc);
+  CHECK_EQ(circuit.size(), 12);
+  std::vector<std::size_t> widths;
+  for (const auto& l: circuit.layers())
+  {
+    widths.push_back(l.width());
+  }
+  CHECK_EQ(widths, std::vector<std::size_t>({7, 1, 1, 1, 1, 1}));
+  CHECK(circuit.layers().front().kind == layered_circuit::layer_kind::input);
+  CHECK_EQ(&circuit.node(circuit.root()), pc.root().get());
+  for (std::size_t i = 0; i < circuit.size(); i++)
+  {
+    for (std::size_t e = circuit.first_input(i); e < circuit.last_input(i); e++)
+    {
+      CHECK_LT(circuit.input(e), i);
+    }
+  }
+
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<std::vector<double>> rows = {
+    {0, 1, 0.5}, {2, 0, -1.5}, {1, 1, 3}, {nan, 0, 0}, {2, nan, 1}, {0, 1, nan}, {nan, nan, 2}
+  };
+  dataset D(numerics::matrix<double>(rows), pc.category_counts());
+  std::vector<double> log_p = log_evi_layered(pc, D, 3);
+  for (std::size_t i = 0; i < rows.size(); i++)
+  {
+    CHECK_LE(std::abs(log_p[i] - pc.root()->log_evi(rows[i])), 1e-12);
+  }
+
+  // An expanded generative forest
+  std::size_t n1 = 40;
+  std::size_t m = 4;
+  dataset D1 = make_random_dataset(n1, m);
+  std::vector<std::uint32_t> I(n1);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options options;
+  options.max_depth = 3;
+  options.min_samples_leaf = 5;
+  options.max_features = m;
+  random_forest forest;
+  forest.trees().push_back(learn_decision_tree(D1, I, options, threshold_plus_single_split_family(D1, options), gain(options.imp_measure), node_is_finished));
+  probabilistic_circuit gef = build_generative_forest(forest, D1);
+  CHECK_THROWS(layered_circuit{gef});
+  expand_sum_split_nodes(gef);
+  std::vector<double> log_p1 = log_evi_layered(gef, D1, 16);
+  for (std::size_t i = 0; i < n1; i++)
+  {
+    double expected = gef.root()->log_evi(D1.X()[i]);
+    CHECK_LE(std::abs(log_p1[i] - expected), 1e-10 * std::abs(expected));
+  }
+
+  // Parallel evaluation of the layers gives the same results, also for a single row
+  layered_circuit circuit1(gef);
+  layered_evaluator evaluator1(circuit1, 16, 2);
+  layered_evaluator evaluator2(circuit1, 16, 2);
+  for (std::size_t first = 0; first < n1; first += 16)
+  {
+    std::size_t last = std::min(first + 16, n1);
+    evaluator1.forward(D1.X(), first, last);
+    evaluator2.forward_parallel(D1.X(), first, last);
+    for (std::size_t r = 0; r < last - first; r++)
+    {
+      CHECK_EQ(evaluator1.log_likelihood(r), evaluator2.log_likelihood(r));
+    }
+  }
+  evaluator2.forward_parallel(D1.X(), 5, 6);
+  CHECK_EQ(evaluator2.log_likelihood(0), log_p1[5]);
+}
+
 //TEST_CASE("test_sample4)
 //{
 //  using namespace aitools;
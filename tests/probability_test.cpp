@@ -12,6 +12,9 @@
 
 #include <random>
 #include "aitools/numerics/math_functions.h"
+#include "aitools/statistics/alias_table.h"
+#include "aitools/statistics/distributions.h"
+#include "aitools/statistics/sampling.h"
 
 // returns a random double value: low <= value <= high
 double random_double(double low, double high)
@@ -50,3 +53,48 @@ TEST_CASE("test1")
     CHECK_LT(std::abs(tphi(x, mean, standard_deviation, a, b) - truncated_phi(x, mean, standard_deviation, a, b)), 1e-10);
   }
 }
+
+TEST_CASE("test_alias_table")
+{
+  using namespace aitools;
+
+  std::mt19937 rng{12345};
+  std::vector<std::vector<double>> weights = {
+    {1},
+    {0.2, 0.8},
+    {0.2, 0, 0.8},
+    {1, 2, 3, 4, 0, 5, 6, 7, 8, 9},
+    {0, 0, 1},
+    {0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.1}
+  };
+  std::size_t n = 200000;
+  for (const auto& w: weights)
+  {
+    alias_table table(w);
+    double total = std::accumulate(w.begin(), w.end(), 0.0);
+    std::vector<std::size_t> counts(w.size(), 0);
+    for (std::size_t i = 0; i < n; i++)
+    {
+      counts[table.sample(rng)]++;
+    }
+    for (std::size_t i = 0; i < w.size(); i++)
+    {
+      if (w[i] == 0)
+      {
+        CHECK_EQ(counts[i], 0);
+      }
+      CHECK_LT(std::abs(static_cast<double>(counts[i]) / n - w[i] / total), 0.01);
+    }
+  }
+
+  // the binary search in inverse_cdf agrees with the linear search
+  categorical_distribution dist({0.2, 0, 0.3, 0.5});
+  for (double x: {0.0, 0.1, 0.2, 0.2000001, 0.4, 0.5, 0.50001, 0.9, 1.0})
+  {
+    CHECK_EQ(dist.inverse_cdf(x), detail::find_categorical_section(dist.probabilities(), x));
+  }
+  for (std::size_t i = 0; i < 1000; i++)
+  {
+    CHECK_NE(sample(dist, rng), 1);
+  }
+}
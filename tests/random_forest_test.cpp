@@ -10,8 +10,13 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 
+#include <chrono>
 #include <set>
+#include <thread>
 #include "aitools/datasets/random.h"
+#include "aitools/decision_trees/algorithms.h"
+#include "aitools/random_forests/learning.h"
+#include "aitools/utilities/packing.h"
 #include "aitools/random_forests/random_forest.h"
 #include "aitools/random_forests/io.h"
 #include "aitools/utilities/string_utility.h"
@@ -75,4 +80,209 @@ vertex: 16 [] NoSplit() 2 3
   std::string text1 = out.str();
   std::cout << "\n" << text1 << "\n";
   CHECK(utilities::trim_copy(text) == utilities::trim_copy(text1));
-}
\ No newline at end of file
+}
+
+TEST_CASE("test_parse_random_forest")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::size_t n = 50;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options tree_options;
+  tree_options.max_depth = 4;
+  tree_options.max_features = m;
+  random_forest_options forest_options;
+  forest_options.forest_size = 6;
+  random_forest forest = learn_random_forest(D, I, forest_options, tree_options, threshold_plus_single_split_family(D, tree_options),
+                                             gain1(tree_options.imp_measure), node_is_finished, true);
+  std::ostringstream out;
+  out << forest;
+  std::string text = out.str();
+
+  // the trees are parsed in parallel
+  random_forest forest1 = parse_random_forest(text);
+  CHECK_EQ(forest1.trees().size(), forest.trees().size());
+  std::ostringstream out1;
+  out1 << forest1;
+  CHECK_EQ(out1.str(), text);
+
+  // the line based parser gives the same result
+  random_forest_parser parser;
+  for (const std::string& line: utilities::split_lines(text))
+  {
+    parser.parse_line(line);
+  }
+  std::ostringstream out2;
+  out2 << parser.get_result();
+  CHECK_EQ(out2.str(), text);
+
+  splitting_criterion split;
+  std::string split_text = "SubsetSplit(2, 0101) 3 4";
+  const char* last = parse_splitting_criterion(split_text.data(), split_text.data() + split_text.size(), split);
+  CHECK_EQ(std::string(last), std::string(" 3 4"));
+  CHECK(split == splitting_criterion(subset_split(2, 5)));
+}
+
+TEST_CASE("test_packed_indices")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::vector<std::uint32_t> v = {0, 7, 3, 4294967295u, 0, 128, 127, 16384, 5};
+  std::vector<std::uint8_t> bytes;
+  utilities::pack_deltas(v.data(), v.data() + v.size(), bytes);
+  std::string text;
+  utilities::append_base64(text, bytes.data(), bytes.data() + bytes.size());
+  std::vector<std::uint8_t> bytes1;
+  utilities::parse_base64(text.data(), text.data() + text.size(), bytes1);
+  CHECK_EQ(bytes1, bytes);
+  std::vector<std::uint32_t> v1(v.size());
+  utilities::unpack_deltas(bytes1.data(), bytes1.data() + bytes1.size(), v1.size(), v1.data());
+  CHECK_EQ(v1, v);
+
+  // multiple blocks, and a truncated sequence
+  std::vector<std::uint32_t> w(300);
+  for (std::size_t i = 0; i < w.size(); i++)
+  {
+    w[i] = static_cast<std::uint32_t>((i * 7919) % 1000 + (i / 128) * 100000);
+  }
+  bytes.clear();
+  utilities::pack_deltas(w.data(), w.data() + w.size(), bytes);
+  std::vector<std::uint32_t> w1(w.size());
+  CHECK_EQ(utilities::unpack_deltas(bytes.data(), bytes.data() + bytes.size(), w1.size(), w1.data()), bytes.data() + bytes.size());
+  CHECK_EQ(w1, w);
+  CHECK_THROWS(utilities::unpack_deltas(bytes.data(), bytes.data() + bytes.size() - 1, w1.size(), w1.data()));
+
+  std::vector<std::uint32_t> classes = {0, 2, 1, 2, 0, 0, 1};
+  unsigned int bits = utilities::packed_bit_count(classes.data(), classes.data() + classes.size());
+  CHECK_EQ(bits, 2);
+  bytes.clear();
+  utilities::pack_bits(classes.data(), classes.data() + classes.size(), bits, bytes);
+  CHECK_EQ(bytes.size(), 2);
+  std::vector<std::uint32_t> classes1(classes.size());
+  utilities::unpack_bits(bytes.data(), bytes.data() + bytes.size(), classes1.size(), bits, classes1.data());
+  CHECK_EQ(classes1, classes);
+
+  std::size_t n = 200;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options tree_options;
+  tree_options.max_depth = 4;
+  tree_options.max_features = m;
+  random_forest_options forest_options;
+  forest_options.forest_size = 3;
+  random_forest forest = learn_random_forest(D, I, forest_options, tree_options, threshold_plus_single_split_family(D, tree_options),
+                                             gain1(tree_options.imp_measure), node_is_finished, true);
+  std::ostringstream out;
+  save_random_forest(out, forest, true);
+  random_forest forest1 = parse_random_forest(out.str());
+  std::ostringstream out1;
+  save_random_forest(out1, forest1, true);
+  CHECK_EQ(out1.str(), out.str());
+
+  // the vertices contain the same indices, and the indices of the leaves are sorted
+  for (std::size_t k = 0; k < forest.trees().size(); k++)
+  {
+    const auto& tree = forest.trees()[k];
+    const auto& tree1 = forest1.trees()[k];
+    CHECK_EQ(tree1.classes(), tree.classes());
+    CHECK_EQ(tree1.vertices().size(), tree.vertices().size());
+    for (std::size_t i = 0; i < tree.vertices().size(); i++)
+    {
+      const auto& u = tree.find_vertex(i);
+      const auto& u1 = tree1.find_vertex(i);
+      std::vector<std::uint32_t> J(u.I.begin(), u.I.end());
+      std::vector<std::uint32_t> J1(u1.I.begin(), u1.I.end());
+      if (u1.is_leaf())
+      {
+        CHECK(std::is_sorted(J1.begin(), J1.end()));
+      }
+      std::sort(J.begin(), J.end());
+      std::sort(J1.begin(), J1.end());
+      CHECK_EQ(J1, J);
+    }
+  }
+}
+
+TEST_CASE("test_random_forest_writer")
+{
+  using namespace aitools;
+  log::aitools_logger::set_reporting_level(log::quiet);
+
+  std::size_t n = 100;
+  std::size_t m = 4;
+  dataset D = make_random_dataset(n, m);
+  std::vector<std::uint32_t> I(n);
+  std::iota(I.begin(), I.end(), 0);
+  decision_tree_options tree_options;
+  tree_options.max_depth = 4;
+  tree_options.max_features = m;
+  random_forest_options forest_options;
+  forest_options.forest_size = 5;
+  std::size_t seed = 123;
+  random_forest forest = learn_random_forest(D, I, forest_options, tree_options, threshold_split_family(D, tree_options),
+                                             gain1(tree_options.imp_measure), node_is_finished, true, seed);
+  std::ostringstream expected;
+  save_random_forest(expected, forest);
+
+  // the trees are written while they are learned
+  std::ostringstream out;
+  random_forest_writer writer(out, forest_options.forest_size);
+  learn_random_forest_trees(D, I, forest_options, tree_options, threshold_split_family(D, tree_options),
+                            gain1(tree_options.imp_measure), node_is_finished, true,
+                            [&writer](std::size_t i, binary_decision_tree&& tree) { writer.add(i, std::move(tree)); }, seed);
+  writer.close();
+  CHECK_EQ(out.str(), expected.str());
+
+  // the trees may be added in any order; a single thread can only do that if all trees can be kept
+  std::ostringstream out1;
+  random_forest_writer writer1(out1, forest.trees().size(), false, forest.trees().size());
+  for (std::size_t i: {3, 0, 4, 2, 1})
+  {
+    writer1.add(i, forest.trees()[i]);
+  }
+  writer1.close();
+  CHECK_EQ(out1.str(), expected.str());
+
+  // a missing tree is reported
+  std::ostringstream out2;
+  random_forest_writer writer2(out2, 2);
+  writer2.add(1, forest.trees()[1]);
+  CHECK_THROWS(writer2.close());
+
+  // adding tree 2 blocks until there is room, while the next trees in order are accepted
+  std::ostringstream out3;
+  random_forest_writer writer3(out3, forest.trees().size(), false, 2);
+  std::thread thread([&]()
+  {
+    for (std::size_t i: {3, 4, 2})
+    {
+      writer3.add(i, forest.trees()[i]);
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  writer3.add(0, forest.trees()[0]);
+  writer3.add(1, forest.trees()[1]);
+  thread.join();
+  writer3.close();
+  CHECK_EQ(out3.str(), expected.str());
+  CHECK_LE(writer3.max_pending_size(), 3);
+
+  // the number of kept trees stays bounded if the trees are learned in parallel
+  std::size_t forest_size = 40;
+  forest_options.forest_size = forest_size;
+  std::stringstream out4;
+  random_forest_writer writer4(out4, forest_size, false, 2);
+  learn_random_forest_trees(D, I, forest_options, tree_options, threshold_split_family(D, tree_options),
+                            gain1(tree_options.imp_measure), node_is_finished, false,
+                            [&writer4](std::size_t i, binary_decision_tree&& tree) { writer4.add(i, std::move(tree)); });
+  writer4.close();
+  CHECK_LE(writer4.max_pending_size(), 3);
+  CHECK_EQ(parse_random_forest(out4).trees().size(), forest_size);
+}
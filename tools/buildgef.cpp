@@ -8,6 +8,7 @@
 /// \brief add your file description here.
 
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <lyra/lyra.hpp>
 #include "aitools/datasets/io.h"
@@ -25,9 +26,15 @@ class tool: public command_line_tool
     std::string input_file{};
     std::string dataset_file{};
     std::string output_file{};
+    bool sequential = false;
+    bool streaming = false;
+    bool no_hash_consing = false;
 
     void add_options(lyra::cli& cli) override
     {
+      cli |= lyra::opt(streaming)["--streaming"]("Save the trees one by one while they are converted, instead of building the whole circuit in memory first. This reduces the memory usage, in particular in combination with --no-hash-consing.");
+      cli |= lyra::opt(no_hash_consing)["--no-hash-consing"]("Do not share identical terminal nodes between the trees. The output is larger, but with --streaming only the nodes of one tree are kept in memory.");
+      cli |= lyra::opt(sequential)["--sequential"]("Convert the trees sequentially instead of in parallel. The result is the same.");
       cli |= lyra::arg(input_file, "random-forest-file").required()("A file containing a random forest");
       cli |= lyra::arg(dataset_file, "dataset-file").required()("A file containing the data set that corresponds to the forest");
       cli |= lyra::arg(output_file, "output-file").required()("The output file containing a generative forest");
@@ -41,9 +48,23 @@ class tool: public command_line_tool
       AITOOLS_LOG(log::verbose) << "Elapsed time: " << watch.seconds() << "\n";
       AITOOLS_LOG(log::verbose) << "Reading data file " << dataset_file << std::endl;
       dataset D = load_dataset(dataset_file);
+      if (streaming)
+      {
+        AITOOLS_LOG(log::verbose) << "Building generative forest and saving it to " << output_file << std::endl;
+        watch.reset();
+        std::ofstream to(output_file);
+        if (!to)
+        {
+          throw std::runtime_error("Could not open file '" + output_file + "' for writing.");
+        }
+        std::size_t size = build_and_save_generative_forest(to, forest, D, !no_hash_consing, sequential);
+        AITOOLS_LOG(log::verbose) << "Saved " << size << " nodes\n";
+        AITOOLS_LOG(log::verbose) << "Elapsed time: " << watch.seconds() << "\n";
+        return true;
+      }
       AITOOLS_LOG(log::verbose) << "Building generative forest" << std::endl;
       watch.reset();
-      probabilistic_circuit pc = build_generative_forest(forest, D);
+      probabilistic_circuit pc = build_generative_forest(forest, D, !no_hash_consing, sequential);
       AITOOLS_LOG(log::verbose) << "Elapsed time: " << watch.seconds() << "\n";
       AITOOLS_LOG(log::verbose) << "Saving generative forest to " << output_file << std::endl;
       watch.reset();
@@ -0,0 +1,97 @@
+// Copyright: Wieger Wesselink
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file importcsv.cpp
+/// \brief Converts a CSV file into a dataset.
+
+#include <fstream>
+#include <string>
+#include <lyra/lyra.hpp>
+#include "aitools/datasets/csv_import.h"
+#include "aitools/datasets/io.h"
+#include "aitools/utilities/command_line_tool.h"
+#include "aitools/utilities/stopwatch.h"
+#include "aitools/utilities/string_utility.h"
+
+using namespace aitools;
+
+class tool: public command_line_tool
+{
+  protected:
+    std::string input_file;
+    std::string output_file;
+    std::string delimiter = ",";
+    bool no_header = false;
+    std::size_t max_categories = 30;
+    std::string continuous_columns;
+    std::size_t class_column = csv_dataset_parser::last_column;
+    std::string categories_file;
+
+    void add_options(lyra::cli& cli) override
+    {
+      cli |= lyra::opt(delimiter, "value")["--delimiter"]("The character that separates the cells, or 'tab'.");
+      cli |= lyra::opt(no_header)["--no-header"]("The first line of the CSV file contains values instead of column names.");
+      cli |= lyra::opt(max_categories, "value")["--max-categories"]("The maximum number of categories of a numerical categorical column.");
+      cli |= lyra::opt(continuous_columns, "value")["--continuous"]("A comma separated list of indices of numerical columns that are continuous regardless of their values.");
+      cli |= lyra::opt(class_column, "value")["--class-column"]("The index of the class column, that is always categorical and becomes the last column of the dataset. By default it is the last column.");
+      cli |= lyra::opt(categories_file, "value")["--categories"]("A file in which the categories of the string columns are saved.");
+      cli |= lyra::arg(input_file, "input-file").required()("The CSV file.");
+      cli |= lyra::arg(output_file, "output-file").required()("The file in which the dataset is saved.");
+    }
+
+    bool run() override
+    {
+      if (delimiter == "tab")
+      {
+        delimiter = "\t";
+      }
+      if (delimiter.size() != 1)
+      {
+        throw std::runtime_error("the delimiter must be a single character");
+      }
+
+      utilities::stopwatch watch;
+      csv_dataset_parser parser;
+      parser.delimiter = delimiter[0];
+      parser.has_header = !no_header;
+      parser.max_categories = max_categories;
+      parser.class_column = class_column;
+      for (const auto& word: utilities::regex_split(continuous_columns, ","))
+      {
+        if (!utilities::trim_copy(word).empty())
+        {
+          parser.continuous_columns.push_back(std::stoul(word));
+        }
+      }
+      parser.parse_text(read_text_fast(input_file));
+      dataset D = parser.get_result();
+      AITOOLS_LOG(log::verbose) << "Read " << D.X().row_count() << " rows from " << input_file << " in " << watch.seconds() << " seconds" << std::endl;
+      AITOOLS_LOG(log::verbose) << "category_counts: " << print_container(D.category_counts()) << std::endl;
+
+      watch.reset();
+      save_dataset(output_file, D);
+      AITOOLS_LOG(log::verbose) << "Saved the dataset to " << output_file << " in " << watch.seconds() << " seconds" << std::endl;
+
+      if (!categories_file.empty())
+      {
+        std::ofstream to(categories_file);
+        const auto& categories = parser.categories();
+        for (std::size_t j = 0; j < categories.size(); j++)
+        {
+          if (!categories[j].empty())
+          {
+            to << j << ": " << utilities::string_join(categories[j], " ") << '\n';
+          }
+        }
+      }
+      return true;
+    }
+};
+
+int main(int argc, const char** argv)
+{
+  return tool().execute(argc, argv);
+}
@@ -59,6 +59,7 @@ class tool: public command_line_tool
     std::string split_family = "threshold";
     std::string impurity_measure = "gini";
     decision_tree_options tree_options;
+    bool packed = false;
 
     void add_options(lyra::cli& cli) override
     {
@@ -69,6 +70,7 @@ class tool: public command_line_tool
       cli |= lyra::opt(tree_options.min_samples_leaf, "count")["--min-samples-leaf"]("The minimum number of samples in a leaf");
       cli |= lyra::opt(tree_options.support_missing_values)["--missing"]["-m"]("Support missing values");
       cli |= lyra::opt(tree_options.optimization)["--optimized"]("Apply an optimization");
+      cli |= lyra::opt(packed)["--packed"]("Save the classes and indices of the tree in a compact encoding");
       cli |= lyra::arg(input_file, "input-file").required()("Load a dataset from the given file.");
       cli |= lyra::arg(output_file, "output-file").required()("Save a generative forest to the given file.");
     }
@@ -93,7 +95,7 @@ class tool: public command_line_tool
       AITOOLS_LOG(log::verbose) << "Creating decision tree" << std::endl;
       binary_decision_tree tree = learn_decision_tree(D, I, tree_options, split_family, gain1(tree_options.imp_measure), node_is_finished, seed);
       AITOOLS_LOG(log::verbose) << "Saving decision tree to " << output_file << std::endl;
-      save_decision_tree(output_file, tree);
+      save_decision_tree(output_file, tree, packed);
       return true;
     }
 };
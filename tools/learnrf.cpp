@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <fstream>
 #include <iostream>
 #include <lyra/lyra.hpp>
 #include "aitools/datasets/io.h"
@@ -66,6 +67,47 @@ aitools::random_forest learn_random_forest(const aitools::dataset& D,
   }
 }
 
+// Learns a random forest, and saves the trees to the stream to as soon as they have been learned
+template <typename StopCriterion>
+void learn_and_save_random_forest(std::ostream& to,
+                                  const aitools::dataset& D,
+                                  const std::vector<std::uint32_t>& I,
+                                  aitools::random_forest_options forest_options,
+                                  const aitools::decision_tree_options& tree_options,
+                                  const std::string& split_family,
+                                  StopCriterion node_finished,
+                                  bool sequential,
+                                  std::size_t seed,
+                                  bool packed)
+{
+  using namespace aitools;
+
+  random_forest_writer writer(to, forest_options.forest_size, packed);
+  auto report_tree = [&writer](std::size_t i, binary_decision_tree&& tree)
+  {
+    AITOOLS_LOG(log::debug) << "tree " << i << " #nodes = " << tree.vertices().size() << std::endl;
+    writer.add(i, std::move(tree));
+  };
+
+  if (split_family == "threshold")
+  {
+    learn_random_forest_trees(D, I, forest_options, tree_options, threshold_split_family(D, tree_options), gain1(tree_options.imp_measure), node_finished, sequential, report_tree, seed);
+  }
+  else if (split_family == "threshold-single")
+  {
+    learn_random_forest_trees(D, I, forest_options, tree_options, threshold_plus_single_split_family(D, tree_options), gain1(tree_options.imp_measure), node_finished, sequential, report_tree, seed);
+  }
+  else if (split_family == "threshold-subset")
+  {
+    learn_random_forest_trees(D, I, forest_options, tree_options, threshold_plus_subset_split_family(D, tree_options), gain1(tree_options.imp_measure), node_finished, sequential, report_tree, seed);
+  }
+  else
+  {
+    throw std::runtime_error("unknown split family " + split_family);
+  }
+  writer.close();
+}
+
 class tool: public command_line_tool
 {
   protected:
@@ -81,6 +123,7 @@ class tool: public command_line_tool
     std::string split_family = "threshold";
     std::size_t fold = 0;
     std::string output_file{};
+    bool packed = false;
 
     void add_options(lyra::cli& cli) override
     {
@@ -99,6 +142,7 @@ class tool: public command_line_tool
       cli |= lyra::opt(execution_mode, "mode")["--execution-mode"]("The execution mode").choices("sequential", "parallel");
       cli |= lyra::opt(seed, "value")["--seed"]("A seed value that can be used to make the algorithm deterministic. N.B. This does not work with parallel execution");
       cli |= lyra::opt(fold, "value")["--fold"]("Apply a k-fold cross validation");
+      cli |= lyra::opt(packed)["--packed"]("Save the classes and indices of the trees in a compact encoding");
       cli |= lyra::arg(input_file, "input-file").required()("The input file containing a data set");
       cli |= lyra::arg(output_file, "output-file").required()("Save the generated random forest to the given file");
     }
@@ -141,16 +185,15 @@ class tool: public command_line_tool
 
       if (fold == 0)
       {
-        utilities::stopwatch watch;
-        random_forest forest = ::learn_random_forest(D, I, forest_options, tree_options, split_family, node_is_finished, sequential, seed);
-        AITOOLS_LOG(log::verbose) << "elapsed time: " << watch.seconds() << "\n";
-        save_random_forest(output_file, forest);
-        const auto& trees = forest.trees();
-        for (std::size_t i = 0; i < trees.size(); i++)
+        // the trees are saved by a background thread while the next trees are learned
+        std::ofstream to(output_file);
+        if (!to)
         {
-          const auto& tree = trees[i];
-          AITOOLS_LOG(log::debug) << "tree " << i << " #nodes = " << tree.vertices().size() << std::endl;
+          throw std::runtime_error("Could not open file '" + output_file + "' for writing.");
         }
+        utilities::stopwatch watch;
+        ::learn_and_save_random_forest(to, D, I, forest_options, tree_options, split_family, node_is_finished, sequential, seed, packed);
+        AITOOLS_LOG(log::verbose) << "elapsed time: " << watch.seconds() << "\n";
       }
       else
       {
@@ -159,7 +202,7 @@ class tool: public command_line_tool
         {
           auto [test_set, training_set] = f.folds(i);
           random_forest forest = ::learn_random_forest(D, training_set, forest_options, tree_options, split_family, node_is_finished, sequential, seed);
-          save_random_forest(add_number(output_file, i), forest);
+          save_random_forest(add_number(output_file, i), forest, packed);
           std::cout << "accuracy test set     " << i << " = " << accuracy(forest, test_set, D) << std::endl;
           std::cout << "accuracy training set " << i << " = " << accuracy(forest, training_set, D) << std::endl;
         }
@@ -0,0 +1,99 @@
+// Copyright: Wieger Wesselink
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+/// \file mathbench.cpp
+/// \brief Microbenchmark for the kernels in aitools/numerics/simd_functions.h.
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <lyra/lyra.hpp>
+#include "aitools/numerics/math_functions.h"
+#include "aitools/numerics/simd_functions.h"
+#include "aitools/utilities/command_line_tool.h"
+#include "aitools/utilities/stopwatch.h"
+
+using namespace aitools;
+
+class tool: public command_line_tool
+{
+  protected:
+    std::size_t size = 64;
+    std::size_t repetitions = 100000;
+    std::size_t seed = 123456;
+
+    void add_options(lyra::cli& cli) override
+    {
+      cli |= lyra::opt(size, "value")["--size"]("The number of elements of the arrays that are processed.");
+      cli |= lyra::opt(repetitions, "value")["--repetitions"]("The number of times each kernel is applied.");
+      cli |= lyra::opt(seed, "value")["--seed"]("A seed value for the random generator.");
+    }
+
+    std::string description() const override
+    {
+      return "Measures the throughput of the vectorized exp, log, log_sum_exp and normal log-pdf kernels.";
+    }
+
+    // Prints the number of elements per second that are processed by f.
+    template <typename Function>
+    void measure(const std::string& name, Function f)
+    {
+      double sink = 0;
+      utilities::stopwatch watch;
+      for (std::size_t i = 0; i < repetitions; i++)
+      {
+        sink += f();
+      }
+      double seconds = watch.seconds();
+      std::cout << std::setw(16) << std::left << name
+                << std::setw(12) << std::right << std::fixed << std::setprecision(1) << (size * repetitions) / seconds / 1e6 << " M/s"
+                << "  (checksum " << std::scientific << sink << ")" << std::endl;
+    }
+
+    bool run() override
+    {
+      std::mt19937 rng{static_cast<unsigned int>(seed)};
+      std::uniform_real_distribution<double> uniform(-20, 5);
+      std::vector<double> x(size);
+      std::vector<double> y(size);
+      for (double& x_i: x)
+      {
+        x_i = uniform(rng);
+      }
+      std::vector<double> positive(size);
+      for (std::size_t i = 0; i < size; i++)
+      {
+        positive[i] = std::exp(x[i]);
+      }
+      const double* first = x.data();
+      const double* last = x.data() + size;
+
+      measure("reference lse", [&]() { return log_sum_exp(first, last); });
+
+      for (auto s: { simd::instruction_set::scalar, simd::instruction_set::avx2, simd::instruction_set::avx512 })
+      {
+        if (simd::select_instruction_set(s) != s)
+        {
+          std::cout << "instruction set " << simd::instruction_set_name(s) << " is not supported" << std::endl;
+          continue;
+        }
+        std::cout << "instruction set " << simd::instruction_set_name(s) << std::endl;
+        measure("exp", [&]() { simd::exp(first, last, y.data()); return y[0]; });
+        measure("log", [&]() { simd::log(positive.data(), positive.data() + size, y.data()); return y[0]; });
+        measure("log_sum_exp", [&]() { return simd::log_sum_exp(first, last); });
+        measure("normal_log_pdf", [&]() { simd::normal_log_pdf(first, last, y.data(), 0.5, 2.0, -0.23); return y[0]; });
+      }
+      simd::select_instruction_set(simd::detected_instruction_set());
+      return true;
+    }
+};
+
+int main(int argc, const char** argv)
+{
+  return tool().execute(argc, argv);
+}
@@ -7,13 +7,22 @@
 /// \file pc.cpp
 /// \brief Utilities for probabilistic circuits.
 
+#include <algorithm>
+#include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include "aitools/datasets/io.h"
 #include "aitools/probabilistic_circuits/io.h"
 #include "aitools/probabilistic_circuits/algorithms.h"
+#include "aitools/probabilistic_circuits/evaluation_plan.h"
+#include "aitools/probabilistic_circuits/generative_forest.h"
+#include "aitools/probabilistic_circuits/layered_circuit.h"
+#include "aitools/probabilistic_circuits/parameter_learning.h"
 #include "aitools/utilities/command_line_group_tool.h"
 #include "aitools/utilities/logger.h"
+#include "aitools/utilities/stopwatch.h"
 
 namespace aitools {
 
@@ -34,6 +43,7 @@ class expand_sum_split_nodes_command : public utilities::sub_command
     {
       AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
       pc = load_probabilistic_circuit(input_file);
+      expand_sum_split_nodes(pc);
       AITOOLS_LOG(log::verbose) << "Saving probabilistic circuit to " << output_file << std::endl;
       save_probabilistic_circuit(output_file, pc);
       return true;
@@ -46,6 +56,75 @@ class expand_sum_split_nodes_command : public utilities::sub_command
     }
 };
 
+class simplify_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    std::string output_file;
+    probabilistic_circuit pc;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit."));
+      cmd.add_argument(lyra::arg(output_file, "output-file").required()("The output file containing the simplified probabilistic circuit."));
+    }
+
+    bool run() override
+    {
+      AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
+      pc = load_probabilistic_circuit(input_file);
+      std::size_t size = probabilistic_circuit_size(pc);
+      simplify(pc);
+      AITOOLS_LOG(log::verbose) << "Reduced the number of nodes from " << size << " to " << probabilistic_circuit_size(pc) << std::endl;
+      AITOOLS_LOG(log::verbose) << "Saving probabilistic circuit to " << output_file << std::endl;
+      save_probabilistic_circuit(output_file, pc);
+      return true;
+    }
+
+  public:
+    simplify_command()
+      : utilities::sub_command("simplify", "Simplifies a PC, without changing the values of EVI queries.")
+    {
+    }
+};
+
+class parse_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    std::size_t repetitions = 1;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::opt(repetitions, "value")["--repetitions"]("The number of times the file is parsed."));
+      cmd.add_argument(lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit."));
+    }
+
+    bool run() override
+    {
+      std::size_t bytes = std::filesystem::file_size(input_file);
+      std::size_t size = 0;
+      double seconds = 0;
+      for (std::size_t i = 0; i < repetitions; i++)
+      {
+        utilities::stopwatch watch;
+        probabilistic_circuit pc = load_probabilistic_circuit(input_file);
+        seconds += watch.seconds();
+        size = probabilistic_circuit_size(pc);
+      }
+      seconds /= repetitions;
+      std::cout << "nodes: " << size << std::endl;
+      std::cout << "parse time: " << seconds << " seconds (" << bytes / seconds / 1e6 << " MB/s, " << size / seconds << " nodes per second)" << std::endl;
+      return true;
+    }
+
+  public:
+    parse_command()
+      : utilities::sub_command("parse", "Parses a probabilistic circuit file, and reports the throughput of the parser.")
+    {
+    }
+};
+
 class is_decomposable_command : public utilities::sub_command
 {
   protected:
@@ -100,6 +179,242 @@ class is_smooth_command : public utilities::sub_command
     }
 };
 
+class is_deterministic_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    probabilistic_circuit pc;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::arg(input_file, "input-file").required().help("A file containing a probabilistic circuit."));
+    }
+
+    bool run() override
+    {
+      AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
+      pc = load_probabilistic_circuit(input_file);
+      bool result = is_deterministic(pc);
+      std::cout << std::boolalpha << result << std::endl;
+      return true;
+    }
+
+  public:
+    is_deterministic_command()
+     : utilities::sub_command("is-deterministic", "Determines if the sum nodes of a probabilistic circuit are deterministic.")
+    {
+    }
+};
+
+class log_evi_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    std::string dataset_file;
+    std::size_t repetitions = 1;
+    std::size_t batch_size = 0;
+    bool layered = false;
+    bool parallel = false;
+    probabilistic_circuit pc;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::opt(repetitions, "count")["--repetitions"]("The number of times the dataset is evaluated."));
+      cmd.add_argument(lyra::opt(batch_size, "size")["--batch-size"]("Evaluate the rows in batches of this size. If it is 0, the rows are evaluated one by one."));
+      cmd.add_argument(lyra::opt(layered)["--layered"]("Evaluate the batches with a layered circuit (requires --batch-size). The PC may not contain sum-split nodes."));
+      cmd.add_argument(lyra::opt(parallel)["--parallel"]("Evaluate the nodes of each layer in parallel (only with --layered)."));
+      cmd.add_argument(lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit."));
+      cmd.add_argument(lyra::arg(dataset_file, "dataset-file").required()("A file containing a dataset."));
+    }
+
+    bool run() override
+    {
+      if (parallel && !layered)
+      {
+        throw std::runtime_error("the option --parallel can only be used together with --layered");
+      }
+      if (layered && batch_size == 0)
+      {
+        throw std::runtime_error("the option --layered requires a batch size greater than 0");
+      }
+
+      AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
+      pc = load_probabilistic_circuit(input_file);
+      AITOOLS_LOG(log::verbose) << "Loading dataset from " << dataset_file << std::endl;
+      dataset D = load_dataset(dataset_file);
+      std::vector<pc_node_ptr> order = topological_ordering(pc);
+
+      const auto& X = D.X();
+      double total = 0;
+      utilities::stopwatch watch;
+      for (std::size_t k = 0; k < repetitions; k++)
+      {
+        total = 0;
+        if (batch_size > 0)
+        {
+          for (double log_p: layered ? log_evi_layered(pc, D, batch_size, parallel) : log_evi_batch(pc, D, batch_size))
+          {
+            total += log_p;
+          }
+        }
+        else
+        {
+          for (const auto& x: X)
+          {
+            total += log_evi_query_iterative(pc, x, order);
+          }
+        }
+      }
+      double seconds = watch.seconds();
+      std::size_t n = X.row_count();
+      std::cout << "average log-likelihood: " << total / n << std::endl;
+      AITOOLS_LOG(log::verbose) << "Elapsed time: " << seconds << " seconds (" << (n * repetitions) / seconds << " queries per second)" << std::endl;
+      return true;
+    }
+
+  public:
+    log_evi_command()
+      : utilities::sub_command("log-evi", "Computes the average log-likelihood of a dataset, and reports the throughput.")
+    {
+    }
+};
+
+class mpe_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    std::string dataset_file;
+    std::string output_file;
+    std::size_t batch_size = 64;
+    probabilistic_circuit pc;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::opt(batch_size, "size")["--batch-size"]("The number of rows that are evaluated in one batch."));
+      cmd.add_argument(lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit."));
+      cmd.add_argument(lyra::arg(dataset_file, "dataset-file").required()("A file containing a dataset with missing values."));
+      cmd.add_argument(lyra::arg(output_file, "output-file").required()("The output file containing the completed dataset."));
+    }
+
+    bool run() override
+    {
+      AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
+      pc = load_probabilistic_circuit(input_file);
+      AITOOLS_LOG(log::verbose) << "Loading dataset from " << dataset_file << std::endl;
+      dataset D = load_dataset(dataset_file);
+      utilities::stopwatch watch;
+      dataset D1(mpe_batch(pc, D, std::max<std::size_t>(batch_size, 1)), D.category_counts());
+      double seconds = watch.seconds();
+      AITOOLS_LOG(log::verbose) << "Elapsed time: " << seconds << " seconds (" << D.X().row_count() / seconds << " rows per second)" << std::endl;
+      AITOOLS_LOG(log::verbose) << "Saving dataset to " << output_file << std::endl;
+      save_dataset(output_file, D1);
+      return true;
+    }
+
+  public:
+    mpe_command()
+      : utilities::sub_command("mpe", "Replaces the missing values of a dataset by their most probable values.")
+    {
+    }
+};
+
+class predict_proba_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    std::string dataset_file;
+    std::size_t batch_size = 64;
+    probabilistic_circuit pc;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::opt(batch_size, "size")["--batch-size"]("The number of rows that are evaluated in one batch."));
+      cmd.add_argument(lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit."));
+      cmd.add_argument(lyra::arg(dataset_file, "dataset-file").required()("A file containing a dataset. The last column contains the class."));
+    }
+
+    bool run() override
+    {
+      AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
+      pc = load_probabilistic_circuit(input_file);
+      AITOOLS_LOG(log::verbose) << "Loading dataset from " << dataset_file << std::endl;
+      dataset D = load_dataset(dataset_file);
+      utilities::stopwatch watch;
+      numerics::matrix<double> P = predict_proba(pc, D, std::max<std::size_t>(batch_size, 1));
+      double seconds = watch.seconds();
+
+      // report the accuracy of the most probable class
+      const auto& X = D.X();
+      std::size_t n = X.row_count();
+      std::size_t correct = 0;
+      for (std::size_t i = 0; i < n; i++)
+      {
+        const auto& p = P[i];
+        auto k = static_cast<double>(std::max_element(p.begin(), p.end()) - p.begin());
+        if (X[i].back() == k)
+        {
+          correct++;
+        }
+      }
+      std::cout << "accuracy: " << static_cast<double>(correct) / n << std::endl;
+      AITOOLS_LOG(log::verbose) << "Elapsed time: " << seconds << " seconds (" << n / seconds << " rows per second)" << std::endl;
+      return true;
+    }
+
+  public:
+    predict_proba_command()
+      : utilities::sub_command("predict-proba", "Computes the class posteriors of a dataset, and reports the accuracy.")
+    {
+    }
+};
+
+class learn_parameters_command : public utilities::sub_command
+{
+  protected:
+    std::string input_file;
+    std::string dataset_file;
+    std::string output_file;
+    em_options options;
+    probabilistic_circuit pc;
+
+    void add_options(lyra::command& cmd) override
+    {
+      cmd.add_argument(lyra::opt(options.iterations, "count")["--iterations"]("The number of EM iterations."));
+      cmd.add_argument(lyra::opt(options.batch_size, "size")["--batch-size"]("The number of rows in a minibatch."));
+      cmd.add_argument(lyra::opt(options.thread_count, "count")["--threads"]("The number of threads. If it is 0, the number of hardware threads is used."));
+      cmd.add_argument(lyra::opt(options.weight_smoothing, "value")["--smoothing"]("A pseudo count that is added to the expected counts."));
+      cmd.add_argument(lyra::opt(options.min_standard_deviation, "value")["--min-standard-deviation"]("A lower bound for the standard deviations of (truncated) normal leaves."));
+      cmd.add_argument(lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit."));
+      cmd.add_argument(lyra::arg(dataset_file, "dataset-file").required()("A file containing a dataset."));
+      cmd.add_argument(lyra::arg(output_file, "output-file").required()("The output file containing the probabilistic circuit with the learned parameters."));
+    }
+
+    bool run() override
+    {
+      AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
+      pc = load_probabilistic_circuit(input_file);
+      AITOOLS_LOG(log::verbose) << "Loading dataset from " << dataset_file << std::endl;
+      dataset D = load_dataset(dataset_file);
+      AITOOLS_LOG(log::verbose) << options;
+      utilities::stopwatch watch;
+      std::vector<double> log_likelihoods = learn_parameters_em(pc, D, options);
+      for (std::size_t i = 0; i < log_likelihoods.size(); i++)
+      {
+        AITOOLS_LOG(log::verbose) << "iteration " << i << ": average log-likelihood " << log_likelihoods[i] << std::endl;
+      }
+      AITOOLS_LOG(log::verbose) << "Elapsed time: " << watch.seconds() << " seconds" << std::endl;
+      AITOOLS_LOG(log::verbose) << "Saving probabilistic circuit to " << output_file << std::endl;
+      save_probabilistic_circuit(output_file, pc);
+      return true;
+    }
+
+  public:
+    learn_parameters_command()
+      : utilities::sub_command("learn-params", "Learns the parameters of a PC from a dataset with the EM algorithm.")
+    {
+    }
+};
+
 } // namespace aitools
 
 int main(int argc, const char** argv)
@@ -108,10 +423,24 @@ int main(int argc, const char** argv)
 
   utilities::command_line_group_tool tool;
   expand_sum_split_nodes_command expand_sum_split_nodes;
+  simplify_command simplify;
+  parse_command parse;
   is_decomposable_command is_decomposable;
   is_smooth_command is_smooth;
+  is_deterministic_command is_deterministic;
+  log_evi_command log_evi;
+  learn_parameters_command learn_parameters;
+  mpe_command mpe;
+  predict_proba_command predict_proba;
   tool.add_command(expand_sum_split_nodes);
+  tool.add_command(simplify);
+  tool.add_command(parse);
   tool.add_command(is_decomposable);
   tool.add_command(is_smooth);
+  tool.add_command(is_deterministic);
+  tool.add_command(log_evi);
+  tool.add_command(learn_parameters);
+  tool.add_command(mpe);
+  tool.add_command(predict_proba);
   return tool.execute(argc, argv);
 }
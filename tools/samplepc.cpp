@@ -12,6 +12,7 @@
 #include <lyra/lyra.hpp>
 #include "aitools/datasets/io.h"
 #include "aitools/probabilistic_circuits/algorithms.h"
+#include "aitools/probabilistic_circuits/evaluation_plan.h"
 #include "aitools/probabilistic_circuits/io.h"
 #include "aitools/utilities/command_line_tool.h"
 #include "aitools/utilities/print.h"
@@ -23,13 +24,17 @@ class tool: public command_line_tool
   protected:
     std::string input_file{};
     std::string output_file{};
-    unsigned int sample_count = 10;
+    std::string evidence_file{};
+    std::size_t sample_count = 10;
     std::size_t seed = std::random_device{}();
+    std::size_t thread_count = 0;
 
     void add_options(lyra::cli& cli) override
     {
       cli |= lyra::opt(sample_count, "count")["--count"]("The number of samples.");
       cli |= lyra::opt(seed, "value")["--seed"]("A seed value for the random generator.");
+      cli |= lyra::opt(evidence_file, "file")["--evidence"]("A dataset with evidence. If it is set, the missing values of each row are sampled conditionally on the observed values, and --count is ignored.");
+      cli |= lyra::opt(thread_count, "count")["--threads"]("The number of threads (default: the number of hardware threads). The samples do not depend on it.");
       cli |= lyra::arg(input_file, "input-file").required()("A file containing a probabilistic circuit.");
       cli |= lyra::arg(output_file, "output-file").required()("A file where the generated dataset is written to.");
     }
@@ -38,9 +43,19 @@ class tool: public command_line_tool
     {
       AITOOLS_LOG(log::verbose) << "Loading probabilistic circuit from " << input_file << std::endl;
       probabilistic_circuit pc = load_probabilistic_circuit(input_file);
-      std::mt19937 rng{static_cast<unsigned int>(seed)};
-      AITOOLS_LOG(log::verbose) << "Drawing " << sample_count << " samples from the probabilistic circuit" << std::endl;
-      dataset D = sample_pc(pc, sample_count, rng);
+      dataset D;
+      if (!evidence_file.empty())
+      {
+        AITOOLS_LOG(log::verbose) << "Loading evidence from " << evidence_file << std::endl;
+        dataset E = load_dataset(evidence_file);
+        AITOOLS_LOG(log::verbose) << "Sampling the missing values of " << E.X().row_count() << " rows" << std::endl;
+        D = sample_pc_conditional(pc, E, seed, thread_count);
+      }
+      else
+      {
+        AITOOLS_LOG(log::verbose) << "Drawing " << sample_count << " samples from the probabilistic circuit" << std::endl;
+        D = sample_pc_parallel(pc, sample_count, seed, thread_count);
+      }
       AITOOLS_LOG(log::verbose) << "Saving dataset to " << output_file << std::endl;
       save_dataset(output_file, D);
       return true;